@@ -0,0 +1,90 @@
+#include "alerts.h"
+#include "N2kMessages.h"
+
+LevelAlert::LevelAlert(bool high)
+    : high(high), isActive(false), acknowledged(false), silenced(false), statusPending(false), textPending(false),
+      occurrence(0), silencedUntilMs(0), lastSentMs(0), acknowledgedBy(0) {}
+
+bool LevelAlert::evaluate(float level_percent, float threshold_percent, uint32_t now_ms) {
+    bool exceeded = high ? level_percent >= threshold_percent : level_percent <= threshold_percent;
+    bool cleared = high ? level_percent < threshold_percent - ALERT_HYSTERESIS_PERCENT
+                        : level_percent > threshold_percent + ALERT_HYSTERESIS_PERCENT;
+
+    bool active = isActive.load(std::memory_order_relaxed);
+    if (!active && exceeded) {
+        isActive.store(true, std::memory_order_relaxed);
+        acknowledged.store(false, std::memory_order_relaxed);
+        silenced.store(false, std::memory_order_relaxed);
+        acknowledgedBy = 0;
+        occurrence++;
+        statusPending = true;
+        textPending = true;
+    } else if (active && cleared) {
+        isActive.store(false, std::memory_order_relaxed);
+        statusPending = true;  // One last status with the alert back to normal
+    } else if (active && silenced.load(std::memory_order_relaxed) && (int32_t)(now_ms - silencedUntilMs) >= 0) {
+        silenced.store(false, std::memory_order_relaxed);
+        statusPending = true;
+    }
+    return statusPending;
+}
+
+bool LevelAlert::respond(tN2kAlertResponseCommand command, uint64_t acknowledger, uint32_t now_ms) {
+    if (!isActive.load(std::memory_order_relaxed) || acknowledged.load(std::memory_order_relaxed)) return false;
+    switch (command) {
+    case N2kts_AlertResponseAcknowledge:
+        acknowledged.store(true, std::memory_order_relaxed);
+        silenced.store(false, std::memory_order_relaxed);
+        acknowledgedBy = acknowledger;
+        break;
+    case N2kts_AlertResponseTemporarySilence:
+        silenced.store(true, std::memory_order_relaxed);
+        silencedUntilMs = now_ms + ALERT_SILENCE_MS;
+        break;
+    default:  // Test commands are not supported
+        return false;
+    }
+    statusPending = true;
+    return true;
+}
+
+uint32_t LevelAlert::msUntilDue(uint32_t now_ms) const {
+    if (statusPending) return 0;
+    if (!active()) return UINT32_MAX;
+    uint32_t elapsed = now_ms - lastSentMs;
+    uint32_t wait = elapsed >= ALERT_STATUS_INTERVAL_MS ? 0 : ALERT_STATUS_INTERVAL_MS - elapsed;
+    if (silenced.load(std::memory_order_relaxed)) {
+        int32_t silence_left = (int32_t)(silencedUntilMs - now_ms);
+        if (silence_left < 0) silence_left = 0;
+        if ((uint32_t)silence_left < wait) wait = silence_left;
+    }
+    return wait;
+}
+
+void LevelAlert::sent(uint32_t now_ms) {
+    statusPending = false;
+    textPending = false;
+    lastSentMs = now_ms;
+}
+
+tN2kAlertState LevelAlert::state(uint32_t now_ms) const {
+    if (!active()) return N2kts_AlertStateNormal;
+    if (acknowledged.load(std::memory_order_relaxed)) return N2kts_AlertStateAcknowledged;
+    if (silenced.load(std::memory_order_relaxed) && (int32_t)(now_ms - silencedUntilMs) < 0) return N2kts_AlertStateSilenced;
+    return N2kts_AlertStateActive;
+}
+
+void LevelAlert::setStatus(tN2kMsg& msg, unsigned int alert_id, uint64_t source_name, unsigned char instance, uint32_t now_ms) const {
+    tN2kAlertThresholdStatus threshold = N2kts_AlertThresholdStatusNormal;
+    if (active()) threshold = high ? N2kts_AlertThresholdStatusExceeded : N2kts_AlertThresholdStatusLowExceeded;
+    bool silence_status = state(now_ms) == N2kts_AlertStateSilenced;
+    SetN2kAlert(msg, N2kts_AlertTypeWarning, N2kts_AlertCategoryTechnical, 0, 0, alert_id, source_name,
+                instance, 0, occurrence, silence_status, acknowledged.load(std::memory_order_relaxed), false,
+                true, true, false, acknowledgedBy, N2kts_AlertTriggerAuto, threshold, 0, state(now_ms));
+}
+
+void LevelAlert::setText(tN2kMsg& msg, unsigned int alert_id, uint64_t source_name, unsigned char instance, char* description) const {
+    char location[] = "";
+    SetN2kAlertText(msg, N2kts_AlertTypeWarning, N2kts_AlertCategoryTechnical, 0, 0, alert_id, source_name,
+                    instance, 0, occurrence, N2kts_AlertLanguageEnglishUS, description, location);
+}
@@ -0,0 +1,50 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <stdint.h>
+#include <atomic>
+#include "N2kMsg.h"
+#include "N2kTypes.h"
+
+#define ALERT_STATUS_INTERVAL_MS 2000  // Active alerts repeat PGN 126983 so late joiners see them
+#define ALERT_SILENCE_MS 30000         // How long a temporary silence from the bus lasts
+#define ALERT_HYSTERESIS_PERCENT 1.0f  // Level must move back this far past the threshold to clear
+
+// One tank level threshold as an NMEA2000 alert (PGN 126983 status, 126985
+// text). evaluate() runs on every sample; a change of state makes the status
+// due at once instead of waiting for the next level frame. Acknowledge and
+// temporary silence arrive as PGN 126984 and go through respond().
+//
+// Only changed from nmea_task. The state flags are atomic so the web UI can
+// read active() from the httpd task meanwhile; the rest is nmea_task's alone.
+class LevelAlert {
+public:
+    explicit LevelAlert(bool high);
+
+    // Returns true when the alert changed state, i.e. a status is due now
+    bool evaluate(float level_percent, float threshold_percent, uint32_t now_ms);
+    bool respond(tN2kAlertResponseCommand command, uint64_t acknowledger, uint32_t now_ms);
+    uint32_t msUntilDue(uint32_t now_ms) const;  // UINT32_MAX if nothing to repeat
+    bool textDue() const { return textPending; }
+    void setStatus(tN2kMsg& msg, unsigned int alert_id, uint64_t source_name, unsigned char instance, uint32_t now_ms) const;
+    void setText(tN2kMsg& msg, unsigned int alert_id, uint64_t source_name, unsigned char instance, char* description) const;
+    void sent(uint32_t now_ms);
+
+    bool active() const { return isActive.load(std::memory_order_relaxed); }
+    bool isHigh() const { return high; }
+    tN2kAlertState state(uint32_t now_ms) const;
+
+private:
+    const bool high;
+    std::atomic<bool> isActive;
+    std::atomic<bool> acknowledged;
+    std::atomic<bool> silenced;
+    bool statusPending;
+    bool textPending;
+    uint8_t occurrence;
+    uint32_t silencedUntilMs;
+    uint32_t lastSentMs;
+    uint64_t acknowledgedBy;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef ATTITUDE_H
+#define ATTITUDE_H
+
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
+
+// Latest vessel pitch and roll from PGN 127257. Both angles are packed into
+// one 32-bit atomic in the bus resolution (1e-4 rad), so a reader always gets
+// a matching pair without a lock. A value older than timeoutMs counts as
+// missing, so a silent attitude source does not freeze a stale correction.
+class AttitudeSlot {
+public:
+    static constexpr float RESOLUTION = 1e-4f;  // rad
+    static constexpr uint32_t timeoutMs = 2000;
+
+    void set(float pitch, float roll, uint32_t now_ms) {
+        if (!std::isfinite(pitch) || !std::isfinite(roll)) return;
+        uint32_t packed = (uint16_t)pack(pitch) | ((uint32_t)(uint16_t)pack(roll) << 16);
+        _angles.store(packed, std::memory_order_relaxed);
+        _updatedMs.store(now_ms | 1, std::memory_order_release);  // 0 means never
+    }
+
+    bool get(float& pitch, float& roll, uint32_t now_ms) const {
+        uint32_t updated = _updatedMs.load(std::memory_order_acquire);
+        if (updated == 0 || now_ms - updated > timeoutMs) return false;
+        uint32_t packed = _angles.load(std::memory_order_relaxed);
+        pitch = (int16_t)(packed & 0xFFFF) * RESOLUTION;
+        roll = (int16_t)(packed >> 16) * RESOLUTION;
+        return true;
+    }
+
+private:
+    static int16_t pack(float angle) {
+        float ticks = std::round(angle / RESOLUTION);
+        if (ticks > INT16_MAX) return INT16_MAX;
+        if (ticks < INT16_MIN) return INT16_MIN;
+        return (int16_t)ticks;
+    }
+
+    std::atomic<uint32_t> _angles{0};
+    std::atomic<uint32_t> _updatedMs{0};
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "calibration.h"
+#include <algorithm>
+#include <cmath>
+
+LevelTransferFunction::LevelTransferFunction() : count(0) {}
+
+// End slope from the three-point formula, limited so the end segment stays
+// monotone
+static float endSlope(float h0, float h1, float delta0, float delta1) {
+    float slope = ((2 * h0 + h1) * delta0 - h0 * delta1) / (h0 + h1);
+    if (slope * delta0 <= 0) return 0.0;
+    if (delta0 * delta1 < 0 && std::fabs(slope) > 3 * std::fabs(delta0)) return 3 * delta0;
+    return slope;
+}
+
+void LevelTransferFunction::build(const std::vector<CalibrationPoint>& calibration) {
+    std::vector<CalibrationPoint> sorted = calibration;
+    std::stable_sort(sorted.begin(), sorted.end(),
+              [](const CalibrationPoint& a, const CalibrationPoint& b) { return a.distance < b.distance; });
+
+    count = 0;
+    for (const CalibrationPoint& point : sorted) {
+        if (count == MAX_CALIBRATION_POINTS) break;
+        if (count > 0 && point.distance <= distances[count - 1]) continue;  // Duplicate distance, keep the first given
+        distances[count] = point.distance;
+        percentages[count] = point.percentage;
+        count++;
+    }
+    if (count < 2) {
+        if (count == 1) slopes[0] = 0.0;
+        return;
+    }
+
+    // Secant slope of each segment
+    float delta[MAX_CALIBRATION_POINTS];
+    for (size_t i = 0; i + 1 < count; i++) {
+        delta[i] = (percentages[i + 1] - percentages[i]) / (distances[i + 1] - distances[i]);
+    }
+    if (count == 2) {
+        slopes[0] = slopes[1] = delta[0];
+        return;
+    }
+
+    // Interior tangents: zero at local extrema, otherwise the weighted
+    // harmonic mean of the neighbouring secants
+    for (size_t i = 1; i + 1 < count; i++) {
+        if (delta[i - 1] * delta[i] <= 0) {
+            slopes[i] = 0.0;
+            continue;
+        }
+        float h0 = distances[i] - distances[i - 1];
+        float h1 = distances[i + 1] - distances[i];
+        float w0 = 2 * h1 + h0;
+        float w1 = h1 + 2 * h0;
+        slopes[i] = (w0 + w1) / (w0 / delta[i - 1] + w1 / delta[i]);
+    }
+    size_t n = count - 1;
+    slopes[0] = endSlope(distances[1] - distances[0], distances[2] - distances[1], delta[0], delta[1]);
+    slopes[n] = endSlope(distances[n] - distances[n - 1], distances[n - 1] - distances[n - 2], delta[n - 1], delta[n - 2]);
+}
+
+float LevelTransferFunction::evaluate(float distance) const {
+    if (count == 0) return 0.0;
+    if (distance <= distances[0]) return percentages[0];
+    if (distance >= distances[count - 1]) return percentages[count - 1];
+
+    size_t i = std::upper_bound(distances, distances + count, distance) - distances - 1;
+    float h = distances[i + 1] - distances[i];
+    float t = (distance - distances[i]) / h;
+    float s = 1.0f - t;
+    // Cubic Hermite basis
+    return percentages[i] * (1 + 2 * t) * s * s + slopes[i] * h * t * s * s +
+           percentages[i + 1] * t * t * (3 - 2 * t) - slopes[i + 1] * h * t * t * s;
+}
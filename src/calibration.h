@@ -1,11 +1,36 @@
 #ifndef CALIBRATION_H
 #define CALIBRATION_H
 
+#include <stddef.h>
 #include <vector>
 
+#define MAX_CALIBRATION_POINTS 64
+
 struct CalibrationPoint {
     float distance;
     float percentage;
 };
 
-#endif // CALIBRATION_H
\ No newline at end of file
+// Distance -> level percentage table compiled once from calibration points.
+// Between breakpoints it follows a monotone cubic (PCHIP, Fritsch-Carlson):
+// smooth on curved hull tanks, but never overshooting the measured points,
+// so a table that only ever falls with distance gives a level that does too.
+// Breakpoints are kept sorted in flat arrays with the Hermite slopes
+// precomputed by build(), so evaluate() is a binary search plus one cubic
+// and never touches NVS or the heap.
+class LevelTransferFunction {
+public:
+    LevelTransferFunction();
+    void build(const std::vector<CalibrationPoint>& calibration);
+    float evaluate(float distance) const;
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    float distances[MAX_CALIBRATION_POINTS];
+    float percentages[MAX_CALIBRATION_POINTS];
+    float slopes[MAX_CALIBRATION_POINTS];  // d(percentage)/d(distance) at each breakpoint
+    size_t count;
+};
+
+#endif // CALIBRATION_H
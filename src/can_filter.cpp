@@ -0,0 +1,41 @@
+#include "can_filter.h"
+#include <algorithm>
+
+const unsigned long N2kSystemPgns[] = {
+    59392L,   // ISO acknowledgement
+    59904L,   // ISO request
+    60160L,   // ISO transport protocol, data transfer
+    60416L,   // ISO transport protocol, connection management
+    60928L,   // ISO address claim
+    126208L,  // Group function
+    // 65240 ISO commanded address is 9 bytes, so it only ever arrives
+    // inside ISO transport protocol frames (60160 and 60416)
+    0};
+
+void n2kPgnAcceptance(unsigned long pgn, uint32_t& id, uint32_t& care_mask) {
+    uint8_t pf = (pgn >> 8) & 0xFF;
+    id = (pgn & 0x3FFFF) << 8;
+    care_mask = 0x3FFFF << 8;                    // Data page + PDU format + PDU specific
+    if (pf < 240) {
+        id &= ~(0xFFUL << 8);                    // PDU1, PDU specific is the destination
+        care_mask &= ~(0xFFUL << 8);
+    }
+}
+
+uint32_t n2kPgnFromId(unsigned long id) {
+    uint32_t pgn = (id >> 8) & 0x3FFFF;
+    if (((pgn >> 8) & 0xFF) < 240) pgn &= ~0xFFUL;
+    return pgn;
+}
+
+std::vector<unsigned long> n2kReceivePgns(const unsigned long* pgns) {
+    std::vector<unsigned long> result;
+    for (const unsigned long* list : {pgns, N2kSystemPgns}) {
+        for (size_t i = 0; list && list[i] != 0; i++) {
+            if (std::find(result.begin(), result.end(), list[i]) == result.end()) {
+                result.push_back(list[i]);
+            }
+        }
+    }
+    return result;
+}
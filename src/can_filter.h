@@ -0,0 +1,22 @@
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include <stdint.h>
+#include <vector>
+
+// PGNs tNMEA2000 has to receive on its own to claim an address and answer
+// ISO requests, transport protocol sessions and group functions.
+extern const unsigned long N2kSystemPgns[];
+
+// 29-bit identifier and care mask (1 = bit must match) that accept every
+// frame of the given PGN. Priority and source address are don't-care; for
+// PDU1 PGNs the destination address is too, since ours can change.
+void n2kPgnAcceptance(unsigned long pgn, uint32_t& id, uint32_t& care_mask);
+
+// PGN carried by a 29-bit identifier, without the destination of PDU1 PGNs.
+uint32_t n2kPgnFromId(unsigned long id);
+
+// Zero-terminated application PGN list plus N2kSystemPgns, without duplicates.
+std::vector<unsigned long> n2kReceivePgns(const unsigned long* pgns);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CAN_TRANSPORT_H
+#define CAN_TRANSPORT_H
+
+#include <stdint.h>
+#include <vector>
+
+// Raw CAN frame transport used by N2kCanDriver. Implementations exist for the
+// ESP32 TWAI peripheral and for Linux SocketCAN, so the same tNMEA2000 stack
+// runs on the device and in a host process on a (virtual) CAN interface.
+// getFrame() never blocks; a receiver sleeps in waitForFrame() until frames
+// arrive and then drains them in one batch. setReceiveFilter() is called
+// before open() with every PGN the node needs; backends that can filter in
+// hardware or in the kernel reject all other traffic there.
+struct CanBusStatus_t {
+    const char* state;      // "running", "bus_off", "recovering" or "stopped"
+    uint32_t txErrors;      // TEC
+    uint32_t rxErrors;      // REC
+    uint32_t rxMissed;      // RX queue full
+    uint32_t rxOverrun;     // Controller FIFO overrun
+    uint32_t busErrors;
+    uint32_t arbLost;
+    uint32_t rxQueueHighWater;
+};
+
+class CanTransport {
+public:
+    virtual ~CanTransport() {}
+    virtual void setReceiveFilter(const std::vector<unsigned long>& pgns) {}
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) = 0;
+    virtual bool getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) = 0;
+    virtual bool waitForFrame(uint32_t timeout_ms) = 0;
+    virtual uint32_t getBusOffCount() const { return 0; }
+    virtual bool getBusStatus(CanBusStatus_t& status) const { return false; }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "can_tx_queue.h"
+
+CanTxQueue::CanTxQueue(size_t depth) : frames(depth > 0 ? depth : 1), count(0), rejecting(false), rejectingId(0) {}
+
+bool CanTxQueue::push(const CanFrame& frame, size_t& dropped) {
+    uint8_t prio = priority(frame.id);
+    dropped = 0;
+    if (!frame.continuation) {
+        rejecting = false;
+    } else if (rejecting && frame.id == rejectingId) {
+        return false;  // The start of its message is gone
+    }
+
+    if (count == frames.size()) {
+        if (prio >= priority(frames[count - 1].id)) {
+            if (frame.continuation) dropped = dropLastMessage(frame.id);
+            rejecting = true;  // The rest of this message must not follow on its own
+            rejectingId = frame.id;
+            return false;
+        }
+        dropped = dropLastMessage(frames[count - 1].id);  // Make room by dropping the least urgent message
+    }
+
+    // Insert behind every frame of the same or higher urgency
+    size_t pos = count;
+    while (pos > 0 && priority(frames[pos - 1].id) > prio) {
+        frames[pos] = frames[pos - 1];
+        pos--;
+    }
+    frames[pos] = frame;
+    count++;
+    return true;
+}
+
+// Frames of one message are queued back to back, so the last message is
+// the run of continuations at the tail plus the first frame before them.
+// Returns 0 if the last frame is not from id.
+size_t CanTxQueue::dropLastMessage(unsigned long id) {
+    size_t dropped = 0;
+    while (count > 0 && frames[count - 1].id == id) {
+        bool first = !frames[count - 1].continuation;
+        count--;
+        dropped++;
+        if (first) break;
+    }
+    return dropped;
+}
+
+void CanTxQueue::pop() {
+    if (count == 0) return;
+    for (size_t i = 1; i < count; i++) {
+        frames[i - 1] = frames[i];
+    }
+    count--;
+}
+
+size_t CanTxQueue::popMessage() {
+    if (count == 0) return 0;
+    unsigned long id = frames[0].id;
+    size_t n = 1;
+    while (n < count && frames[n].continuation && frames[n].id == id) n++;
+    for (size_t i = n; i < count; i++) {
+        frames[i - n] = frames[i];
+    }
+    count -= n;
+    return n;
+}
@@ -0,0 +1,53 @@
+#ifndef CAN_TX_QUEUE_H
+#define CAN_TX_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct CanFrame {
+    unsigned long id;
+    unsigned char len;
+    unsigned char data[8];
+    uint32_t queuedMs;
+    bool continuation;  // Fast-packet frame after the first of its message
+};
+
+// Software transmit queue in front of the CAN controller, ordered by the
+// 3-bit NMEA2000 priority in the identifier (0 is most urgent) and FIFO
+// within one priority, so fast-packet frames stay in sequence. Storage is
+// allocated once in the constructor. When full, a new frame evicts the
+// least urgent queued message if it is more urgent than that, else it is
+// rejected.
+//
+// A message is one single frame, or a fast-packet first frame and the
+// continuation frames queued right behind it. A receiver throws away a
+// fast-packet message with a frame missing, so frames are only ever
+// dropped by whole message: eviction takes the whole last message, and a
+// rejected continuation takes back the frames of its message already
+// queued and rejects the rest of them.
+class CanTxQueue {
+public:
+    CanTxQueue(size_t depth);
+    // dropped counts the frames removed to make room or to take back a
+    // rejected message, not including frame itself
+    bool push(const CanFrame& frame, size_t& dropped);
+    CanFrame& front() { return frames[0]; }
+    void pop();
+    size_t popMessage();  // Drops the front frame and its continuations, returns how many
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t depth() const { return frames.size(); }
+
+    static uint8_t priority(unsigned long id) { return (id >> 26) & 0x7; }
+
+private:
+    size_t dropLastMessage(unsigned long id);
+
+    std::vector<CanFrame> frames;
+    size_t count;
+    bool rejecting;  // Continuations of rejectingId are refused until the next first frame
+    unsigned long rejectingId;
+};
+
+#endif
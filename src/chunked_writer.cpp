@@ -0,0 +1,73 @@
+#include "chunked_writer.h"
+#include <esp_log.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "ChunkedWriter";
+
+ChunkedWriter::ChunkedWriter(httpd_req_t* req) : req(req), len(0), err(ESP_OK) {}
+
+void ChunkedWriter::flush() {
+    if (len == 0 || err != ESP_OK) return;
+    err = httpd_resp_send_chunk(req, buffer, len);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Failed to send chunk: %d", err);
+    len = 0;
+}
+
+ChunkedWriter& ChunkedWriter::print(const char* text) {
+    return write(text, strlen(text));
+}
+
+ChunkedWriter& ChunkedWriter::write(const void* data, size_t size) {
+    const char* text = (const char*)data;
+    size_t remaining = size;
+    while (remaining > 0 && err == ESP_OK) {
+        if (len == sizeof(buffer)) flush();
+        size_t n = sizeof(buffer) - len;
+        if (n > remaining) n = remaining;
+        memcpy(buffer + len, text, n);
+        len += n;
+        text += n;
+        remaining -= n;
+    }
+    return *this;
+}
+
+ChunkedWriter& ChunkedWriter::printf(const char* format, ...) {
+    if (err != ESP_OK) return *this;
+
+    // Format straight into the free tail of the buffer; if it does not fit,
+    // flush and format again into the whole buffer.
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + len, sizeof(buffer) - len, format, args);
+    va_end(args);
+    if (n < 0) {
+        err = ESP_FAIL;
+        return *this;
+    }
+    if ((size_t)n < sizeof(buffer) - len) {
+        len += n;
+        return *this;
+    }
+
+    flush();
+    if (err != ESP_OK) return *this;
+    va_start(args, format);
+    n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(buffer)) {
+        ESP_LOGE(TAG, "Formatted output of %d bytes exceeds the %d byte buffer", n, (int)sizeof(buffer));
+        err = ESP_ERR_INVALID_SIZE;
+        return *this;
+    }
+    len = n;
+    return *this;
+}
+
+esp_err_t ChunkedWriter::finish() {
+    flush();
+    if (err != ESP_OK) return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
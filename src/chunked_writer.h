@@ -0,0 +1,35 @@
+#ifndef CHUNKED_WRITER_H
+#define CHUNKED_WRITER_H
+
+#include <stddef.h>
+#include <esp_http_server.h>
+
+// Streams a response body through a small fixed buffer, handing it to
+// httpd_resp_send_chunk() whenever it fills. Meant to live on the handler's
+// stack, so a page costs CHUNKED_WRITER_BUFFER bytes however long it gets.
+// After the first failed send every further write is dropped and finish()
+// reports the error.
+#define CHUNKED_WRITER_BUFFER 256
+
+class ChunkedWriter {
+public:
+    explicit ChunkedWriter(httpd_req_t* req);
+
+    ChunkedWriter& print(const char* text);
+    ChunkedWriter& write(const void* data, size_t size);
+    ChunkedWriter& printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Sends what is buffered and terminates the chunked response
+    esp_err_t finish();
+    bool ok() const { return err == ESP_OK; }
+
+private:
+    void flush();
+
+    httpd_req_t* req;
+    char buffer[CHUNKED_WRITER_BUFFER];
+    size_t len;
+    esp_err_t err;
+};
+
+#endif
@@ -0,0 +1,332 @@
+#include "config_store.h"
+#include <esp_log.h>
+#include <nvs_flash.h>
+#include <algorithm>
+#include <string.h>
+
+static const char* TAG = "ConfigStore";
+static const uint32_t FlushTaskStackSize = 4096;
+static const UBaseType_t FlushTaskPriority = 1;  // Below every sensor and bus task
+static const uint64_t MaxRetryDelayUs = 60000000;
+
+// Errors that come back the same on every retry: the key, namespace or value
+// itself is unacceptable to NVS
+static bool isPermanent(esp_err_t err) {
+    return err == ESP_ERR_NVS_KEY_TOO_LONG || err == ESP_ERR_NVS_INVALID_NAME || err == ESP_ERR_NVS_VALUE_TOO_LONG ||
+           err == ESP_ERR_NVS_INVALID_LENGTH;
+}
+
+ConfigStore::ConfigStore(uint32_t debounce_ms)
+    : timer(NULL), flushTask(NULL), debounceUs((uint64_t)debounce_ms * 1000), retryDelayUs(0), commitCount(0) {}
+
+ConfigStore::~ConfigStore() {
+    if (timer) {
+        esp_timer_stop(timer);
+        esp_timer_delete(timer);
+    }
+    if (flushTask) vTaskDelete(flushTask);
+}
+
+ConfigStore::Entry* ConfigStore::find(const char* ns, const char* key, Type type) {
+    for (Entry& entry : entries) {
+        if (entry.type == type && entry.key == key && entry.ns == ns) return &entry;
+    }
+    return nullptr;
+}
+
+// Called with mutex held. Reads the entry through from NVS on the first access.
+ConfigStore::Entry* ConfigStore::cached(const char* ns, const char* key, Type type) {
+    Entry* entry = find(ns, key, type);
+    if (!entry) {
+        entries.push_back(Entry{ns, key, type, false, false, {}});
+        entry = &entries.back();
+        // A pending erase already hides whatever NVS still holds
+        if (std::find(erased.begin(), erased.end(), ns) == erased.end()) load(*entry);
+    }
+    return entry;
+}
+
+// Returns the cached value
+bool ConfigStore::get(const char* ns, const char* key, Type type, std::vector<uint8_t>& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = cached(ns, key, type);
+    if (!entry->exists) return false;
+    value = entry->value;
+    return true;
+}
+
+void ConfigStore::load(Entry& entry) {
+    nvs_handle_t nvs;
+    if (nvs_open(entry.ns.c_str(), NVS_READONLY, &nvs) != ESP_OK) return;  // Namespace not created yet
+
+    const char* key = entry.key.c_str();
+    std::vector<uint8_t>& value = entry.value;
+    esp_err_t ret = ESP_FAIL;
+    size_t len = 0;
+    switch (entry.type) {
+    case Type::U8: {
+        uint8_t v;
+        ret = nvs_get_u8(nvs, key, &v);
+        if (ret == ESP_OK) value.assign(&v, &v + 1);
+        break;
+    }
+    case Type::U32: {
+        uint32_t v;
+        ret = nvs_get_u32(nvs, key, &v);
+        if (ret == ESP_OK) value.assign((uint8_t*)&v, (uint8_t*)&v + sizeof(v));
+        break;
+    }
+    case Type::String:  // Cached without the terminator
+        ret = nvs_get_str(nvs, key, NULL, &len);
+        if (ret == ESP_OK && len > 0) {
+            value.resize(len);
+            ret = nvs_get_str(nvs, key, (char*)value.data(), &len);
+            value.resize(len - 1);
+        }
+        break;
+    case Type::Blob:
+        ret = nvs_get_blob(nvs, key, NULL, &len);
+        if (ret == ESP_OK) {
+            value.resize(len);
+            ret = nvs_get_blob(nvs, key, value.data(), &len);
+        }
+        break;
+    }
+    nvs_close(nvs);
+    entry.exists = (ret == ESP_OK);
+    if (!entry.exists) value.clear();
+}
+
+void ConfigStore::set(const char* ns, const char* key, Type type, const void* data, size_t size) {
+    std::vector<uint8_t> current;
+    bool exists = get(ns, key, type, current);  // Makes sure the entry is cached
+    const uint8_t* bytes = (const uint8_t*)data;
+    if (exists && current.size() == size && memcmp(current.data(), bytes, size) == 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = find(ns, key, type);
+    entry->value.assign(bytes, bytes + size);
+    entry->exists = true;
+    entry->dirty = true;
+    scheduleCommit(debounceUs);
+}
+
+bool ConfigStore::getU8(const char* ns, const char* key, uint8_t& value) {
+    std::vector<uint8_t> bytes;
+    if (!get(ns, key, Type::U8, bytes) || bytes.size() != sizeof(value)) return false;
+    value = bytes[0];
+    return true;
+}
+
+bool ConfigStore::getU32(const char* ns, const char* key, uint32_t& value) {
+    std::vector<uint8_t> bytes;
+    if (!get(ns, key, Type::U32, bytes) || bytes.size() != sizeof(value)) return false;
+    memcpy(&value, bytes.data(), sizeof(value));
+    return true;
+}
+
+bool ConfigStore::getString(const char* ns, const char* key, std::string& value) {
+    std::vector<uint8_t> bytes;
+    if (!get(ns, key, Type::String, bytes)) return false;
+    value.assign(bytes.begin(), bytes.end());
+    return true;
+}
+
+// Copies straight from the cache, for callers that must not allocate
+bool ConfigStore::getString(const char* ns, const char* key, char* value, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = cached(ns, key, Type::String);
+    if (!entry->exists || entry->value.size() >= size) return false;
+    memcpy(value, entry->value.data(), entry->value.size());
+    value[entry->value.size()] = '\0';
+    return true;
+}
+
+bool ConfigStore::getBlob(const char* ns, const char* key, void* data, size_t size) {
+    std::vector<uint8_t> bytes;
+    if (!get(ns, key, Type::Blob, bytes) || bytes.size() != size) return false;
+    memcpy(data, bytes.data(), size);
+    return true;
+}
+
+void ConfigStore::setU8(const char* ns, const char* key, uint8_t value) {
+    set(ns, key, Type::U8, &value, sizeof(value));
+}
+
+void ConfigStore::setU32(const char* ns, const char* key, uint32_t value) {
+    set(ns, key, Type::U32, &value, sizeof(value));
+}
+
+void ConfigStore::setString(const char* ns, const char* key, const std::string& value) {
+    set(ns, key, Type::String, value.data(), value.size());
+}
+
+void ConfigStore::setBlob(const char* ns, const char* key, const void* data, size_t size) {
+    set(ns, key, Type::Blob, data, size);
+}
+
+void ConfigStore::eraseNamespace(const char* ns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(erased.begin(), erased.end(), ns) == erased.end()) erased.push_back(ns);
+    for (Entry& entry : entries) {
+        if (entry.ns != ns) continue;
+        entry.exists = false;
+        entry.dirty = false;
+        entry.value.clear();
+    }
+    scheduleCommit(debounceUs);
+}
+
+// Called with mutex held. Every change pushes the commit out again, so a
+// form submit that touches many keys ends in a single commit.
+void ConfigStore::scheduleCommit(uint64_t delay_us) {
+    if (!flushTask && xTaskCreate(flushTaskMain, "config_flush", FlushTaskStackSize, this, FlushTaskPriority, &flushTask) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create flush task");
+        flushTask = NULL;
+        return;
+    }
+    if (!timer) {
+        esp_timer_create_args_t args = {};
+        args.callback = commitTimerCallback;
+        args.arg = this;
+        args.name = "config_commit";
+        esp_err_t ret = esp_timer_create(&args, &timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create commit timer: %d", ret);
+            timer = NULL;
+            return;
+        }
+    }
+    esp_timer_stop(timer);  // Not running is fine
+    esp_timer_start_once(timer, delay_us);
+}
+
+// Runs on the esp_timer task, which must not wait for flash
+void ConfigStore::commitTimerCallback(void* arg) {
+    xTaskNotifyGive(static_cast<ConfigStore*>(arg)->flushTask);
+}
+
+void ConfigStore::flushTaskMain(void* arg) {
+    ConfigStore* store = static_cast<ConfigStore*>(arg);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        store->flush();
+    }
+}
+
+void ConfigStore::flush() {
+    std::lock_guard<std::mutex> commit(commitLock);
+
+    // Take a copy of the pending work so flash writes happen unlocked
+    std::vector<std::string> erase_namespaces;
+    std::vector<Entry> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        erase_namespaces.swap(erased);
+        for (Entry& entry : entries) {
+            if (!entry.dirty) continue;
+            pending.push_back(entry);  // The copy stays dirty until its commit succeeds
+            entry.dirty = false;
+        }
+    }
+    if (erase_namespaces.empty() && pending.empty()) return;
+
+    std::vector<std::string> namespaces = erase_namespaces;
+    for (const Entry& entry : pending) {
+        if (std::find(namespaces.begin(), namespaces.end(), entry.ns) == namespaces.end()) namespaces.push_back(entry.ns);
+    }
+
+    std::vector<std::string> failed_erases;
+    for (const std::string& ns : namespaces) {
+        bool erase = std::find(erase_namespaces.begin(), erase_namespaces.end(), ns) != erase_namespaces.end();
+        nvs_handle_t nvs;
+        esp_err_t ret = nvs_open(ns.c_str(), NVS_READWRITE, &nvs);
+        if (ret != ESP_OK && isPermanent(ret)) {
+            ESP_LOGE(TAG, "NVS namespace '%s' is not usable: %d, dropping its changes", ns.c_str(), ret);
+            for (Entry& entry : pending) {
+                if (entry.ns == ns) entry.dirty = false;
+            }
+            continue;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open NVS namespace '%s': %d", ns.c_str(), ret);
+            if (erase) failed_erases.push_back(ns);
+            continue;
+        }
+        if (erase) {
+            ret = nvs_erase_all(nvs);
+            if (ret != ESP_OK) {
+                // Writing now would be undone by the retried erase
+                ESP_LOGE(TAG, "Failed to erase NVS namespace '%s': %d", ns.c_str(), ret);
+                failed_erases.push_back(ns);
+                nvs_close(nvs);
+                continue;
+            }
+        }
+
+        std::vector<Entry*> written;
+        for (Entry& entry : pending) {
+            if (entry.ns != ns) continue;
+            const char* key = entry.key.c_str();
+            switch (entry.type) {
+            case Type::U8:
+                ret = nvs_set_u8(nvs, key, entry.value[0]);
+                break;
+            case Type::U32: {
+                uint32_t value;
+                memcpy(&value, entry.value.data(), sizeof(value));
+                ret = nvs_set_u32(nvs, key, value);
+                break;
+            }
+            case Type::String: {
+                std::string value(entry.value.begin(), entry.value.end());
+                ret = nvs_set_str(nvs, key, value.c_str());
+                break;
+            }
+            case Type::Blob:
+                ret = nvs_set_blob(nvs, key, entry.value.data(), entry.value.size());
+                break;
+            }
+            if (ret != ESP_OK && isPermanent(ret)) {
+                ESP_LOGE(TAG, "NVS cannot store '%s/%s': %d, dropping it", ns.c_str(), key, ret);
+                entry.dirty = false;  // Kept in the cache, never retried
+            } else if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to set '%s/%s': %d", ns.c_str(), key, ret);
+            } else {
+                written.push_back(&entry);
+            }
+        }
+
+        ret = nvs_commit(nvs);
+        if (ret == ESP_OK) {
+            commitCount++;
+            ESP_LOGI(TAG, "Committed %d changed key(s) to NVS namespace '%s'", (int)written.size(), ns.c_str());
+            for (Entry* entry : written) entry->dirty = false;
+        } else {
+            ESP_LOGE(TAG, "Failed to commit NVS namespace '%s': %d", ns.c_str(), ret);
+        }
+        nvs_close(nvs);
+    }
+
+    // Put back what did not make it to flash. An entry erased or rewritten
+    // in the meantime already has its own pending state.
+    std::lock_guard<std::mutex> lock(mutex);
+    bool retry = false;
+    for (const std::string& ns : failed_erases) {
+        if (std::find(erased.begin(), erased.end(), ns) == erased.end()) erased.push_back(ns);
+        retry = true;
+    }
+    for (const Entry& entry : pending) {
+        if (!entry.dirty) continue;
+        Entry* current = find(entry.ns.c_str(), entry.key.c_str(), entry.type);
+        if (current && current->exists) current->dirty = true;
+        retry = true;
+    }
+    if (!retry) {
+        retryDelayUs = 0;
+        return;
+    }
+    retryDelayUs = retryDelayUs ? std::min(retryDelayUs * 2, MaxRetryDelayUs) : debounceUs;
+    ESP_LOGW(TAG, "Retrying failed NVS writes in %d ms", (int)(retryDelayUs / 1000));
+    scheduleCommit(retryDelayUs);
+}
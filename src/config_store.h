@@ -0,0 +1,80 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Write-behind cache in front of NVS for every namespace the firmware uses.
+// Reads are served from RAM after the first access. Writes that change a
+// value only mark it dirty and (re)arm a debounce timer; when it fires, it
+// wakes a low priority task that writes all pending changes with one
+// nvs_commit() per namespace, so flash writes never stall the esp_timer
+// task. Changes that fail to write stay dirty and are retried, first after
+// one debounce period and then at doubling intervals up to a minute apart.
+// A change NVS can never store (a key or namespace name over 15 characters,
+// a value too long) is dropped with one error instead: it stays in the
+// cache until reboot. Writing a value that is already stored costs nothing, so
+// callers can save whole settings blocks without checking what changed.
+//
+// Must not be used before nvs_flash_init(). Call flush() before a restart.
+class ConfigStore {
+public:
+    explicit ConfigStore(uint32_t debounce_ms = 2000);
+    ~ConfigStore();
+
+    bool getU8(const char* ns, const char* key, uint8_t& value);
+    bool getU32(const char* ns, const char* key, uint32_t& value);
+    bool getString(const char* ns, const char* key, std::string& value);
+    bool getString(const char* ns, const char* key, char* value, size_t size);  // false unless it fits with the terminator
+    bool getBlob(const char* ns, const char* key, void* data, size_t size);  // false unless exactly size bytes are stored
+
+    void setU8(const char* ns, const char* key, uint8_t value);
+    void setU32(const char* ns, const char* key, uint32_t value);
+    void setString(const char* ns, const char* key, const std::string& value);
+    void setBlob(const char* ns, const char* key, const void* data, size_t size);
+    void eraseNamespace(const char* ns);
+
+    // Writes pending changes now instead of waiting for the debounce
+    void flush();
+    uint32_t getCommitCount() const { return commitCount.load(std::memory_order_relaxed); }
+
+private:
+    enum class Type : uint8_t { U8, U32, String, Blob };
+
+    struct Entry {
+        std::string ns;
+        std::string key;
+        Type type;
+        bool exists;    // false if the key is not in NVS
+        bool dirty;
+        std::vector<uint8_t> value;
+    };
+
+    Entry* find(const char* ns, const char* key, Type type);
+    Entry* cached(const char* ns, const char* key, Type type);
+    static void load(Entry& entry);
+    bool get(const char* ns, const char* key, Type type, std::vector<uint8_t>& value);
+    void set(const char* ns, const char* key, Type type, const void* data, size_t size);
+    void scheduleCommit(uint64_t delay_us);
+    static void commitTimerCallback(void* arg);
+    static void flushTaskMain(void* arg);
+
+    std::mutex mutex;      // Guards entries and erased; never held during flash writes
+    std::mutex commitLock; // Serializes commits from the timer and flush()
+    std::vector<Entry> entries;
+    std::vector<std::string> erased;  // Namespaces to erase before the next writes
+    esp_timer_handle_t timer;
+    TaskHandle_t flushTask;
+    uint64_t debounceUs;
+    uint64_t retryDelayUs;  // Backoff after a failed flush, 0 while writes succeed
+    std::atomic<uint32_t> commitCount;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "distance_filter.h"
+
+DistanceFilter::DistanceFilter() {
+    configure(defaultSettings());
+}
+
+FilterSettings_t DistanceFilter::defaultSettings() {
+    FilterSettings_t defaults;
+    defaults.medianEnabled = 1;
+    defaults.medianWindow = 5;
+    defaults.kalmanEnabled = 1;
+    defaults.processNoise = 0.05;
+    defaults.measurementNoise = 1.0;
+    return defaults;
+}
+
+void DistanceFilter::configure(const FilterSettings_t& new_settings) {
+    settings = new_settings;
+    if (settings.medianWindow < 3) settings.medianWindow = 3;
+    if (settings.medianWindow > MAX_MEDIAN_WINDOW) settings.medianWindow = MAX_MEDIAN_WINDOW;
+    if (settings.medianWindow % 2 == 0) settings.medianWindow--;  // Odd window has a true middle
+    if (settings.processNoise <= 0) settings.processNoise = defaultSettings().processNoise;
+    if (settings.measurementNoise <= 0) settings.measurementNoise = defaultSettings().measurementNoise;
+    reset();
+}
+
+void DistanceFilter::reset() {
+    windowCount = 0;
+    windowPos = 0;
+    estimate = 0.0;
+    errorCovariance = 0.0;
+    kalmanInitialized = false;
+}
+
+float DistanceFilter::update(float distance) {
+    if (settings.medianEnabled) distance = medianUpdate(distance);
+    if (settings.kalmanEnabled) distance = kalmanUpdate(distance);
+    return distance;
+}
+
+float DistanceFilter::medianUpdate(float distance) {
+    window[windowPos] = distance;
+    windowPos = (windowPos + 1) % settings.medianWindow;
+    if (windowCount < settings.medianWindow) windowCount++;
+
+    // Insertion sort of a copy, the window is at most MAX_MEDIAN_WINDOW samples
+    float sorted[MAX_MEDIAN_WINDOW];
+    for (size_t i = 0; i < windowCount; i++) {
+        float value = window[i];
+        size_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[windowCount / 2];
+}
+
+float DistanceFilter::kalmanUpdate(float distance) {
+    if (!kalmanInitialized) {
+        estimate = distance;
+        errorCovariance = settings.measurementNoise;
+        kalmanInitialized = true;
+        return estimate;
+    }
+    errorCovariance += settings.processNoise;
+    float gain = errorCovariance / (errorCovariance + settings.measurementNoise);
+    estimate += gain * (distance - estimate);
+    errorCovariance *= (1.0f - gain);
+    return estimate;
+}
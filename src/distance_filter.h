@@ -0,0 +1,43 @@
+#ifndef DISTANCE_FILTER_H
+#define DISTANCE_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_MEDIAN_WINDOW 15
+
+struct FilterSettings_t {
+    uint8_t medianEnabled;
+    uint8_t medianWindow;     // samples, odd, 3..MAX_MEDIAN_WINDOW
+    uint8_t kalmanEnabled;
+    float processNoise;       // cm² per sample, how fast the level may really move
+    float measurementNoise;   // cm², variance of a single echo
+};
+
+// Two-stage filter for raw echo distances: a rolling median rejects single
+// bad echoes, then a 1-D Kalman filter smooths what is left. All state lives
+// in fixed-size members, so update() never allocates.
+class DistanceFilter {
+public:
+    DistanceFilter();
+    void configure(const FilterSettings_t& settings);
+    const FilterSettings_t& getSettings() const { return settings; }
+    float update(float distance);
+    void reset();
+
+    static FilterSettings_t defaultSettings();
+
+private:
+    float medianUpdate(float distance);
+    float kalmanUpdate(float distance);
+
+    FilterSettings_t settings;
+    float window[MAX_MEDIAN_WINDOW];
+    size_t windowCount;
+    size_t windowPos;
+    float estimate;
+    float errorCovariance;
+    bool kalmanInitialized;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef ECHO_CAPTURE_H
+#define ECHO_CAPTURE_H
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ring_buffer.h"
+
+// Echo pulse widths in capture timer ticks, filled by the capture ISR
+typedef SpscRingBuffer<uint32_t, 16> EchoRingBuffer;
+
+// Source of ultrasonic echo timings. start() must be called from the task
+// that consumes the samples; that task is notified on every captured echo.
+class EchoCapture {
+public:
+    EchoCapture() : _consumer(NULL), _resolution_hz(1000000) {}
+    virtual ~EchoCapture() {}
+    virtual bool start() = 0;
+    virtual void trigger() = 0;  // Fire one measurement
+
+    bool waitForEcho(TickType_t timeout) { return ulTaskNotifyTake(pdTRUE, timeout) > 0; }
+    EchoRingBuffer& samples() { return _samples; }
+    uint32_t getResolutionHz() const { return _resolution_hz; }
+
+protected:
+    EchoRingBuffer _samples;
+    TaskHandle_t _consumer;
+    uint32_t _resolution_hz;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "fake_echo_capture.h"
+#include "ultrasonic.h"
+#include <esp_log.h>
+
+static const char* TAG = "FakeEchoCapture";
+
+FakeEchoCapture::FakeEchoCapture() : _distance(70.0), _decreasing(true) {}
+
+bool FakeEchoCapture::start() {
+    _consumer = xTaskGetCurrentTaskHandle();
+    ESP_LOGI(TAG, "Fake echo capture started, resolution=%lu Hz", (unsigned long)_resolution_hz);
+    return true;
+}
+
+void FakeEchoCapture::trigger() {
+    if (_decreasing) {
+        _distance += 0.2;
+        if (_distance >= 120.0) _decreasing = false;
+    } else {
+        _distance -= 0.2;
+        if (_distance <= 20.0) _decreasing = true;
+    }
+    _samples.push(Ultrasonic::distanceToPulse(_distance, _resolution_hz));
+    xTaskNotifyGive(_consumer);
+}
@@ -0,0 +1,22 @@
+#ifndef FAKE_ECHO_CAPTURE_H
+#define FAKE_ECHO_CAPTURE_H
+
+#include "echo_capture.h"
+
+// Host-side capture source: every trigger produces the echo a sensor would
+// return for a level sweeping between 20 and 120 cm, through the same ring
+// buffer and notification path as the hardware capture.
+class FakeEchoCapture : public EchoCapture {
+public:
+    FakeEchoCapture();
+
+    bool start() override;
+    void trigger() override;
+    void setDistance(float distance) { _distance = distance; }
+
+private:
+    float _distance;
+    bool _decreasing;
+};
+
+#endif
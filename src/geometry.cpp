@@ -0,0 +1,95 @@
+#include "geometry.h"
+#include <cmath>
+#include <string.h>
+
+// All models take the fill height h as a fraction of the tank height and
+// return the filled fraction of the total volume.
+
+static double linearFill(double h, double) {
+    return h;
+}
+
+// Circular segment area over the circle area. Also exact for an elliptical
+// cross-section, which is a circle scaled along one axis.
+static double horizontalCylinderFill(double h, double) {
+    double x = 1.0 - 2.0 * h;
+    return (std::acos(x) - x * std::sqrt(1.0 - x * x)) / M_PI;
+}
+
+// Spherical cap over the sphere volume
+static double sphereFill(double h, double) {
+    return h * h * (3.0 - 2.0 * h);
+}
+
+// Trapezoidal cross-section (V-hull), ratio = bottom width / top width.
+// The width grows linearly with height, so the volume is its integral.
+static double wedgeFill(double h, double ratio) {
+    return (ratio * h + (1.0 - ratio) * h * h / 2.0) / ((1.0 + ratio) / 2.0);
+}
+
+// Box whose bottom slopes across the whole length, ratio = height of the
+// sloped part / tank height. Below the top of the slope the liquid fills a
+// triangular prism, above it the full footprint.
+static double slopedBottomFill(double h, double ratio) {
+    if (ratio <= 0.0) return h;
+    double total = 1.0 - ratio / 2.0;
+    if (h < ratio) return h * h / (2.0 * ratio) / total;
+    return (h - ratio / 2.0) / total;
+}
+
+// Horizontal cylinder with hemispherical ends, ratio = length of the
+// cylindrical part / diameter. The two ends together make one sphere.
+static double capsuleFill(double h, double ratio) {
+    double cylinder = 1.5 * ratio;  // cylinder volume relative to the end sphere
+    return (cylinder * horizontalCylinderFill(h, 0) + sphereFill(h, 0)) / (cylinder + 1.0);
+}
+
+const TankShapeModel tank_shape_models[] = {
+    {"rectangular", nullptr, 0.0, 0.0, 0.0, linearFill},
+    {"cylindrical standing", nullptr, 0.0, 0.0, 0.0, linearFill},
+    {"cylindrical laying flat", nullptr, 0.0, 0.0, 0.0, horizontalCylinderFill},
+    {"elliptical laying flat", nullptr, 0.0, 0.0, 0.0, horizontalCylinderFill},
+    {"wedge", "bottom width / top width", 0.3, 0.0, 1.0, wedgeFill},
+    {"sloped bottom", "slope height / tank height", 0.25, 0.0, 1.0, slopedBottomFill},
+    {"spherical", nullptr, 0.0, 0.0, 0.0, sphereFill},
+    {"capsule", "cylinder length / diameter", 2.0, 0.0, 20.0, capsuleFill},
+};
+const size_t tank_shape_model_count = sizeof(tank_shape_models) / sizeof(tank_shape_models[0]);
+
+const TankShapeModel* findTankShape(const char* name) {
+    for (size_t i = 0; i < tank_shape_model_count; i++) {
+        if (strcmp(tank_shape_models[i].name, name) == 0) return &tank_shape_models[i];
+    }
+    return nullptr;
+}
+
+TankGeometry::TankGeometry() : compiled(true) {
+    for (size_t i = 0; i <= GEOMETRY_TABLE_SEGMENTS; i++) {
+        table[i] = (float)i / GEOMETRY_TABLE_SEGMENTS;
+    }
+}
+
+float TankGeometry::build(const char* shape, float ratio) {
+    const TankShapeModel* model = findTankShape(shape);
+    if (!model) {
+        compiled = false;
+        return ratio;
+    }
+
+    if (!std::isfinite(ratio) || ratio < model->minRatio || ratio > model->maxRatio) ratio = model->defaultRatio;
+    for (size_t i = 0; i <= GEOMETRY_TABLE_SEGMENTS; i++) {
+        table[i] = (float)model->fill((double)i / GEOMETRY_TABLE_SEGMENTS, ratio);
+    }
+    compiled = true;
+    return ratio;
+}
+
+float TankGeometry::fillFraction(float height) const {
+    if (height <= 0) return table[0];
+    if (height >= 1) return table[GEOMETRY_TABLE_SEGMENTS];
+
+    float x = height * GEOMETRY_TABLE_SEGMENTS;
+    size_t i = (size_t)x;
+    if (i >= GEOMETRY_TABLE_SEGMENTS) return table[GEOMETRY_TABLE_SEGMENTS];
+    return table[i] + (x - i) * (table[i + 1] - table[i]);
+}
@@ -0,0 +1,44 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <stddef.h>
+
+#define GEOMETRY_TABLE_SEGMENTS 64
+
+// Volume model for one tank shape. fill() maps the fill height as a fraction
+// of the tank height to the filled fraction of the volume, exactly, in
+// double precision. Shapes with a free proportion take it as ratio, within
+// minRatio..maxRatio; ratioLabel is null for shapes without one.
+struct TankShapeModel {
+    const char* name;
+    const char* ratioLabel;
+    float defaultRatio;
+    float minRatio;
+    float maxRatio;
+    double (*fill)(double height, double ratio);
+};
+
+extern const TankShapeModel tank_shape_models[];
+extern const size_t tank_shape_model_count;
+
+const TankShapeModel* findTankShape(const char* name);
+
+// Height -> volume table compiled from a shape model whenever the settings
+// change, so a measurement costs one multiply and a linear interpolation
+// between GEOMETRY_TABLE_SEGMENTS + 1 precomputed points. A default
+// constructed geometry is the linear (rectangular) one. Shapes that are not
+// in the model list, i.e. "custom", leave the table empty.
+class TankGeometry {
+public:
+    TankGeometry();
+    // Returns the ratio actually used: the default if ratio is out of range
+    float build(const char* shape, float ratio);
+    float fillFraction(float height) const;  // both 0..1
+    bool empty() const { return !compiled; }
+
+private:
+    float table[GEOMETRY_TABLE_SEGMENTS + 1];
+    bool compiled;
+};
+
+#endif
@@ -0,0 +1,302 @@
+#include "history.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <cmath>
+#include <string.h>
+#include <time.h>
+
+static const char* TAG = "History";
+
+#define HISTORY_SLOTS_PER_PAGE (HISTORY_PAGE_SIZE / HISTORY_RECORD_SIZE)
+#define HISTORY_SLOTS_PER_SECTOR (HISTORY_SECTOR_SIZE / HISTORY_RECORD_SIZE)
+#define HISTORY_EMPTY_TIME 0xFFFFFFFF  // time of an erased record slot
+
+static const uint32_t WriterTaskStackSize = 3072;
+static const UBaseType_t WriterTaskPriority = 1;  // Below ultrasonicTask and nmeaTask
+
+// First record slot of every sector
+struct SectorHeader_t {
+    uint32_t magic;
+    uint32_t sequence;  // Grows by one for every sector the log moves into
+    uint8_t reserved[HISTORY_RECORD_SIZE - 8];
+};
+static_assert(sizeof(SectorHeader_t) == HISTORY_RECORD_SIZE, "sector header takes one record slot");
+
+FlashRingLog::FlashRingLog(uint32_t magic)
+    : magic(magic), partition(nullptr), firstSector(0), sectorCount(0),
+      headSector(0), nextSlot(0), sequence(0) {}
+
+bool FlashRingLog::begin(const esp_partition_t* partition, size_t first_sector, size_t sector_count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->partition = nullptr;
+    if (!partition || sector_count < 2 ||
+        (first_sector + sector_count) * HISTORY_SECTOR_SIZE > partition->size) {
+        ESP_LOGE(TAG, "Invalid log range: sectors %d..%d", (int)first_sector, (int)(first_sector + sector_count));
+        return false;
+    }
+    firstSector = first_sector;
+    sectorCount = sector_count;
+
+    // The newest sector has the highest sequence number
+    bool found = false;
+    for (size_t s = 0; s < sectorCount; s++) {
+        SectorHeader_t header;
+        if (esp_partition_read(partition, sectorOffset(s), &header, sizeof(header)) != ESP_OK) continue;
+        if (header.magic != magic) continue;
+        if (!found || (int32_t)(header.sequence - sequence) > 0) {
+            headSector = s;
+            sequence = header.sequence;
+            found = true;
+        }
+    }
+    this->partition = partition;
+
+    if (!found) {
+        // Fresh log: the first append erases and starts sector 0
+        headSector = sectorCount - 1;
+        nextSlot = HISTORY_SLOTS_PER_SECTOR;
+        sequence = 0;
+        ESP_LOGI(TAG, "Log %08x: empty, %d sectors", (unsigned)magic, (int)sectorCount);
+        return true;
+    }
+
+    // Find the first erased slot in the head sector
+    nextSlot = HISTORY_SLOTS_PER_SECTOR;
+    for (size_t p = 0; p < HISTORY_SLOTS_PER_SECTOR / HISTORY_SLOTS_PER_PAGE; p++) {
+        if (esp_partition_read(partition, sectorOffset(headSector) + p * HISTORY_PAGE_SIZE, page, sizeof(page)) != ESP_OK) break;
+        for (size_t i = (p == 0 ? 1 : 0); i < HISTORY_SLOTS_PER_PAGE; i++) {
+            uint32_t time;
+            memcpy(&time, page + i * HISTORY_RECORD_SIZE, sizeof(time));
+            if (time == HISTORY_EMPTY_TIME) {
+                nextSlot = p * HISTORY_SLOTS_PER_PAGE + i;
+                break;
+            }
+        }
+        if (nextSlot < HISTORY_SLOTS_PER_SECTOR) break;
+    }
+    ESP_LOGI(TAG, "Log %08x: resuming in sector %d at slot %d", (unsigned)magic, (int)headSector, (int)nextSlot);
+    return true;
+}
+
+bool FlashRingLog::append(const HistoryRecord_t& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!partition) return false;
+
+    if (nextSlot >= HISTORY_SLOTS_PER_SECTOR) {
+        headSector = (headSector + 1) % sectorCount;
+        sequence++;
+        esp_err_t ret = esp_partition_erase_range(partition, sectorOffset(headSector), HISTORY_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase history sector: %d", ret);
+            nextSlot = HISTORY_SLOTS_PER_SECTOR;  // Try the next sector next time
+            return false;
+        }
+        SectorHeader_t header = {};
+        header.magic = magic;
+        header.sequence = sequence;
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, &header, sizeof(header));
+        nextSlot = 1;
+    } else if (nextSlot % HISTORY_SLOTS_PER_PAGE == 0) {
+        memset(page, 0xFF, sizeof(page));
+    }
+
+    // Program the whole page. Slots written before are programmed with the
+    // bytes they already hold and free slots stay erased, so this only ever
+    // clears bits in the new slot.
+    memcpy(page + (nextSlot % HISTORY_SLOTS_PER_PAGE) * HISTORY_RECORD_SIZE, &record, sizeof(record));
+    size_t offset = sectorOffset(headSector) + (nextSlot / HISTORY_SLOTS_PER_PAGE) * HISTORY_PAGE_SIZE;
+    esp_err_t ret = esp_partition_write(partition, offset, page, sizeof(page));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write history page: %d", ret);
+        return false;
+    }
+    nextSlot++;
+    return true;
+}
+
+bool FlashRingLog::forEach(uint32_t from, uint32_t to, HistoryVisitor visit, void* ctx) {
+    size_t head;
+    size_t end_slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!partition) return true;
+        head = headSector;
+        end_slot = nextSlot;
+    }
+
+    uint8_t buffer[HISTORY_PAGE_SIZE];
+    for (size_t k = 1; k <= sectorCount; k++) {
+        size_t s = (head + k) % sectorCount;  // Oldest sector first, head last
+        size_t slots = (s == head) ? end_slot : HISTORY_SLOTS_PER_SECTOR;
+        for (size_t slot = 0; slot < slots; slot += HISTORY_SLOTS_PER_PAGE) {
+            {
+                // Keeps the page from being erased halfway through the read
+                std::lock_guard<std::mutex> lock(mutex);
+                if (esp_partition_read(partition, sectorOffset(s) + slot * HISTORY_RECORD_SIZE,
+                                       buffer, sizeof(buffer)) != ESP_OK) {
+                    break;
+                }
+            }
+            if (slot == 0) {
+                SectorHeader_t header;
+                memcpy(&header, buffer, sizeof(header));
+                if (header.magic != magic) break;  // Never written
+            }
+
+            for (size_t i = (slot == 0 ? 1 : 0); i < HISTORY_SLOTS_PER_PAGE && slot + i < slots; i++) {
+                HistoryRecord_t record;
+                memcpy(&record, buffer + i * HISTORY_RECORD_SIZE, sizeof(record));
+                if (record.time == HISTORY_EMPTY_TIME) break;
+                if (record.time < from || record.time > to) continue;
+                if (!visit(record, ctx)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Closes the running period into closed when uptime has moved past it,
+// then adds level to the new one. The caller stamps closed.
+bool LevelHistory::Accumulator::add(uint32_t uptime, uint32_t period_s, const uint16_t* level, HistoryRecord_t& closed) {
+    uint32_t start = uptime - uptime % period_s;
+    bool emitted = false;
+    if (open && start != period) {
+        memset(&closed, 0, sizeof(closed));
+        closed.uptime = period;
+        for (size_t i = 0; i < MAX_TANKS; i++) {
+            closed.level[i] = count[i] ? (uint16_t)((sum[i] + count[i] / 2) / count[i]) : HISTORY_NO_DATA;
+        }
+        emitted = true;
+    }
+    if (!open || emitted) {
+        open = true;
+        period = start;
+        memset(sum, 0, sizeof(sum));
+        memset(count, 0, sizeof(count));
+    }
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        if (level[i] == HISTORY_NO_DATA) continue;
+        sum[i] += level[i];
+        count[i]++;
+    }
+    return emitted;
+}
+
+// Sector magics, "HMIN" and "HHRS"
+LevelHistory::LevelHistory()
+    : recentHead(0), recentCount(0), seconds(), minutes(), hours(),
+      minuteLog(0x4E494D48), hourLog(0x53524848), boot(0), writes(NULL) {}
+
+void LevelHistory::begin(ConfigStore* config) {
+    uint32_t boots = 0;
+    config->getU32("history", "boot_count", boots);
+    boot = (uint16_t)(boots + 1);
+    config->setU32("history", "boot_count", boot);
+    config->flush();  // Two boots must never share a number
+    ESP_LOGI(TAG, "Boot %u", (unsigned)boot);
+
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "history");
+    if (!partition) {
+        ESP_LOGW(TAG, "No history partition, keeping the last %d s in RAM only", HISTORY_RAM_SECONDS);
+        return;
+    }
+    size_t sectors = partition->size / HISTORY_SECTOR_SIZE;
+    if (sectors < 2 * HISTORY_HOUR_SECTORS) {
+        ESP_LOGE(TAG, "History partition too small: %d bytes", (int)partition->size);
+        return;
+    }
+    minuteLog.begin(partition, 0, sectors - HISTORY_HOUR_SECTORS);
+    hourLog.begin(partition, sectors - HISTORY_HOUR_SECTORS, HISTORY_HOUR_SECTORS);
+
+    writes = xQueueCreate(HISTORY_WRITE_QUEUE, sizeof(PendingWrite));
+    if (!writes || xTaskCreate(writerTask, "history_writer", WriterTaskStackSize, this, WriterTaskPriority, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the history writer, keeping the last %d s in RAM only", HISTORY_RAM_SECONDS);
+        if (writes) vQueueDelete(writes);
+        writes = NULL;
+    }
+}
+
+// Erasing a sector takes tens of milliseconds, far too long to stall a
+// measurement round for
+void LevelHistory::writerTask(void* arg) {
+    LevelHistory* history = static_cast<LevelHistory*>(arg);
+    PendingWrite write;
+    while (true) {
+        if (xQueueReceive(history->writes, &write, portMAX_DELAY) != pdTRUE) continue;
+        write.log->append(write.record);
+    }
+}
+
+void LevelHistory::queueWrite(FlashRingLog& log, const HistoryRecord_t& record) {
+    if (!writes) return;
+    PendingWrite write = {&log, record};
+    if (xQueueSend(writes, &write, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "History write queue full, dropping the record at uptime %lu", (unsigned long)record.uptime);
+    }
+}
+
+// Dates a record whose period started at uptime. The offset to the system
+// clock is taken now, so a clock set halfway through the period still dates
+// its start correctly.
+void LevelHistory::stamp(HistoryRecord_t& record, uint32_t uptime) const {
+    record.boot = boot;
+    time_t now = time(NULL);
+    uint32_t now_uptime = (uint32_t)(esp_timer_get_time() / 1000000);
+    record.time = (now >= HISTORY_MIN_VALID_TIME) ? (uint32_t)(now - (now_uptime - uptime)) : 0;
+}
+
+void LevelHistory::addSample(const float* level_percent, size_t num_tanks) {
+    uint16_t level[MAX_TANKS];
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        if (i >= num_tanks || !std::isfinite(level_percent[i])) {
+            level[i] = HISTORY_NO_DATA;
+        } else {
+            float percent = std::fmin(std::fmax(level_percent[i], 0.0f), 100.0f);
+            level[i] = (uint16_t)std::lround(percent * 100.0f);
+        }
+    }
+
+    HistoryRecord_t second, minute, hour;
+    if (!seconds.add((uint32_t)(esp_timer_get_time() / 1000000), 1, level, second)) return;
+    stamp(second, second.uptime);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        recent[recentHead] = second;
+        recentHead = (recentHead + 1) % HISTORY_RAM_SECONDS;
+        if (recentCount < HISTORY_RAM_SECONDS) recentCount++;
+    }
+
+    if (!minutes.add(second.uptime, 60, second.level, minute)) return;
+    stamp(minute, minute.uptime);
+    queueWrite(minuteLog, minute);
+    if (!hours.add(minute.uptime, 3600, minute.level, hour)) return;
+    stamp(hour, hour.uptime);
+    queueWrite(hourLog, hour);
+}
+
+bool LevelHistory::forEach(uint32_t resolution_s, uint32_t from, uint32_t to, HistoryVisitor visit, void* ctx) {
+    if (resolution_s >= 3600) return hourLog.forEach(from, to, visit, ctx);
+    if (resolution_s >= 60) return minuteLog.forEach(from, to, visit, ctx);
+
+    // RAM tier, one record copied out at a time so the lock is never held
+    // while the visitor sends
+    size_t count;
+    size_t oldest;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        count = recentCount;
+        oldest = (recentHead + HISTORY_RAM_SECONDS - recentCount) % HISTORY_RAM_SECONDS;
+    }
+    for (size_t i = 0; i < count; i++) {
+        HistoryRecord_t record;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            record = recent[(oldest + i) % HISTORY_RAM_SECONDS];
+        }
+        if (record.time < from || record.time > to) continue;
+        if (!visit(record, ctx)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,119 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "config_store.h"
+#include "tank.h"
+
+#define HISTORY_RAM_SECONDS 600      // 1 s samples kept in RAM
+#define HISTORY_NO_DATA 0xFFFF
+#define HISTORY_RECORD_SIZE 16
+#define HISTORY_PAGE_SIZE 256        // Flash program page
+#define HISTORY_SECTOR_SIZE 4096     // Flash erase sector
+#define HISTORY_MIN_VALID_TIME 1577836800  // 2020-01-01, the clock is not set before this
+#define HISTORY_WRITE_QUEUE 8        // Closed minutes and hours waiting for flash
+
+// One averaged sample of every tank. Levels are in 0.01 % steps. A tank
+// without valid readings in the period holds HISTORY_NO_DATA.
+//
+// Periods are timed by boot and uptime, which are always valid: boot counts
+// restarts and uptime is seconds since the period's boot. time is the Unix
+// time the period started, or 0 if the system clock had not been set yet.
+// The clock is set from PGN 126992 when a time source is on the bus; it
+// restarts near zero on every boot, so without one only (boot, uptime)
+// orders records.
+struct HistoryRecord_t {
+    uint32_t time;
+    uint16_t level[MAX_TANKS];
+    uint16_t boot;
+    uint32_t uptime;
+};
+static_assert(sizeof(HistoryRecord_t) == HISTORY_RECORD_SIZE, "history records must tile flash pages");
+
+typedef bool (*HistoryVisitor)(const HistoryRecord_t& record, void* ctx);  // false stops the walk
+
+// Append-only record log over a range of flash sectors, used as a ring.
+// Each sector starts with a header carrying a sequence number, so the
+// write position is found again after a reboot. A record is written by
+// programming the page-aligned page that holds it; bytes already written
+// are never changed, and a sector is only erased when the log wraps into
+// it, dropping its oldest records.
+class FlashRingLog {
+public:
+    explicit FlashRingLog(uint32_t magic);
+    bool begin(const esp_partition_t* partition, size_t first_sector, size_t sector_count);
+    bool append(const HistoryRecord_t& record);
+    // Visits the records with from <= time <= to, oldest first. Reads one
+    // page at a time into a stack buffer. Returns false if visit stopped it.
+    bool forEach(uint32_t from, uint32_t to, HistoryVisitor visit, void* ctx);
+
+private:
+    size_t sectorOffset(size_t sector) const { return (firstSector + sector) * HISTORY_SECTOR_SIZE; }
+
+    std::mutex mutex;  // Orders flash erase/program against readers
+    const uint32_t magic;
+    const esp_partition_t* partition;
+    size_t firstSector;
+    size_t sectorCount;
+    size_t headSector;  // Sector being filled
+    size_t nextSlot;    // Next free record slot in headSector, slot 0 is the header
+    uint32_t sequence;
+    uint8_t page[HISTORY_PAGE_SIZE];  // Copy of the page holding nextSlot
+};
+
+// Level history in three tiers: the last HISTORY_RAM_SECONDS 1 s averages
+// in RAM, and 1 min and 1 h averages in flash ring logs in the "history"
+// partition. The minute log takes most of the partition; the hour log gets
+// the last HISTORY_HOUR_SECTORS sectors so it reaches back much further.
+#define HISTORY_HOUR_SECTORS 4
+
+class LevelHistory {
+public:
+    LevelHistory();
+    // Finds the partition, recovers the write positions, bumps the boot
+    // counter in config and starts the flash writer task
+    void begin(ConfigStore* config);
+    // Called after every measurement round. Never waits for flash: closed
+    // minutes and hours are queued for the writer task.
+    void addSample(const float* level_percent, size_t num_tanks);
+    // resolution_s is 1, 60 or 3600. Records without a Unix time only match
+    // from == 0.
+    bool forEach(uint32_t resolution_s, uint32_t from, uint32_t to, HistoryVisitor visit, void* ctx);
+
+private:
+    struct Accumulator {
+        bool open;        // A period is being averaged
+        uint32_t period;  // Its start, in uptime seconds
+        uint32_t sum[MAX_TANKS];
+        uint16_t count[MAX_TANKS];
+        bool add(uint32_t uptime, uint32_t period_s, const uint16_t* level, HistoryRecord_t& closed);
+    };
+
+    struct PendingWrite {
+        FlashRingLog* log;
+        HistoryRecord_t record;
+    };
+
+    void stamp(HistoryRecord_t& record, uint32_t uptime) const;
+    void queueWrite(FlashRingLog& log, const HistoryRecord_t& record);
+    static void writerTask(void* arg);
+
+    std::mutex mutex;  // Guards the RAM tier
+    HistoryRecord_t recent[HISTORY_RAM_SECONDS];
+    size_t recentHead;
+    size_t recentCount;
+    Accumulator seconds;
+    Accumulator minutes;
+    Accumulator hours;
+    FlashRingLog minuteLog;
+    FlashRingLog hourLog;
+    uint16_t boot;
+    QueueHandle_t writes;  // PendingWrite, drained by writerTask
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+JsonWriter::JsonWriter(char* buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity), len(0), overflow(false), depth(0), hasItems(0), afterKey(false) {
+    if (capacity > 0) buffer[0] = '\0';
+}
+
+void JsonWriter::raw(const char* text, size_t n) {
+    if (overflow || len + n >= capacity) {
+        overflow = true;
+        return;
+    }
+    memcpy(buffer + len, text, n);
+    len += n;
+    buffer[len] = '\0';
+}
+
+void JsonWriter::separator() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (hasItems & (1UL << depth)) raw(',');
+    hasItems |= (1UL << depth);
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separator();
+    raw('{');
+    if (++depth >= 32) overflow = true;
+    hasItems &= ~(1UL << depth);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    raw('}');
+    if (depth > 0) depth--;
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separator();
+    raw('[');
+    if (++depth >= 32) overflow = true;
+    hasItems &= ~(1UL << depth);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    raw(']');
+    if (depth > 0) depth--;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    string(name);
+    raw(':');
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(const char* value) {
+    separator();
+    raw('"');
+    for (const char* p = value; *p; p++) {
+        char c = *p;
+        if (c == '"' || c == '\\') {
+            raw('\\');
+            raw(c);
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            int n = snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            raw(escaped, n);
+        } else {
+            raw(c);
+        }
+    }
+    raw('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(float value, int decimals) {
+    separator();
+    if (!isfinite(value)) {
+        raw("null", 4);
+        return *this;
+    }
+    char text[24];
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    raw(text, n);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(uint32_t value) {
+    separator();
+    char text[12];
+    int n = snprintf(text, sizeof(text), "%lu", (unsigned long)value);
+    raw(text, n);
+    return *this;
+}
+
+JsonWriter& JsonWriter::boolean(bool value) {
+    separator();
+    if (value) {
+        raw("true", 4);
+    } else {
+        raw("false", 5);
+    }
+    return *this;
+}
@@ -0,0 +1,43 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal JSON serializer writing into a caller-owned buffer. Commas and
+// nesting are tracked in a bitmask, so there is no heap use and only a few
+// bytes of state. If the buffer runs out the output is cut off and ok()
+// turns false; the caller should then send an error instead.
+class JsonWriter {
+public:
+    JsonWriter(char* buffer, size_t capacity);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(const char* name);
+    JsonWriter& string(const char* value);
+    JsonWriter& number(float value, int decimals = 2);  // NaN and inf become null
+    JsonWriter& number(uint32_t value);
+    JsonWriter& boolean(bool value);
+
+    const char* c_str() const { return buffer; }
+    size_t length() const { return len; }
+    bool ok() const { return !overflow && depth == 0; }
+
+private:
+    void separator();
+    void raw(const char* text, size_t n);
+    void raw(char c) { raw(&c, 1); }
+
+    char* buffer;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+    uint8_t depth;
+    uint32_t hasItems;    // bit n: level n already holds a value
+    bool afterKey;
+};
+
+#endif
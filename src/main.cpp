@@ -1,28 +1,59 @@
 #include <algorithm> // For std::find_if
-#include <vector>
+#include <cmath>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include "history.h"
 #include "n2k_can_driver.h"
+#include "tank_reporter.h"
 #include "ultrasonic.h"
 #include "web_server.h"
-#include "N2kMessages.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
+#include <sdkconfig.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include "socketcan_transport.h"
+#include "fake_echo_capture.h"
+#else
+#include "twai_transport.h"
+#include "mcpwm_echo_capture.h"
 #include <esp_wifi.h>
 #include <esp_netif.h>
 #include <esp_event.h>
+#endif
 #include <inttypes.h>
 #include <string.h>
 
 static const char* TAG = "Main";
 
-N2kCanDriver NMEA2000(GPIO_NUM_27, GPIO_NUM_26, GPIO_NUM_23);
-Ultrasonic sensor;
-WebServer webServer(&NMEA2000, &sensor);
+#if CONFIG_IDF_TARGET_LINUX
+SocketCanTransport canTransport("vcan0");
+FakeEchoCapture echoCaptures[MAX_TANKS];
+#else
+TwaiTransport canTransport(GPIO_NUM_27, GPIO_NUM_26, GPIO_NUM_23);
+McpwmEchoCapture echoCaptures[MAX_TANKS] = {  // Trigger, echo
+    {GPIO_NUM_5, GPIO_NUM_18},
+    {GPIO_NUM_4, GPIO_NUM_19},
+    {GPIO_NUM_32, GPIO_NUM_33}};
+#endif
+ConfigStore configStore;
+N2kCanDriver NMEA2000(&canTransport, &configStore);
+Ultrasonic sensors[MAX_TANKS];
+LevelHistory levelHistory;
+WebServer webServer(&NMEA2000, &configStore, &levelHistory, sensors, MAX_TANKS);
+TxScheduler txSchedulers[MAX_TANKS];
+TankReporter tankReporter(&NMEA2000, &webServer, txSchedulers);
+CanRxHandoff rxHandoff;
+TaskHandle_t nmeaTaskHandle = NULL;
 
 const unsigned long DeviceSerial = 123457;
 const unsigned short ProductCode = 2001;
 
+const uint32_t EchoTimeoutMs = 40;  // HC-SR04 drops the echo line after ~38 ms without an echo
+const uint32_t EchoSettleMs = 20;   // Let reverberation die out before the next trigger
+const uint32_t CanRxWaitMs = 1000;
+
+#if !CONFIG_IDF_TARGET_LINUX
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT) {
         switch (event_id) {
@@ -46,20 +77,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
     }
 }
-
-void Handle127505(const tN2kMsg &N2kMsg) {
-    uint8_t instance;
-    tN2kFluidType fluidType;
-    double level;
-    double capacity;
-
-    if (ParseN2kFluidLevel(N2kMsg, instance, fluidType, level, capacity)) {
-        ESP_LOGI("NMEA2000", "PGN 127505: Instance=%d, FluidType=%d, Level=%.2f%%, Capacity=%.2f liters",
-                 instance, fluidType, level * 100, capacity);
-    } else {
-        ESP_LOGW("NMEA2000", "Failed to parse PGN 127505");
-    }
-}
+#endif
 
 void setupNMEA2000() {
     ESP_LOGI(TAG, "Setting up NMEA2000...");
@@ -67,62 +85,122 @@ void setupNMEA2000() {
     NMEA2000.SetDeviceInformation(DeviceSerial, 130, 75, 2046);
     NMEA2000.SetMode(tNMEA2000::N2km_NodeOnly);
     NMEA2000.EnableForward(false);
-    NMEA2000.SetMsgHandler([](const tN2kMsg& msg) {
-        if (msg.PGN == 127505) {
-            Handle127505(msg);
-        }
-    });
+    static const unsigned long ReceiveMessages[] = {126984L, 126992L, 127257L, 127505L, 130312L, 130316L, 0};
+    NMEA2000.ExtendReceiveMessages(ReceiveMessages);
+    static const unsigned long TransmitMessages[] = {126983L, 126985L, 127505L, 0};
+    NMEA2000.ExtendTransmitMessages(TransmitMessages);
+    NMEA2000.SetMsgHandler([](const tN2kMsg& msg) { tankReporter.handleMessage(msg); });
     NMEA2000.Init();
     ESP_LOGI(TAG, "NMEA2000 initialized");
 }
 
-void sendFluidLevel() {
-    static unsigned long last_sent = 0;
-    unsigned long now = esp_timer_get_time() / 1000;
-    uint32_t interval = NMEA2000.getTransmissionInterval();
-
-    if (now - last_sent >= interval) {
-        float level_percent = sensor.getLevelPercentage();
-        tN2kMsg N2kMsg;
-        SetN2kFluidLevel(N2kMsg, 0, N2kft_Water, level_percent / 100.0, webServer.getTankVolumeLiters());
-        if (!NMEA2000.SendMsg(N2kMsg)) {
-            ESP_LOGW(TAG, "Failed to send NMEA2000 message, PGN: %lu", N2kMsg.PGN);
-        } else {
-            ESP_LOGI(TAG, "Sent NMEA2000 message, PGN: %lu", N2kMsg.PGN);
+// Sleeps in the transport until frames arrive and hands them to nmeaTask,
+// see CanRxHandoff
+void canRxTask(void* pvParameters) {
+    while (1) {
+        if (NMEA2000.waitForFrame(CanRxWaitMs)) {
+            rxHandoff.handOff(nmeaTaskHandle, CanRxWaitMs);
         }
-        webServer.checkAndSendAlarms();
-        last_sent = now;
     }
 }
 
+// Sleeps until a CAN frame arrives (canRxTask), a new measurement is ready
+// (ultrasonicTask) or the next fluid level frame is due. The sleep is capped
+// so tNMEA2000 still gets to run its address claim and heartbeat timers.
 void nmeaTask(void* pvParameters) {
     ESP_LOGI(TAG, "NMEA task started");
     setupNMEA2000();
 
+    TaskHandle_t rx_task = NULL;
+    if (NMEA2000.isOpen()) {
+        xTaskCreate(canRxTask, "can_rx_task", 3072, NULL, 5, &rx_task);
+    }
+
+    // Stagger the first heartbeats so the tanks stay spread over the interval
+    uint32_t now = esp_timer_get_time() / 1000;
+    tankReporter.resetSchedules(now);
+
+    uint32_t wakeups = 0;
+    uint32_t stats_start = now;
+    uint32_t stats_frames = NMEA2000.getRxFrameCount();
     while (1) {
         NMEA2000.ParseMessages();
-        vTaskDelay(pdMS_TO_TICKS(10));
+        rxHandoff.answer(rx_task);
+        uint32_t wait_ms = tankReporter.sendAlerts();  // Before the level frames, so alerts go out first
+        wait_ms = std::min(wait_ms, tankReporter.sendFluidLevel());
+        NMEA2000.pumpTxQueue();
+        if (NMEA2000.hasPendingTx()) wait_ms = std::min(wait_ms, TankReporter::FrameGapMs);
+
+        wakeups++;
+        now = esp_timer_get_time() / 1000;
+        if (now - stats_start >= 60000) {
+            CanTxStats_t tx = NMEA2000.getTxStats();
+            ESP_LOGI(TAG, "NMEA task: %lu wakeups, %lu frames received in the last minute",
+                     (unsigned long)wakeups, (unsigned long)(NMEA2000.getRxFrameCount() - stats_frames));
+            ESP_LOGI(TAG, "CAN TX: %lu sent, %lu retries, %lu dropped, %lu bus-off",
+                     (unsigned long)tx.sent, (unsigned long)tx.retries, (unsigned long)tx.dropped, (unsigned long)tx.busOff);
+            wakeups = 0;
+            stats_start = now;
+            stats_frames = NMEA2000.getRxFrameCount();
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
     }
 }
 
-void simulateUltrasonicTask(void* pvParameters) {
-    ESP_LOGI(TAG, "Starting ultrasonic simulation...");
-    float simulated_distance = 70.0;
-    bool decreasing = true;
+// Transducers are fired one at a time so one tank's echo can't be
+// picked up by another tank's receiver.
+void ultrasonicTask(void* pvParameters) {
+    ESP_LOGI(TAG, "Starting ultrasonic echo capture...");
+    bool started[MAX_TANKS];
+    bool any_started = false;
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        started[i] = echoCaptures[i].start();
+        if (!started[i]) {
+            ESP_LOGE(TAG, "Echo capture for tank %d failed to start", (int)i + 1);
+        }
+        any_started |= started[i];
+    }
+    if (!any_started) {
+        ESP_LOGE(TAG, "No echo capture started, ultrasonic task exiting");
+        vTaskDelete(NULL);
+        return;
+    }
 
     while (1) {
-        if (decreasing) {
-            simulated_distance += 2.0;
-            if (simulated_distance >= 120.0) decreasing = false;
-        } else {
-            simulated_distance -= 2.0;
-            if (simulated_distance <= 20.0) decreasing = true;
+        bool triggered = false;
+        for (size_t i = 0; i < webServer.getNumTanks(); i++) {
+            if (!started[i]) continue;
+            triggered = true;
+            echoCaptures[i].trigger();
+            echoCaptures[i].waitForEcho(pdMS_TO_TICKS(EchoTimeoutMs));
+            if (sensors[i].consumeEchoes(echoCaptures[i].samples(), echoCaptures[i].getResolutionHz())) {
+                webServer.getTank(i).update();
+            }
+            if (nmeaTaskHandle) xTaskNotifyGive(nmeaTaskHandle);
+            vTaskDelay(pdMS_TO_TICKS(EchoSettleMs));
+        }
+        // The configured tanks may all be ones whose capture failed; the
+        // round must still block so IDLE gets to run
+        if (!triggered) vTaskDelay(pdMS_TO_TICKS(EchoSettleMs));
+        webServer.publishLevels();
+
+        float levels[MAX_TANKS];
+        for (size_t i = 0; i < webServer.getNumTanks(); i++) {
+            levels[i] = started[i] ? webServer.getTank(i).getLevelPercentage() : NAN;
         }
-        sensor.setSimulatedDistance(simulated_distance);
-        vTaskDelay(pdMS_TO_TICKS(500));
+        levelHistory.addSample(levels, webServer.getNumTanks());
     }
 }
 
+#if CONFIG_IDF_TARGET_LINUX
+void webServerTask(void* pvParameters) {
+    ESP_LOGI(TAG, "Web server task started (host build, no WiFi)");
+    webServer.start();
+    ESP_LOGI(TAG, "Web server startup completed");
+    vTaskDelete(NULL);
+}
+#else
 void wifiScanTask(void* pvParameters) {
     std::string stored_ssid, stored_password;
     webServer.loadWiFiConfig(stored_ssid, stored_password);
@@ -255,6 +333,7 @@ start_server:
     vTaskDelay(pdMS_TO_TICKS(5000));
     vTaskDelete(NULL);
 }
+#endif
 
 extern "C" void app_main() {
     ESP_LOGI(TAG, "Starting app_main...");
@@ -266,19 +345,15 @@ extern "C" void app_main() {
     }
     ESP_LOGI(TAG, "NVS initialized");
 
+    NMEA2000.loadSettings();
     webServer.loadSettingFromNVS();
-
-    std::vector<CalibrationPoint> calibration;
-    webServer.loadCalibrationFromNVS(calibration);
-    if (!calibration.empty()) {
-        webServer.updateCalibration(calibration);
-    }
+    levelHistory.begin(&configStore);
 
     vTaskDelay(pdMS_TO_TICKS(2000));
     ESP_LOGI(TAG, "Starting tasks...");
     xTaskCreate(webServerTask, "web_server_task", 24576, NULL, 5, NULL);
-    xTaskCreate(nmeaTask, "nmea_task", 8192, NULL, 4, NULL);
-    xTaskCreate(simulateUltrasonicTask, "ultrasonic_sim", 4096, NULL, 4, NULL);
+    xTaskCreate(nmeaTask, "nmea_task", 8192, NULL, 4, &nmeaTaskHandle);
+    xTaskCreate(ultrasonicTask, "ultrasonic_task", 4096, NULL, 4, NULL);
 
     ESP_LOGI(TAG, "Entering main loop...");
     while (1) {
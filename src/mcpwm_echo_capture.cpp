@@ -0,0 +1,84 @@
+#include "mcpwm_echo_capture.h"
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_rom_sys.h>
+
+static const char* TAG = "EchoCapture";
+
+mcpwm_cap_timer_handle_t McpwmEchoCapture::_timer = NULL;
+
+McpwmEchoCapture::McpwmEchoCapture(gpio_num_t trig_pin, gpio_num_t echo_pin)
+    : _trig_pin(trig_pin), _echo_pin(echo_pin), _channel(NULL), _rise_ticks(0) {}
+
+bool McpwmEchoCapture::startTimer() {
+    if (_timer != NULL) return true;
+
+    mcpwm_capture_timer_config_t timer_config = {};
+    timer_config.clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT;
+    timer_config.group_id = 0;
+    esp_err_t ret = mcpwm_new_capture_timer(&timer_config, &_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create capture timer: %d", ret);
+        _timer = NULL;
+        return false;
+    }
+    mcpwm_capture_timer_enable(_timer);
+    mcpwm_capture_timer_start(_timer);
+    return true;
+}
+
+bool McpwmEchoCapture::start() {
+    _consumer = xTaskGetCurrentTaskHandle();
+
+    if (!startTimer()) {
+        return false;
+    }
+
+    mcpwm_capture_channel_config_t channel_config = {};
+    channel_config.gpio_num = _echo_pin;
+    channel_config.prescale = 1;
+    channel_config.flags.pos_edge = true;
+    channel_config.flags.neg_edge = true;
+    channel_config.flags.pull_up = true;
+    esp_err_t ret = mcpwm_new_capture_channel(_timer, &channel_config, &_channel);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create capture channel on pin %d: %d", _echo_pin, ret);
+        return false;
+    }
+
+    mcpwm_capture_event_callbacks_t callbacks = {};
+    callbacks.on_cap = onCapture;
+    mcpwm_capture_channel_register_event_callbacks(_channel, &callbacks, this);
+    mcpwm_capture_channel_enable(_channel);
+
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = (1ULL << _trig_pin);
+    io_conf.mode = GPIO_MODE_OUTPUT;
+    io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+    gpio_config(&io_conf);
+    gpio_set_level(_trig_pin, 0);
+
+    mcpwm_capture_timer_get_resolution(_timer, &_resolution_hz);
+    ESP_LOGI(TAG, "Echo capture started, trig=%d echo=%d, resolution=%lu Hz", _trig_pin, _echo_pin, (unsigned long)_resolution_hz);
+    return true;
+}
+
+void McpwmEchoCapture::trigger() {
+    gpio_set_level(_trig_pin, 1);
+    esp_rom_delay_us(10);
+    gpio_set_level(_trig_pin, 0);
+}
+
+bool IRAM_ATTR McpwmEchoCapture::onCapture(mcpwm_cap_channel_handle_t channel, const mcpwm_capture_event_data_t* edata, void* user_ctx) {
+    McpwmEchoCapture* self = static_cast<McpwmEchoCapture*>(user_ctx);
+    BaseType_t task_woken = pdFALSE;
+    if (edata->cap_edge == MCPWM_CAP_EDGE_POS) {
+        self->_rise_ticks = edata->cap_value;
+    } else {
+        self->_samples.push(edata->cap_value - self->_rise_ticks);
+        vTaskNotifyGiveFromISR(self->_consumer, &task_woken);
+    }
+    return task_woken == pdTRUE;
+}
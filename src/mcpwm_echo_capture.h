@@ -0,0 +1,31 @@
+#ifndef MCPWM_ECHO_CAPTURE_H
+#define MCPWM_ECHO_CAPTURE_H
+
+#include "echo_capture.h"
+#include <driver/gpio.h>
+#include <driver/mcpwm_cap.h>
+
+// HC-SR04 style trigger/echo sensor timed with the MCPWM capture peripheral.
+// Both echo edges are timestamped in hardware; the ISR pushes the pulse width.
+// All instances share one capture timer in MCPWM group 0, which leaves room
+// for one echo channel per tank (the group has three).
+class McpwmEchoCapture : public EchoCapture {
+public:
+    McpwmEchoCapture(gpio_num_t trig_pin = GPIO_NUM_5, gpio_num_t echo_pin = GPIO_NUM_18);
+
+    bool start() override;
+    void trigger() override;
+
+private:
+    static bool onCapture(mcpwm_cap_channel_handle_t channel, const mcpwm_capture_event_data_t* edata, void* user_ctx);
+
+    gpio_num_t _trig_pin;
+    gpio_num_t _echo_pin;
+    static bool startTimer();
+
+    static mcpwm_cap_timer_handle_t _timer;
+    mcpwm_cap_channel_handle_t _channel;
+    uint32_t _rise_ticks;
+};
+
+#endif
@@ -1,108 +1,157 @@
 #include "n2k_can_driver.h"
+#include "can_filter.h"
 #include <esp_log.h>
-#include <nvs_flash.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <string.h>
 #include <string>
 
 static const char* TAG = "N2kCanDriver";
+static const uint32_t TxFrameTimeoutMs = 250;  // A level message older than this is stale anyway
 
-N2kCanDriver::N2kCanDriver(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t rs_pin) 
-    : _tx_pin(tx_pin), _rx_pin(rx_pin), _rs_pin(rs_pin), _is_open(false), _transmission_interval_ms(1000) {
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open("nmea_config", NVS_READWRITE, &nvs);
-    if (err == ESP_OK) {
-        char name[32] = "Ultrasonic Level Sensor";
-        size_t len = sizeof(name);
-        nvs_get_str(nvs, "device_name", name, &len);
-        _device_name = name;
-        nvs_get_u32(nvs, "tx_interval", &_transmission_interval_ms);
-        nvs_close(nvs);
-    } else {
-        _device_name = "Ultrasonic Level Sensor";
-        _transmission_interval_ms = 1000;
+N2kCanDriver::N2kCanDriver(CanTransport* transport, ConfigStore* config, size_t tx_queue_depth)
+    : _transport(transport), _config(config), _is_open(false), _device_name("Ultrasonic Level Sensor"), _transmission_interval_ms(1000),
+      _min_transmission_interval_ms(250), _level_deadband(0.5), _rx_frames(0), _receive_pgns(NULL), _tx_queue(tx_queue_depth),
+      _tx_sent(0), _tx_retries(0), _tx_dropped(0), _tx_queue_high_water(0) {}
+
+void N2kCanDriver::loadSettings() {
+    _config->getString("nmea_config", "device_name", _device_name);
+    uint32_t interval_ms;
+    if (_config->getU32("nmea_config", "tx_interval", interval_ms)) {
+        _transmission_interval_ms.store(interval_ms, std::memory_order_relaxed);
+    }
+    if (_config->getU32("nmea_config", "tx_min_interval", interval_ms)) {
+        _min_transmission_interval_ms.store(interval_ms, std::memory_order_relaxed);
+    }
+    uint32_t deadband_tenths;
+    if (_config->getU32("nmea_config", "tx_deadband", deadband_tenths)) {  // 0.1 % steps
+        _level_deadband.store(deadband_tenths / 10.0f, std::memory_order_relaxed);
     }
 }
 
+void N2kCanDriver::ExtendReceiveMessages(const unsigned long* messages, int iDev) {
+    tNMEA2000::ExtendReceiveMessages(messages, iDev);
+    _receive_pgns = messages;
+}
+
 void N2kCanDriver::Init() {
-    gpio_config_t io_conf = {};
-    io_conf.pin_bit_mask = (1ULL << _rs_pin);
-    io_conf.mode = GPIO_MODE_OUTPUT;
-    io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    io_conf.intr_type = GPIO_INTR_DISABLE;
-    gpio_config(&io_conf);
-    gpio_set_level(_rs_pin, 0);
-    ESP_LOGI(TAG, "RS pin %d set low for high-speed mode", _rs_pin);
-
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(_tx_pin, _rx_pin, TWAI_MODE_NORMAL);
-    g_config.tx_queue_len = 5;
-    g_config.rx_queue_len = 5;
-    g_config.alerts_enabled = TWAI_ALERT_NONE;
-    g_config.clkout_divider = 0;
-    g_config.intr_flags = ESP_INTR_FLAG_LEVEL1;
-    g_config.controller_id = 0;
-
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_250KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-
-    if (twai_driver_install(&g_config, &t_config, &f_config) == ESP_OK) {
-        ESP_LOGI(TAG, "TWAI driver installed");
-        if (twai_start() == ESP_OK) {
-            ESP_LOGI(TAG, "TWAI driver started");
-            _is_open = true;
-        } else {
-            ESP_LOGE(TAG, "Failed to start TWAI driver");
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to install TWAI driver");
+    _transport->setReceiveFilter(n2kReceivePgns(_receive_pgns));
+    _is_open = _transport->open();
+    if (!_is_open) {
+        ESP_LOGE(TAG, "Failed to open CAN transport");
     }
 }
 
+bool N2kCanDriver::waitForFrame(uint32_t timeout_ms) {
+    if (!_is_open) return false;
+    return _transport->waitForFrame(timeout_ms);
+}
+
 N2kCanDriver::~N2kCanDriver() {
     if (_is_open) {
-        twai_stop();
-        twai_driver_uninstall();
-        ESP_LOGI(TAG, "TWAI driver stopped and uninstalled");
+        _transport->close();
+        _is_open = false;
     }
-    gpio_set_level(_rs_pin, 1);
 }
 
 void N2kCanDriver::setDeviceName(const std::string& name) {
     _device_name = name.substr(0, 31);
-    nvs_handle_t nvs;
-    if (nvs_open("nmea_config", NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_str(nvs, "device_name", _device_name.c_str());
-        nvs_commit(nvs);
-        nvs_close(nvs);
-    }
+    _config->setString("nmea_config", "device_name", _device_name);
 }
 
-std::string N2kCanDriver::getDeviceName() const {
+const std::string& N2kCanDriver::getDeviceName() const {
     return _device_name;
 }
 
 void N2kCanDriver::setTransmissionInterval(uint32_t interval_ms) {
-    _transmission_interval_ms = (interval_ms < 500) ? 500 : (interval_ms > 10000 ? 10000 : interval_ms);
-    nvs_handle_t nvs;
-    if (nvs_open("nmea_config", NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_u32(nvs, "tx_interval", _transmission_interval_ms);
-        nvs_commit(nvs);
-        nvs_close(nvs);
-    }
+    interval_ms = (interval_ms < 500) ? 500 : (interval_ms > 10000 ? 10000 : interval_ms);
+    _transmission_interval_ms.store(interval_ms, std::memory_order_relaxed);
+    _config->setU32("nmea_config", "tx_interval", interval_ms);
 }
 
 uint32_t N2kCanDriver::getTransmissionInterval() const {
-    return _transmission_interval_ms;
+    return _transmission_interval_ms.load(std::memory_order_relaxed);
+}
+
+void N2kCanDriver::setMinTransmissionInterval(uint32_t interval_ms) {
+    interval_ms = (interval_ms < 100) ? 100 : (interval_ms > 10000 ? 10000 : interval_ms);
+    _min_transmission_interval_ms.store(interval_ms, std::memory_order_relaxed);
+    _config->setU32("nmea_config", "tx_min_interval", interval_ms);
+}
+
+uint32_t N2kCanDriver::getMinTransmissionInterval() const {
+    return _min_transmission_interval_ms.load(std::memory_order_relaxed);
+}
+
+void N2kCanDriver::setLevelDeadband(float deadband_percent) {
+    deadband_percent = (deadband_percent < 0.1) ? 0.1 : (deadband_percent > 25.0 ? 25.0 : deadband_percent);
+    _level_deadband.store(deadband_percent, std::memory_order_relaxed);
+    _config->setU32("nmea_config", "tx_deadband", (uint32_t)(deadband_percent * 10.0 + 0.5));
+}
+
+float N2kCanDriver::getLevelDeadband() const {
+    return _level_deadband.load(std::memory_order_relaxed);
+}
+
+TxScheduleSettings_t N2kCanDriver::getTxSchedule() const {
+    TxScheduleSettings_t settings;
+    settings.deadband = _level_deadband.load(std::memory_order_relaxed);
+    settings.maxIntervalMs = _transmission_interval_ms.load(std::memory_order_relaxed);
+    settings.minIntervalMs = std::min(_min_transmission_interval_ms.load(std::memory_order_relaxed), settings.maxIntervalMs);
+    return settings;
 }
 
+// Frames are queued instead of blocking on the controller; wait_sent is
+// honoured only in the sense that a queued frame is kept until it is sent
+// or expires.
 bool N2kCanDriver::CANSendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) {
-    if (!_is_open) return false;
-    twai_message_t message = {};
-    message.identifier = id;
-    message.data_length_code = len;
-    message.extd = 1;
-    memcpy(message.data, buf, len);
-    esp_err_t result = twai_transmit(&message, wait_sent ? pdMS_TO_TICKS(10) : 0);
-    return (result == ESP_OK);
+    if (!_is_open || len > 8) return false;
+    CanFrame frame;
+    frame.id = id;
+    frame.len = len;
+    memcpy(frame.data, buf, len);
+    frame.queuedMs = esp_timer_get_time() / 1000;
+    frame.continuation = len > 0 && (buf[0] & 0x1F) != 0 && IsFastPacketPGN(n2kPgnFromId(id));  // Low 5 bits count the frames
+
+    size_t dropped;
+    bool queued = _tx_queue.push(frame, dropped);
+    _tx_dropped.fetch_add(dropped + (queued ? 0 : 1), std::memory_order_relaxed);
+    if (_tx_queue.size() > _tx_queue_high_water.load(std::memory_order_relaxed)) {
+        _tx_queue_high_water.store(_tx_queue.size(), std::memory_order_relaxed);
+    }
+    pumpTxQueue();
+    return queued;
+}
+
+void N2kCanDriver::pumpTxQueue() {
+    uint32_t now = esp_timer_get_time() / 1000;
+    while (!_tx_queue.empty()) {
+        CanFrame& frame = _tx_queue.front();
+        if (_transport->sendFrame(frame.id, frame.len, frame.data, false)) {
+            _tx_sent.fetch_add(1, std::memory_order_relaxed);
+            _tx_pgns.increment(n2kPgnFromId(frame.id));
+            _tx_queue.pop();
+        } else if (!frame.continuation && now - frame.queuedMs >= TxFrameTimeoutMs) {
+            // Expires with its continuations. Once the first frame is out
+            // the rest never expire; dropping them would waste what was sent.
+            ESP_LOGW(TAG, "Dropping CAN message 0x%08lx after %lu ms", frame.id, (unsigned long)(now - frame.queuedMs));
+            _tx_dropped.fetch_add(_tx_queue.popMessage(), std::memory_order_relaxed);
+        } else {
+            _tx_retries.fetch_add(1, std::memory_order_relaxed);  // Controller busy or recovering, try again on the next pump
+            break;
+        }
+    }
+}
+
+CanTxStats_t N2kCanDriver::getTxStats() const {
+    CanTxStats_t stats;
+    stats.sent = _tx_sent.load(std::memory_order_relaxed);
+    stats.retries = _tx_retries.load(std::memory_order_relaxed);
+    stats.dropped = _tx_dropped.load(std::memory_order_relaxed);
+    stats.queueHighWater = _tx_queue_high_water.load(std::memory_order_relaxed);
+    stats.busOff = _transport->getBusOffCount();
+    stats.queued = _tx_queue.size();
+    return stats;
 }
 
 bool N2kCanDriver::CANOpen() {
@@ -111,14 +160,8 @@ bool N2kCanDriver::CANOpen() {
 
 bool N2kCanDriver::CANGetFrame(unsigned long& id, unsigned char& len, unsigned char* buf) {
     if (!_is_open) return false;
-    twai_message_t message;
-    if (twai_receive(&message, pdMS_TO_TICKS(10)) == ESP_OK) {
-        if (message.extd) {
-            id = message.identifier;
-            len = message.data_length_code;
-            memcpy(buf, message.data, len);
-            return true;
-        }
-    }
-    return false;
+    if (!_transport->getFrame(id, len, buf)) return false;
+    _rx_frames.fetch_add(1, std::memory_order_relaxed);
+    _rx_pgns.increment(n2kPgnFromId(id));
+    return true;
 }//last known n2k_can_driver.cpp
\ No newline at end of file
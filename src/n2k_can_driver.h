@@ -2,22 +2,49 @@
 #define N2K_CAN_DRIVER_H
 
 #include "NMEA2000.h"
-#include <driver/twai.h>
-#include <driver/gpio.h>
+#include "can_transport.h"
+#include "can_tx_queue.h"
+#include "config_store.h"
+#include "pgn_counters.h"
+#include "tx_scheduler.h"
+#include <atomic>
 #include <string>
 
+struct CanTxStats_t {
+    uint32_t sent;
+    uint32_t retries;   // transmit attempts refused by the controller
+    uint32_t dropped;   // queue overflow or frames that expired while waiting
+    uint32_t busOff;
+    size_t queued;
+    size_t queueHighWater;
+};
+
 class N2kCanDriver : public tNMEA2000 {
 public:
-    N2kCanDriver(gpio_num_t tx_pin = GPIO_NUM_27, 
-                 gpio_num_t rx_pin = GPIO_NUM_26, 
-                 gpio_num_t rs_pin = GPIO_NUM_23);
+    N2kCanDriver(CanTransport* transport, ConfigStore* config, size_t tx_queue_depth = 32);
     virtual ~N2kCanDriver();
-    void Init();  // Manual TWAI init
+    void loadSettings();  // Needs NVS, so not done in the constructor
+    void Init();  // Manual transport init
+    void ExtendReceiveMessages(const unsigned long* messages, int iDev = 0);  // Also sets the RX acceptance filter
+    bool waitForFrame(uint32_t timeout_ms);  // Sleeps until frames arrive, see CanTransport
+    void pumpTxQueue();  // Hands queued frames to the controller, never blocks
+    bool hasPendingTx() const { return !_tx_queue.empty(); }
+    CanTxStats_t getTxStats() const;
+    bool isOpen() const { return _is_open; }
+    uint32_t getRxFrameCount() const { return _rx_frames.load(std::memory_order_relaxed); }
+    bool getBusStatus(CanBusStatus_t& status) const { return _transport->getBusStatus(status); }
+    const PgnCounters<32>& getRxPgnCounters() const { return _rx_pgns; }
+    const PgnCounters<32>& getTxPgnCounters() const { return _tx_pgns; }
 
     void setDeviceName(const std::string& name);
-    std::string getDeviceName() const;
+    const std::string& getDeviceName() const;
     void setTransmissionInterval(uint32_t interval_ms);
     uint32_t getTransmissionInterval() const;
+    void setMinTransmissionInterval(uint32_t interval_ms);
+    uint32_t getMinTransmissionInterval() const;
+    void setLevelDeadband(float deadband_percent);
+    float getLevelDeadband() const;
+    TxScheduleSettings_t getTxSchedule() const;
 
 protected:
     bool CANSendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent = true) override;
@@ -25,12 +52,24 @@ protected:
     bool CANGetFrame(unsigned long& id, unsigned char& len, unsigned char* buf) override;
 
 private:
-    gpio_num_t _tx_pin;
-    gpio_num_t _rx_pin;
-    gpio_num_t _rs_pin;
+    CanTransport* _transport;
+    ConfigStore* _config;
     bool _is_open;
     std::string _device_name;
-    uint32_t _transmission_interval_ms;
+    // Set from httpd handlers, read by nmeaTask through getTxSchedule()
+    std::atomic<uint32_t> _transmission_interval_ms;
+    std::atomic<uint32_t> _min_transmission_interval_ms;
+    std::atomic<float> _level_deadband;
+    std::atomic<uint32_t> _rx_frames;
+    const unsigned long* _receive_pgns;
+    CanTxQueue _tx_queue;
+    // Written by nmeaTask only, read by the web server for /metrics
+    std::atomic<uint32_t> _tx_sent;
+    std::atomic<uint32_t> _tx_retries;
+    std::atomic<uint32_t> _tx_dropped;
+    std::atomic<size_t> _tx_queue_high_water;
+    PgnCounters<32> _rx_pgns;
+    PgnCounters<32> _tx_pgns;
 };
 
 #endif//last known n2k_can_driver.h
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef PGN_COUNTERS_H
+#define PGN_COUNTERS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free frame counters keyed by PGN, for the /metrics page. Slots are
+// claimed with a compare-and-swap on first use and never freed, so any
+// task may count while another reads. PGNs that don't fit in N slots are
+// counted as overflow. N must be a power of two.
+template<size_t N>
+class PgnCounters {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "PgnCounters size must be a power of two");
+
+public:
+    static const uint32_t EmptySlot = 0xFFFFFFFF;
+
+    PgnCounters() {
+        for (size_t i = 0; i < N; i++) {
+            _pgns[i].store(EmptySlot, std::memory_order_relaxed);
+            _counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void increment(uint32_t pgn) {
+        for (size_t i = 0; i < N; i++) {
+            size_t slot = (pgn + i) & (N - 1);
+            uint32_t key = _pgns[slot].load(std::memory_order_acquire);
+            if (key == EmptySlot) {
+                if (_pgns[slot].compare_exchange_strong(key, pgn, std::memory_order_acq_rel)) key = pgn;
+            }
+            if (key == pgn) {
+                _counts[slot].fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        _overflow.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Slot i, false if unused
+    bool get(size_t i, uint32_t& pgn, uint32_t& count) const {
+        pgn = _pgns[i].load(std::memory_order_acquire);
+        count = _counts[i].load(std::memory_order_relaxed);
+        return pgn != EmptySlot;
+    }
+
+    size_t capacity() const { return N; }
+    uint32_t overflow() const { return _overflow.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _pgns[N];
+    std::atomic<uint32_t> _counts[N];
+    std::atomic<uint32_t> _overflow{0};
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "rate_estimator.h"
+#include <cmath>
+
+RateEstimator::RateEstimator()
+    : head(0), count(0), baseMs(0), sumT(0), sumTT(0), sumY(0), sumTY(0), rate(NAN) {}
+
+void RateEstimator::accumulate(const Sample& sample, double sign) {
+    double t = (sample.ms - baseMs) / 1000.0;
+    sumT += sign * t;
+    sumTT += sign * t * t;
+    sumY += sign * sample.level;
+    sumTY += sign * t * sample.level;
+}
+
+void RateEstimator::rebase() {
+    sumT = sumTT = sumY = sumTY = 0;
+    if (count == 0) return;
+    size_t first = oldest();
+    baseMs = samples[first].ms;
+    for (size_t i = 0; i < count; i++) {
+        accumulate(samples[(first + i) % RATE_WINDOW_SAMPLES], 1.0);
+    }
+}
+
+void RateEstimator::addSample(float level_percent, uint32_t now_ms) {
+    if (!std::isfinite(level_percent)) return;
+    if (count > 0) {
+        const Sample& newest = samples[(head + RATE_WINDOW_SAMPLES - 1) % RATE_WINDOW_SAMPLES];
+        if (now_ms - newest.ms < RATE_WINDOW_MS / RATE_WINDOW_SAMPLES) return;
+    }
+
+    // Drop what fell out of the window, and the oldest point if the ring is full
+    while (count > 0) {
+        const Sample& first = samples[oldest()];
+        if (count < RATE_WINDOW_SAMPLES && now_ms - first.ms <= RATE_WINDOW_MS) break;
+        accumulate(first, -1.0);
+        count--;
+    }
+    if (count == 0) {
+        baseMs = now_ms;
+        sumT = sumTT = sumY = sumTY = 0;
+    }
+
+    Sample sample = {now_ms, level_percent};
+    samples[head] = sample;
+    head = (head + 1) % RATE_WINDOW_SAMPLES;
+    count++;
+    accumulate(sample, 1.0);
+    if (head == 0) rebase();
+
+    float result = NAN;
+    uint32_t span = now_ms - samples[oldest()].ms;
+    if (count >= 3 && span >= RATE_MIN_SPAN_MS) {
+        double n = count;
+        double denominator = n * sumTT - sumT * sumT;
+        if (denominator > 0) result = (float)((n * sumTY - sumT * sumY) / denominator * 3600.0);
+    }
+    rate.store(result, std::memory_order_relaxed);
+}
+
+float RateEstimator::hoursUntil(float level_percent, float target_percent) const {
+    float per_hour = getRatePercentPerHour();
+    if (!std::isfinite(per_hour) || std::fabs(per_hour) < RATE_STABLE_PERCENT_PER_HOUR) return NAN;
+    float hours = (target_percent - level_percent) / per_hour;
+    return hours >= 0 ? hours : NAN;
+}
@@ -0,0 +1,51 @@
+#ifndef RATE_ESTIMATOR_H
+#define RATE_ESTIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define RATE_WINDOW_SAMPLES 64
+#define RATE_WINDOW_MS 600000          // Least-squares window, 10 min
+#define RATE_MIN_SPAN_MS 60000         // No estimate until the window covers 1 min
+#define RATE_STABLE_PERCENT_PER_HOUR 0.5f  // Slower than this counts as not moving
+
+// Fill/drain rate of one tank: the slope of a least-squares line through the
+// level samples of the last RATE_WINDOW_MS. The sums the slope needs are kept
+// running, so a sample costs O(1) whatever the query rate: the new point is
+// added, points that left the window are subtracted. Once per pass through
+// the sample ring the sums are recomputed relative to the oldest sample,
+// which keeps the time values small and clears rounding drift.
+//
+// addSample() must be called from a single task. The result is published
+// through an atomic, so readers on other tasks never block it.
+class RateEstimator {
+public:
+    RateEstimator();
+    // Samples closer together than RATE_WINDOW_MS / RATE_WINDOW_SAMPLES are
+    // skipped, so it can be fed at any rate.
+    void addSample(float level_percent, uint32_t now_ms);
+    float getRatePercentPerHour() const { return rate.load(std::memory_order_relaxed); }  // NaN if unknown
+    // Hours until the level reaches target_percent at the current rate. NaN if
+    // the rate is unknown, below RATE_STABLE_PERCENT_PER_HOUR or moving away.
+    float hoursUntil(float level_percent, float target_percent) const;
+
+private:
+    struct Sample {
+        uint32_t ms;
+        float level;
+    };
+
+    size_t oldest() const { return (head + RATE_WINDOW_SAMPLES - count) % RATE_WINDOW_SAMPLES; }
+    void accumulate(const Sample& sample, double sign);
+    void rebase();
+
+    Sample samples[RATE_WINDOW_SAMPLES];
+    size_t head;     // Next slot to write
+    size_t count;
+    uint32_t baseMs; // Time origin of the sums
+    double sumT, sumTT, sumY, sumTY;  // t in seconds since baseMs
+    std::atomic<float> rate;
+};
+
+#endif
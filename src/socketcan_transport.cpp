@@ -0,0 +1,111 @@
+#include "socketcan_transport.h"
+#include "can_filter.h"
+#include <esp_log.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+static const char* TAG = "SocketCanTransport";
+static const int kTimeoutMs = 10;  // Same blocking budget as the TWAI backend
+
+SocketCanTransport::SocketCanTransport(const char* ifname) : _ifname(ifname), _socket(-1) {}
+
+// The kernel takes a list of id/mask pairs, so every PGN gets an exact
+// filter and the process only wakes for frames it handles.
+void SocketCanTransport::setReceiveFilter(const std::vector<unsigned long>& pgns) {
+    _receive_pgns = pgns;
+}
+
+SocketCanTransport::~SocketCanTransport() {
+    close();
+}
+
+bool SocketCanTransport::open() {
+    if (_socket >= 0) return true;
+
+    _socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (_socket < 0) {
+        ESP_LOGE(TAG, "Failed to create CAN socket: %s", strerror(errno));
+        return false;
+    }
+
+    struct ifreq ifr = {};
+    strncpy(ifr.ifr_name, _ifname.c_str(), IFNAMSIZ - 1);
+    if (ioctl(_socket, SIOCGIFINDEX, &ifr) < 0) {
+        ESP_LOGE(TAG, "CAN interface %s not found: %s", _ifname.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind CAN socket to %s: %s", _ifname.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    if (!_receive_pgns.empty()) {
+        std::vector<struct can_filter> filters(_receive_pgns.size());
+        for (size_t i = 0; i < _receive_pgns.size(); i++) {
+            uint32_t id, care;
+            n2kPgnAcceptance(_receive_pgns[i], id, care);
+            filters[i].can_id = id | CAN_EFF_FLAG;
+            filters[i].can_mask = care | CAN_EFF_FLAG | CAN_RTR_FLAG;
+        }
+        if (setsockopt(_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(struct can_filter)) < 0) {
+            ESP_LOGW(TAG, "Failed to set CAN filters, receiving all frames: %s", strerror(errno));
+        }
+    }
+
+    ESP_LOGI(TAG, "SocketCAN opened on %s", _ifname.c_str());
+    return true;
+}
+
+void SocketCanTransport::close() {
+    if (_socket >= 0) {
+        ::close(_socket);
+        _socket = -1;
+        ESP_LOGI(TAG, "SocketCAN closed on %s", _ifname.c_str());
+    }
+}
+
+bool SocketCanTransport::sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) {
+    if (_socket < 0 || len > CAN_MAX_DLEN) return false;
+    struct can_frame frame = {};
+    frame.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    frame.can_dlc = len;
+    memcpy(frame.data, buf, len);
+
+    if (wait_sent) {
+        struct pollfd pfd = { _socket, POLLOUT, 0 };
+        if (poll(&pfd, 1, kTimeoutMs) <= 0) return false;
+    }
+    return send(_socket, &frame, sizeof(frame), MSG_DONTWAIT) == (ssize_t)sizeof(frame);
+}
+
+bool SocketCanTransport::getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) {
+    if (_socket < 0) return false;
+    struct can_frame frame;
+    while (recv(_socket, &frame, sizeof(frame), MSG_DONTWAIT) == (ssize_t)sizeof(frame)) {
+        if (!(frame.can_id & CAN_EFF_FLAG) || (frame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG))) continue;
+        id = frame.can_id & CAN_EFF_MASK;
+        len = frame.can_dlc;
+        memcpy(buf, frame.data, len);
+        return true;
+    }
+    return false;
+}
+
+bool SocketCanTransport::waitForFrame(uint32_t timeout_ms) {
+    if (_socket < 0) return false;
+    struct pollfd pfd = { _socket, POLLIN, 0 };
+    return poll(&pfd, 1, timeout_ms) > 0;
+}
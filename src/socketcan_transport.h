@@ -0,0 +1,27 @@
+#ifndef SOCKETCAN_TRANSPORT_H
+#define SOCKETCAN_TRANSPORT_H
+
+#include "can_transport.h"
+#include <string>
+
+// Linux SocketCAN backend (e.g. vcan0) for running the NMEA2000 node in a
+// host process. Several instances can share one interface to simulate a bus.
+class SocketCanTransport : public CanTransport {
+public:
+    SocketCanTransport(const char* ifname = "vcan0");
+    virtual ~SocketCanTransport();
+
+    void setReceiveFilter(const std::vector<unsigned long>& pgns) override;
+    bool open() override;
+    void close() override;
+    bool sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) override;
+    bool getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) override;
+    bool waitForFrame(uint32_t timeout_ms) override;
+
+private:
+    std::string _ifname;
+    int _socket;
+    std::vector<unsigned long> _receive_pgns;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "tank.h"
+#include "ultrasonic.h"
+#include <esp_timer.h>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+float TankSettings_t::levelPercentage(float raw_distance) const {
+    float distance = raw_distance - sensor_offset;
+    if (distance < 0) distance = 0;
+    float height = tank_height - sensor_offset;
+    if (height <= 0) return 100.0;
+
+    if (geometry.empty()) return custom_transfer.evaluate(distance);
+    return 100.0 * geometry.fillFraction(1.0 - distance / height);
+}
+
+// The liquid surface stays level while the tank tilts with the hull, so at
+// the sensor's position it sits higher or lower than at the tank's centre,
+// where the level-to-volume model applies. With pitch positive bow up and
+// roll positive starboard down (the PGN 127257 conventions) the distance the
+// sensor would see at the centre is
+//   d_centre = d - forward * tan(pitch) / cos(roll) + starboard * tan(roll)
+// Beyond 45 degrees the reading is left alone; the surface then no longer
+// spans the tank and the model is meaningless anyway.
+float TankSettings_t::tiltCorrectedDistance(float raw_distance, float pitch, float roll) const {
+    const float limit = M_PI / 4;
+    if (std::fabs(pitch) > limit || std::fabs(roll) > limit) return raw_distance;
+    return raw_distance - sensor_forward * std::tan(pitch) / std::cos(roll) + sensor_starboard * std::tan(roll);
+}
+
+Tank::Tank() : current(0), distance(NAN) {
+    for (auto& count : readers) count.store(0, std::memory_order_relaxed);
+}
+
+// Both sides use sequentially consistent operations: either the writer sees
+// the reader's count, or the reader sees that its slot is no longer current
+// and retries.
+TankSettingsRef Tank::settings() const {
+    while (true) {
+        uint8_t index = current.load();
+        readers[index].fetch_add(1);
+        if (current.load() == index) return TankSettingsRef(&slots[index], &readers[index]);
+        readers[index].fetch_sub(1);
+    }
+}
+
+TankSettings_t& Tank::beginUpdate() {
+    writer.lock();
+    uint8_t index = current.load();
+    while (true) {
+        for (uint8_t i = 0; i < TANK_SETTINGS_SLOTS; i++) {
+            if (i == index || readers[i].load() != 0) continue;
+            pending = i;
+            slots[i] = slots[index];
+            return slots[i];
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));  // Every spare slot is pinned
+    }
+}
+
+void Tank::commitUpdate() {
+    current.store(pending);
+    writer.unlock();
+}
+
+void Tank::publishSettings(const TankSettings_t& next) {
+    beginUpdate() = next;
+    commitUpdate();
+}
+
+void Tank::setAttitude(float pitch, float roll) {
+    attitude.set(pitch, roll, (uint32_t)(esp_timer_get_time() / 1000));
+}
+
+void Tank::update() {
+    if (!sensor) return;
+    TankSettingsRef pinned = settings();
+    const TankSettings_t& snapshot = *pinned;
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+
+    float value = sensor->getDistance();
+    if (std::isnan(value)) return;
+    float pitch, roll;
+    if (attitude.get(pitch, roll, now)) value = snapshot.tiltCorrectedDistance(value, pitch, roll);
+
+    // Exponential average over average_seconds. In rough seas the surface
+    // sloshes faster than the attitude updates, so what is left after the
+    // correction still swings around the true level.
+    float previous = distance.load(std::memory_order_relaxed);
+    if (snapshot.average_seconds > 0 && !std::isnan(previous)) {
+        float alpha = 1.0f - std::exp(-(float)(now - last_update_ms) / (1000.0f * snapshot.average_seconds));
+        value = previous + alpha * (value - previous);
+    }
+    last_update_ms = now;
+    distance.store(value, std::memory_order_relaxed);
+}
+
+float Tank::getLevelPercentage(const TankSettings_t& snapshot) const {
+    if (!sensor || !sensor->hasReading()) return NAN;
+    float value = distance.load(std::memory_order_relaxed);
+    if (std::isnan(value)) value = sensor->getDistance();
+    if (std::isnan(value)) return NAN;
+    return snapshot.levelPercentage(value);
+}
+
+float Tank::getTankVolumeLiters() const {
+    TankSettingsRef snapshot = settings();
+    return snapshot->tank_volume * getLevelPercentage(*snapshot) / 100.0;
+}
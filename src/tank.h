@@ -0,0 +1,114 @@
+#ifndef TANK_H
+#define TANK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "N2kTypes.h"
+#include "alerts.h"
+#include "attitude.h"
+#include "calibration.h"
+#include "geometry.h"
+#include "rate_estimator.h"
+
+class Ultrasonic;
+
+#define MAX_TANKS 3
+
+// Everything the web UI configures for one tank. Published as a whole, so a
+// reader never sees half of an update.
+struct TankSettings_t {
+    uint8_t instance = 0;
+    tN2kFluidType fluid_type = N2kft_Water;
+
+    float tank_height = 100.0;          // cm
+    float tank_volume = 100.0;          // liters
+    float sensor_offset = 0.0;          // cm
+    float low_alarm_percent = 10.0;     // %
+    float high_alarm_percent = 90.0;    // %
+    char tank_shape[32] = "rectangular";
+    float shape_ratio = 0.0;            // Free proportion of the shape, see TankShapeModel
+    float sensor_forward = 0.0;         // cm, sensor position ahead of the tank's centre
+    float sensor_starboard = 0.0;       // cm, sensor position to starboard of the tank's centre
+    uint32_t average_seconds = 0;       // Output averaging time constant, 0 = off
+    TankGeometry geometry;              // Compiled from tank_shape and shape_ratio by buildGeometry()
+    LevelTransferFunction custom_transfer;  // Compiled from the NVS calibration table for the "custom" shape
+
+    void buildGeometry() { shape_ratio = geometry.build(tank_shape, shape_ratio); }
+    float levelPercentage(float raw_distance) const;
+    float tiltCorrectedDistance(float raw_distance, float pitch, float roll) const;
+    float getLowAlarmVolume() const { return tank_volume * low_alarm_percent / 100.0; }
+    float getHighAlarmVolume() const { return tank_volume * high_alarm_percent / 100.0; }
+};
+
+// Pins one settings snapshot for as long as it lives; the slot it points to
+// is not reused until it is destroyed. Hold one per computation, not forever:
+// a writer needs a slot nobody pins.
+class TankSettingsRef {
+public:
+    TankSettingsRef(const TankSettings_t* settings, std::atomic<uint32_t>* readers) : _settings(settings), _readers(readers) {}
+    ~TankSettingsRef() { _readers->fetch_sub(1, std::memory_order_release); }
+    TankSettingsRef(const TankSettingsRef&) = delete;
+    TankSettingsRef& operator=(const TankSettingsRef&) = delete;
+
+    const TankSettings_t& operator*() const { return *_settings; }
+    const TankSettings_t* operator->() const { return _settings; }
+
+private:
+    const TankSettings_t* _settings;
+    std::atomic<uint32_t>* _readers;
+};
+
+// One sensor channel: the transducer, the tank it sits in and the
+// instance/fluid type it reports as on the bus.
+//
+// Settings are read on nmea_task and ultrasonic_task and written from
+// httpd handlers and at startup. The current snapshot is an atomic slot
+// index; a reader bumps the slot's reader count, then checks the index
+// still names that slot, so it never blocks and never sees a slot being
+// rewritten. A writer only fills a slot that is not current and has no
+// readers, waiting 1 ms at a time in the rare case that none is free, and
+// publishes it by storing the index. Writers are serialized by a mutex.
+#define TANK_SETTINGS_SLOTS 3
+
+struct Tank {
+    Tank();
+
+    Ultrasonic* sensor = nullptr;
+
+    TankSettingsRef settings() const;
+    void publishSettings(const TankSettings_t& next);
+    // In-place update without a copy on the caller's stack: beginUpdate()
+    // returns a free slot holding the current settings, commitUpdate()
+    // publishes it. Nothing else may publish in between.
+    TankSettings_t& beginUpdate();
+    void commitUpdate();
+
+    LevelAlert low_alert{false};
+    LevelAlert high_alert{true};
+
+    RateEstimator rate;  // Fed by nmea_task from the levels it sends
+
+    void setAttitude(float pitch, float roll);  // rad, from PGN 127257, safe from any task
+    // Per-measurement step on ultrasonic_task: applies the tilt correction and
+    // the averaging to the sensor distance. Allocation-free.
+    void update();
+
+    // NaN while the sensor has no reading, see Ultrasonic::hasReading()
+    float getLevelPercentage() const { return getLevelPercentage(*settings()); }
+    float getLevelPercentage(const TankSettings_t& snapshot) const;
+    float getTankVolumeLiters() const;
+
+private:
+    TankSettings_t slots[TANK_SETTINGS_SLOTS];
+    mutable std::atomic<uint32_t> readers[TANK_SETTINGS_SLOTS];
+    std::atomic<uint8_t> current;
+    std::mutex writer;
+    uint8_t pending = 0;  // Slot between beginUpdate() and commitUpdate()
+
+    AttitudeSlot attitude;
+    std::atomic<float> distance;  // Result of update(), NaN until the first one
+    uint32_t last_update_ms = 0;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "tank_reporter.h"
+#include <algorithm>
+#include <cmath>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "N2kMessages.h"
+#include "ultrasonic.h"
+
+static const char* TAG = "TankReporter";
+
+TankReporter::TankReporter(N2kCanDriver* nmea2000, WebServer* web_server, TxScheduler* schedulers)
+    : _nmea2000(nmea2000), _web_server(web_server), _schedulers(schedulers), _next_tank(0) {}
+
+void TankReporter::handleMessage(const tN2kMsg& msg) {
+    if (msg.PGN == 126984) {
+        handleAlertResponse(msg);
+    } else if (msg.PGN == 126992) {
+        handleSystemTime(msg);
+    } else if (msg.PGN == 127257) {
+        handleAttitude(msg);
+    } else if (msg.PGN == 127505) {
+        handleFluidLevel(msg);
+    } else if (msg.PGN == 130312) {
+        handleTemperature(msg, false);
+    } else if (msg.PGN == 130316) {
+        handleTemperature(msg, true);
+    }
+}
+
+void TankReporter::handleFluidLevel(const tN2kMsg& msg) {
+    uint8_t instance;
+    tN2kFluidType fluidType;
+    double level;
+    double capacity;
+
+    if (ParseN2kFluidLevel(msg, instance, fluidType, level, capacity)) {
+        ESP_LOGI("NMEA2000", "PGN 127505: Instance=%d, FluidType=%d, Level=%.2f%%, Capacity=%.2f liters",
+                 instance, fluidType, level * 100, capacity);
+    } else {
+        ESP_LOGW("NMEA2000", "Failed to parse PGN 127505");
+    }
+}
+
+// Air temperature in the tank changes the speed of sound by ~0.17 %/°C
+void TankReporter::handleTemperature(const tN2kMsg& msg, bool extended) {
+    unsigned char sid, instance;
+    tN2kTempSource source;
+    double actual, set;
+    bool parsed = extended ? ParseN2kTemperatureExt(msg, sid, instance, source, actual, set)
+                           : ParseN2kTemperature(msg, sid, instance, source, actual, set);
+    if (!parsed || N2kIsNA(actual)) return;
+    if ((uint32_t)source != _web_server->getTemperatureSource()) return;
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        Ultrasonic* sensor = _web_server->getTank(i).sensor;
+        if (sensor) sensor->setAirTemperature(KelvinToC(actual));
+    }
+}
+
+// Heel and trim move the liquid surface under the sensor; each tank corrects
+// for its own mounting position
+void TankReporter::handleAttitude(const tN2kMsg& msg) {
+    unsigned char sid;
+    double yaw, pitch, roll;
+    if (!ParseN2kAttitude(msg, sid, yaw, pitch, roll)) return;
+    if (N2kIsNA(pitch) || N2kIsNA(roll)) return;
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        _web_server->getTank(i).setAttitude(pitch, roll);
+    }
+}
+
+// The system clock starts at zero on every boot. A GPS or chart plotter on
+// the bus sets it to real time, and history records are dated from then on.
+void TankReporter::handleSystemTime(const tN2kMsg& msg) {
+    unsigned char sid;
+    uint16_t days;
+    double seconds;
+    tN2kTimeSource source;
+    if (!ParseN2kSystemTime(msg, sid, days, seconds, source)) return;
+    if (N2kIsNA(days) || N2kIsNA(seconds)) return;
+    time_t now = (time_t)days * 86400 + (time_t)seconds;
+    if (llabs((long long)(now - time(NULL))) < 2) return;
+    setClock(now);
+    ESP_LOGI(TAG, "System time set from PGN 126992: %lld", (long long)now);
+}
+
+void TankReporter::setClock(time_t now) {
+    struct timeval tv = {now, 0};
+    settimeofday(&tv, NULL);
+}
+
+// Two alerts per tank, so the ID alone tells receivers which one it is
+static unsigned int alertId(size_t tank, bool high) {
+    return tank * 2 + (high ? 2 : 1);
+}
+
+void TankReporter::sendAlert(size_t tank_index, LevelAlert& alert, uint32_t now) {
+    Tank& tank = _web_server->getTank(tank_index);
+    unsigned char instance = tank.settings()->instance;
+    uint64_t name = _nmea2000->GetDeviceInformation().GetName();
+    unsigned int id = alertId(tank_index, alert.isHigh());
+
+    tN2kMsg N2kMsg;
+    alert.setStatus(N2kMsg, id, name, instance, now);
+    if (!_nmea2000->SendMsg(N2kMsg)) ESP_LOGW(TAG, "Failed to send alert %u status", id);
+    if (alert.textDue()) {
+        char description[32];
+        snprintf(description, sizeof(description), "Tank %d %s level", (int)tank_index + 1, alert.isHigh() ? "high" : "low");
+        alert.setText(N2kMsg, id, name, instance, description);
+        if (!_nmea2000->SendMsg(N2kMsg)) ESP_LOGW(TAG, "Failed to send alert %u text", id);
+    }
+    alert.sent(now);
+}
+
+// Acknowledge or temporary silence from a display or alert manager
+void TankReporter::handleAlertResponse(const tN2kMsg& msg) {
+    tN2kAlertType type;
+    tN2kAlertCategory category;
+    unsigned char system, subsystem, instance, index, occurrence;
+    unsigned int id;
+    uint64_t source, acknowledger;
+    tN2kAlertResponseCommand command;
+    if (!ParseN2kAlertResponse(msg, type, category, system, subsystem, id, source, instance, index, occurrence,
+                               acknowledger, command)) {
+        return;
+    }
+    if (source != _nmea2000->GetDeviceInformation().GetName()) return;  // Someone else's alert
+
+    uint32_t now = esp_timer_get_time() / 1000;
+    for (size_t i = 0; i < _web_server->getNumTanks(); i++) {
+        Tank& tank = _web_server->getTank(i);
+        for (LevelAlert* alert : {&tank.low_alert, &tank.high_alert}) {
+            if (id != alertId(i, alert->isHigh())) continue;
+            if (alert->respond(command, acknowledger, now)) {
+                ESP_LOGI(TAG, "Alert %u response %d from %016llx", id, (int)command, (unsigned long long)acknowledger);
+                sendAlert(i, *alert, now);
+            }
+        }
+    }
+}
+
+void TankReporter::resetSchedules(uint32_t now_ms) {
+    uint32_t interval = _nmea2000->getTransmissionInterval();
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        _schedulers[i].reset(now_ms + i * interval / MAX_TANKS);
+    }
+}
+
+// Runs on every nmea_task wake-up, and ultrasonic_task wakes it after every
+// measurement, so a threshold crossing goes out within milliseconds instead
+// of with the next fluid level frame. Returns how long until an active alert
+// must repeat its status.
+uint32_t TankReporter::sendAlerts() {
+    uint32_t now = esp_timer_get_time() / 1000;
+    uint32_t wait_ms = MaxSleepMs;
+    for (size_t i = 0; i < _web_server->getNumTanks(); i++) {
+        Tank& tank = _web_server->getTank(i);
+        TankSettingsRef snapshot = tank.settings();
+        const TankSettings_t& settings = *snapshot;
+        // Until the first echo, and once the sensor goes quiet, the level is
+        // unknown: neither raise an alert on it nor keep repeating an old one
+        Ultrasonic* sensor = tank.sensor;
+        if (!sensor || sensor->getMeasurementCount() == 0 || !std::isfinite(sensor->getDistance())) continue;
+        float level_percent = tank.getLevelPercentage(settings);
+        if (std::isnan(level_percent)) continue;
+        tank.low_alert.evaluate(level_percent, settings.low_alarm_percent, now);
+        tank.high_alert.evaluate(level_percent, settings.high_alarm_percent, now);
+        for (LevelAlert* alert : {&tank.low_alert, &tank.high_alert}) {
+            if (alert->msUntilDue(now) == 0) sendAlert(i, *alert, now);
+            wait_ms = std::min(wait_ms, alert->msUntilDue(now));
+        }
+    }
+    return wait_ms;
+}
+
+// Each tank's scheduler decides whether its level moved enough to be sent;
+// at most one frame goes out per call so several tanks changing together
+// don't burst onto the bus.
+uint32_t TankReporter::sendFluidLevel() {
+    uint32_t now = esp_timer_get_time() / 1000;
+    TxScheduleSettings_t schedule = _nmea2000->getTxSchedule();
+    size_t num_tanks = _web_server->getNumTanks();
+    size_t first = _next_tank % num_tanks;
+    bool sent = false;
+    uint32_t wait_ms = MaxSleepMs;
+
+    for (size_t n = 0; n < num_tanks; n++) {
+        size_t i = (first + n) % num_tanks;
+        // One snapshot per tank, so the level, volume and channel all come
+        // from the same settings even if the web UI saves meanwhile
+        TankSettingsRef snapshot = _web_server->getTank(i).settings();
+        const TankSettings_t& tank = *snapshot;
+        float level_percent = _web_server->getTank(i).getLevelPercentage(tank);
+        _web_server->getTank(i).rate.addSample(level_percent, now);
+        if (!sent && _schedulers[i].due(level_percent, now, schedule)) {
+            tN2kMsg N2kMsg;
+            if (std::isnan(level_percent)) {  // No echo yet or the sensor went quiet
+                SetN2kFluidLevel(N2kMsg, tank.instance, tank.fluid_type, N2kDoubleNA, N2kDoubleNA);
+            } else {
+                SetN2kFluidLevel(N2kMsg, tank.instance, tank.fluid_type, level_percent / 100.0, tank.tank_volume * level_percent / 100.0);
+            }
+            if (!_nmea2000->SendMsg(N2kMsg)) {
+                ESP_LOGW(TAG, "Failed to send NMEA2000 message, PGN: %lu, instance: %d", N2kMsg.PGN, tank.instance);
+            } else {
+                ESP_LOGD(TAG, "Sent NMEA2000 message, PGN: %lu, instance: %d", N2kMsg.PGN, tank.instance);
+            }
+            _schedulers[i].sent(level_percent, now);
+            _next_tank = i + 1;
+            sent = true;
+        }
+        uint32_t due_ms = std::max(_schedulers[i].msUntilDue(level_percent, now, schedule), FrameGapMs);
+        wait_ms = std::min(wait_ms, due_ms);
+    }
+    return wait_ms;
+}
+
+bool CanRxHandoff::handOff(TaskHandle_t nmea_task, uint32_t wait_ms) {
+    ulTaskNotifyTake(pdTRUE, 0);  // Drop an answer that came after a timed out wait
+    _handed_off.store(true, std::memory_order_release);
+    xTaskNotifyGive(nmea_task);
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms)) > 0;
+}
+
+void CanRxHandoff::answer(TaskHandle_t rx_task) {
+    if (rx_task && _handed_off.exchange(false, std::memory_order_acq_rel)) xTaskNotifyGive(rx_task);
+}
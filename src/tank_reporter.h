@@ -0,0 +1,64 @@
+#ifndef TANK_REPORTER_H
+#define TANK_REPORTER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "N2kMsg.h"
+#include "n2k_can_driver.h"
+#include "tx_scheduler.h"
+#include "web_server.h"
+
+// What nmea_task does for the tanks: sends their fluid levels and alerts, and
+// applies what other devices put on the bus (air temperature, attitude,
+// system time, alert responses). Only used from nmea_task.
+class TankReporter {
+public:
+    // schedulers holds one TxScheduler per tank, MAX_TANKS of them
+    TankReporter(N2kCanDriver* nmea2000, WebServer* web_server, TxScheduler* schedulers);
+    virtual ~TankReporter() {}
+
+    void handleMessage(const tN2kMsg& msg);  // tNMEA2000 message handler
+    void resetSchedules(uint32_t now_ms);  // Staggers the first heartbeats over the interval
+    // Both return how long nmea_task may sleep before something is due
+    uint32_t sendAlerts();
+    uint32_t sendFluidLevel();
+
+    static constexpr uint32_t MaxSleepMs = 100;  // Longest nmea_task sleep, tNMEA2000 has its own timers
+    static constexpr uint32_t FrameGapMs = 10;   // Spacing between fluid level frames of different tanks
+
+protected:
+    void handleFluidLevel(const tN2kMsg& msg);
+    void handleTemperature(const tN2kMsg& msg, bool extended);
+    void handleAttitude(const tN2kMsg& msg);
+    void handleSystemTime(const tN2kMsg& msg);
+    void handleAlertResponse(const tN2kMsg& msg);
+    virtual void setClock(time_t now);  // settimeofday()
+
+private:
+    void sendAlert(size_t tank_index, LevelAlert& alert, uint32_t now);
+
+    N2kCanDriver* _nmea2000;
+    WebServer* _web_server;
+    TxScheduler* _schedulers;
+    size_t _next_tank;
+};
+
+// can_rx_task sleeps in the transport until frames arrive, wakes nmea_task to
+// drain them and then waits for it to finish, so nmea_task never has to poll
+// the bus. nmea_task only answers while can_rx_task is waiting, so answers
+// don't pile up as pending notifications.
+class CanRxHandoff {
+public:
+    CanRxHandoff() : _handed_off(false) {}
+    // On can_rx_task; false if nmea_task did not answer within wait_ms
+    bool handOff(TaskHandle_t nmea_task, uint32_t wait_ms);
+    void answer(TaskHandle_t rx_task);  // On nmea_task, after ParseMessages()
+
+private:
+    std::atomic<bool> _handed_off;
+};
+
+#endif
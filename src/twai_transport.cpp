@@ -0,0 +1,196 @@
+#include "twai_transport.h"
+#include "can_filter.h"
+#include <esp_log.h>
+#include <string.h>
+
+static const char* TAG = "TwaiTransport";
+
+TwaiTransport::TwaiTransport(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t rs_pin)
+    : _tx_pin(tx_pin), _rx_pin(rx_pin), _rs_pin(rs_pin), _is_open(false), _bus_off_count(0), _rx_queue_high_water(0),
+      _filter(TWAI_FILTER_CONFIG_ACCEPT_ALL()) {}
+
+// Code and don't-care mask over the full 29-bit identifier that accept
+// every PGN in the list: bits that differ between them become don't-care
+static void groupAcceptance(const std::vector<unsigned long>& pgns, uint32_t& code, uint32_t& ignore) {
+    code = 0;
+    ignore = 0;
+    for (size_t i = 0; i < pgns.size(); i++) {
+        uint32_t id, care;
+        n2kPgnAcceptance(pgns[i], id, care);
+        if (i == 0) code = id;
+        ignore |= (~care & 0x1FFFFFFF) | (id ^ code);
+    }
+}
+
+// The acceptance filter offers either one code/mask over the full 29-bit
+// identifier or, in dual mode, two code/masks over its upper 16 bits
+// (ID28..ID13: priority, data page, PDU format and the top three bits of
+// PDU specific). Dual mode gets one group for the PDU2 PGNs and one for
+// the PDU1 ones. With the usual lists that is DP=1 PF 0xF0-0xFD with PDU
+// specific below 0x20 for the application PGNs, and PF 0xE8-0xEF on either
+// page for the ISO and group function PGNs. A single group uses the single
+// filter over all 29 bits instead.
+//
+// That is as far as the hardware goes. Most high rate backbone traffic
+// (127250, 127251, 127488, 129025, 129026, 130306, ...) sits on the same
+// PDU formats with PDU specific below 0x20 as the application PGNs, so it
+// cannot be told apart in ID28..ID13 and still reaches tNMEA2000. So do
+// 126464, 126993, 126996 and 126998, the proprietary PGNs 61184 and 126720,
+// and the other PDU1 PGNs in PF 0xE8-0xEF, which it drops in software.
+// What the hardware does reject is data page 0 PDU2 traffic (J1939 engine
+// PGNs, proprietary 65280-65535) and PDU specific 0x20 and up.
+void TwaiTransport::setReceiveFilter(const std::vector<unsigned long>& pgns) {
+    size_t n = pgns.size();
+    if (n == 0) {
+        _filter = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+        return;
+    }
+
+    std::vector<unsigned long> groups[2];  // PDU2, PDU1
+    for (unsigned long pgn : pgns) {
+        groups[((pgn >> 8) & 0xFF) < 240 ? 1 : 0].push_back(pgn);
+    }
+
+    uint32_t code[2], ignore[2];
+    if (groups[0].empty() || groups[1].empty()) {
+        groupAcceptance(groups[0].empty() ? groups[1] : groups[0], code[0], ignore[0]);
+        _filter = {code[0] << 3, (ignore[0] << 3) | 0x7, true};
+    } else {
+        for (int g = 0; g < 2; g++) {
+            groupAcceptance(groups[g], code[g], ignore[g]);
+            code[g] = (code[g] >> 13) & 0xFFFF;
+            ignore[g] = (ignore[g] >> 13) & 0xFFFF;
+        }
+        _filter = {(code[0] << 16) | code[1], (ignore[0] << 16) | ignore[1], false};
+    }
+    ESP_LOGI(TAG, "Acceptance filter for %d PGNs: %s, code 0x%08lx, mask 0x%08lx", (int)n, _filter.single_filter ? "single" : "dual",
+             (unsigned long)_filter.acceptance_code, (unsigned long)_filter.acceptance_mask);
+}
+
+TwaiTransport::~TwaiTransport() {
+    close();
+    gpio_set_level(_rs_pin, 1);
+}
+
+bool TwaiTransport::open() {
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = (1ULL << _rs_pin);
+    io_conf.mode = GPIO_MODE_OUTPUT;
+    io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+    gpio_config(&io_conf);
+    gpio_set_level(_rs_pin, 0);
+    ESP_LOGI(TAG, "RS pin %d set low for high-speed mode", _rs_pin);
+
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(_tx_pin, _rx_pin, TWAI_MODE_NORMAL);
+    g_config.tx_queue_len = 5;
+    g_config.rx_queue_len = 16;  // Drained in batches, see waitForFrame()
+    g_config.alerts_enabled = TWAI_ALERT_RX_DATA | TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_ERR_PASS |
+                              TWAI_ALERT_ERR_ACTIVE | TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED;
+    g_config.clkout_divider = 0;
+    g_config.intr_flags = ESP_INTR_FLAG_LEVEL1;
+    g_config.controller_id = 0;
+
+    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_250KBITS();
+    if (twai_driver_install(&g_config, &t_config, &_filter) == ESP_OK) {
+        ESP_LOGI(TAG, "TWAI driver installed");
+        if (twai_start() == ESP_OK) {
+            ESP_LOGI(TAG, "TWAI driver started");
+            _is_open = true;
+        } else {
+            ESP_LOGE(TAG, "Failed to start TWAI driver");
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to install TWAI driver");
+    }
+    return _is_open;
+}
+
+void TwaiTransport::close() {
+    if (_is_open) {
+        twai_stop();
+        twai_driver_uninstall();
+        _is_open = false;
+        ESP_LOGI(TAG, "TWAI driver stopped and uninstalled");
+    }
+}
+
+bool TwaiTransport::sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) {
+    if (!_is_open) return false;
+    twai_message_t message = {};
+    message.identifier = id;
+    message.data_length_code = len;
+    message.extd = 1;
+    memcpy(message.data, buf, len);
+    esp_err_t result = twai_transmit(&message, wait_sent ? pdMS_TO_TICKS(10) : 0);  // Fails while bus-off
+    return (result == ESP_OK);
+}
+
+bool TwaiTransport::getBusStatus(CanBusStatus_t& status) const {
+    twai_status_info_t info;
+    if (!_is_open || twai_get_status_info(&info) != ESP_OK) return false;
+    switch (info.state) {
+        case TWAI_STATE_RUNNING: status.state = "running"; break;
+        case TWAI_STATE_BUS_OFF: status.state = "bus_off"; break;
+        case TWAI_STATE_RECOVERING: status.state = "recovering"; break;
+        default: status.state = "stopped"; break;
+    }
+    status.txErrors = info.tx_error_counter;
+    status.rxErrors = info.rx_error_counter;
+    status.rxMissed = info.rx_missed_count;
+    status.rxOverrun = info.rx_overrun_count;
+    status.busErrors = info.bus_error_count;
+    status.arbLost = info.arb_lost_count;
+    status.rxQueueHighWater = _rx_queue_high_water.load(std::memory_order_relaxed);
+    return true;
+}
+
+bool TwaiTransport::getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) {
+    if (!_is_open) return false;
+    twai_message_t message;
+    while (twai_receive(&message, 0) == ESP_OK) {
+        if (!message.extd) continue;  // NMEA2000 only uses 29-bit identifiers
+        id = message.identifier;
+        len = message.data_length_code;
+        memcpy(buf, message.data, len);
+        return true;
+    }
+    return false;
+}
+
+// The RX_DATA alert is raised by the driver's ISR for every received frame,
+// so this sleeps without polling and wakes as soon as the first frame lands.
+// Bus state alerts arrive on the same call, so bus-off recovery is handled
+// here too: recovery is started on bus-off and the controller restarted
+// once 128 recessive sequences have been seen.
+bool TwaiTransport::waitForFrame(uint32_t timeout_ms) {
+    if (!_is_open) return false;
+    uint32_t alerts = 0;
+    if (twai_read_alerts(&alerts, pdMS_TO_TICKS(timeout_ms)) != ESP_OK) return false;
+    if (alerts & TWAI_ALERT_RX_DATA) {
+        twai_status_info_t info;
+        if (twai_get_status_info(&info) == ESP_OK && info.msgs_to_rx > _rx_queue_high_water.load(std::memory_order_relaxed)) {
+            _rx_queue_high_water.store(info.msgs_to_rx, std::memory_order_relaxed);
+        }
+    }
+    if (alerts & TWAI_ALERT_RX_QUEUE_FULL) {
+        ESP_LOGW(TAG, "TWAI RX queue full, frames dropped");
+    }
+    if (alerts & TWAI_ALERT_ERR_PASS) {
+        ESP_LOGW(TAG, "TWAI controller is error passive");
+    }
+    if (alerts & TWAI_ALERT_ERR_ACTIVE) {
+        ESP_LOGI(TAG, "TWAI controller is error active again");
+    }
+    if (alerts & TWAI_ALERT_BUS_OFF) {
+        _bus_off_count.fetch_add(1, std::memory_order_relaxed);
+        ESP_LOGW(TAG, "TWAI bus-off, initiating recovery");
+        twai_initiate_recovery();
+    }
+    if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+        ESP_LOGI(TAG, "TWAI bus recovered, restarting");
+        twai_start();
+    }
+    return (alerts & TWAI_ALERT_RX_DATA) != 0;
+}
@@ -0,0 +1,35 @@
+#ifndef TWAI_TRANSPORT_H
+#define TWAI_TRANSPORT_H
+
+#include "can_transport.h"
+#include <driver/twai.h>
+#include <driver/gpio.h>
+#include <atomic>
+
+class TwaiTransport : public CanTransport {
+public:
+    TwaiTransport(gpio_num_t tx_pin = GPIO_NUM_27,
+                  gpio_num_t rx_pin = GPIO_NUM_26,
+                  gpio_num_t rs_pin = GPIO_NUM_23);
+    virtual ~TwaiTransport();
+
+    void setReceiveFilter(const std::vector<unsigned long>& pgns) override;
+    bool open() override;
+    void close() override;
+    bool sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) override;
+    bool getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) override;
+    bool waitForFrame(uint32_t timeout_ms) override;
+    uint32_t getBusOffCount() const override { return _bus_off_count.load(std::memory_order_relaxed); }
+    bool getBusStatus(CanBusStatus_t& status) const override;
+
+private:
+    gpio_num_t _tx_pin;
+    gpio_num_t _rx_pin;
+    gpio_num_t _rs_pin;
+    bool _is_open;
+    std::atomic<uint32_t> _bus_off_count;
+    std::atomic<uint32_t> _rx_queue_high_water;
+    twai_filter_config_t _filter;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "tx_scheduler.h"
+#include <math.h>
+
+TxScheduler::TxScheduler() : lastLevel(0.0), lastSentMs(0), firstDueMs(0), hasSent(false) {}
+
+void TxScheduler::reset(uint32_t first_due_ms) {
+    hasSent = false;
+    firstDueMs = first_due_ms;
+}
+
+// Going from no reading to a level, or back, is a change of its own
+bool TxScheduler::moved(float level_percent, const TxScheduleSettings_t& settings) const {
+    if (isnan(level_percent) || isnan(lastLevel)) return isnan(level_percent) != isnan(lastLevel);
+    return fabsf(level_percent - lastLevel) >= settings.deadband;
+}
+
+bool TxScheduler::due(float level_percent, uint32_t now_ms, const TxScheduleSettings_t& settings) const {
+    if (!hasSent) return (int32_t)(now_ms - firstDueMs) >= 0;
+
+    uint32_t elapsed = now_ms - lastSentMs;
+    if (elapsed >= settings.maxIntervalMs) return true;  // Heartbeat
+    return elapsed >= settings.minIntervalMs && moved(level_percent, settings);
+}
+
+// How long the sender may sleep if the level doesn't change meanwhile. A
+// pending change held back by the minimum interval wakes it at that limit.
+uint32_t TxScheduler::msUntilDue(float level_percent, uint32_t now_ms, const TxScheduleSettings_t& settings) const {
+    if (due(level_percent, now_ms, settings)) return 0;
+    if (!hasSent) return firstDueMs - now_ms;
+
+    uint32_t elapsed = now_ms - lastSentMs;
+    if (moved(level_percent, settings)) return settings.minIntervalMs - elapsed;
+    return settings.maxIntervalMs - elapsed;
+}
+
+void TxScheduler::sent(float level_percent, uint32_t now_ms) {
+    lastLevel = level_percent;
+    lastSentMs = now_ms;
+    hasSent = true;
+}
@@ -0,0 +1,34 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <stdint.h>
+
+struct TxScheduleSettings_t {
+    float deadband;          // %, level change that counts as a real change
+    uint32_t minIntervalMs;  // fastest rate while the level is moving
+    uint32_t maxIntervalMs;  // heartbeat while the level is stable
+};
+
+// Decides when a tank's fluid level is worth a new PGN 127505 frame. A frame
+// goes out as soon as the level has moved more than the deadband since the
+// last one (but never faster than the minimum interval), and otherwise once
+// per heartbeat so receivers don't time the source out. A NaN level means no
+// reading; the heartbeat keeps going out for it.
+class TxScheduler {
+public:
+    TxScheduler();
+    void reset(uint32_t first_due_ms);
+    bool due(float level_percent, uint32_t now_ms, const TxScheduleSettings_t& settings) const;
+    uint32_t msUntilDue(float level_percent, uint32_t now_ms, const TxScheduleSettings_t& settings) const;
+    void sent(float level_percent, uint32_t now_ms);
+
+private:
+    bool moved(float level_percent, const TxScheduleSettings_t& settings) const;
+
+    float lastLevel;
+    uint32_t lastSentMs;
+    uint32_t firstDueMs;
+    bool hasSent;
+};
+
+#endif
@@ -1,46 +1,72 @@
 #include "ultrasonic.h"
 #include <esp_log.h>
-#include <algorithm>
-#include "calibration.h"
+#include <esp_timer.h>
+#include <cmath>
 
 //static const char* TAG = "Ultrasonic";
 
-Ultrasonic::Ultrasonic() : simulatedDistance(100.0) {
-    calibrationPoints.push_back({20.0, 100.0});
-    calibrationPoints.push_back({120.0, 0.0});  // Updated to 120 cm
+Ultrasonic::Ultrasonic() : currentDistance(NAN), currentDistanceMs(0), airTemperature(DEFAULT_AIR_TEMPERATURE),
+      airTemperatureUpdatedMs(0), measurementCount(0), missedEchoCount(0) {}
+
+// Readings past the tank bottom are left to Tank, which knows the height
+void Ultrasonic::setDistance(float distance) {
+    if (distance < 0) distance = 0;
+    currentDistanceMs.store((uint32_t)(esp_timer_get_time() / 1000), std::memory_order_relaxed);
+    currentDistance.store((distance > maxEchoDistance) ? maxEchoDistance : distance, std::memory_order_release);
 }
 
-float Ultrasonic::getLevelPercentage() {
-    return interpolateLevel(simulatedDistance);
+// There is no reading before the first echo, and none once the sensor has
+// gone quiet: a dead transducer must not keep reporting its last level.
+bool Ultrasonic::hasReading() const {
+    if (std::isnan(currentDistance.load(std::memory_order_acquire))) return false;
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    return now - currentDistanceMs.load(std::memory_order_relaxed) <= readingTimeoutMs;
 }
 
-void Ultrasonic::setSimulatedDistance(float distance) {
-    simulatedDistance = (distance > maxDistance) ? maxDistance : distance;  // Cap at 120 cm
+float Ultrasonic::getDistance() const {
+    return hasReading() ? currentDistance.load(std::memory_order_relaxed) : NAN;
 }
 
-void Ultrasonic::loadCalibrationFromNVS(const std::vector<CalibrationPoint>& calibration) {
-    if (calibration.empty()) return;
-    calibrationPoints = calibration;
-    for (auto& point : calibrationPoints) {
-        if (point.distance > maxDistance) point.distance = maxDistance;  // Cap at 120 cm
-    }
-    std::sort(calibrationPoints.begin(), calibrationPoints.end(), 
-              [](const CalibrationPoint& a, const CalibrationPoint& b) { return a.distance < b.distance; });
-}
-
-float Ultrasonic::interpolateLevel(float distance) {
-    if (calibrationPoints.empty()) return 0.0;
-    if (distance <= calibrationPoints.front().distance) return calibrationPoints.front().percentage;
-    if (distance >= calibrationPoints.back().distance) return calibrationPoints.back().percentage;
-
-    for (size_t i = 0; i < calibrationPoints.size() - 1; i++) {
-        if (distance >= calibrationPoints[i].distance && distance <= calibrationPoints[i + 1].distance) {
-            float d1 = calibrationPoints[i].distance;
-            float p1 = calibrationPoints[i].percentage;
-            float d2 = calibrationPoints[i + 1].distance;
-            float p2 = calibrationPoints[i + 1].percentage;
-            return p1 + (distance - d1) * (p2 - p1) / (d2 - d1);  // Linear interpolation
+bool Ultrasonic::consumeEchoes(EchoRingBuffer& samples, uint32_t resolution_hz) {
+    bool updated = false;
+    float speed = speedOfSound(getAirTemperature());
+    uint32_t pulse_ticks;
+    while (samples.pop(pulse_ticks)) {
+        float distance = pulseToDistance(pulse_ticks, resolution_hz, speed);
+        if (distance > maxEchoDistance) {  // No echo
+            missedEchoCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
         }
+        setDistance(filter.update(distance));
+        measurementCount.fetch_add(1, std::memory_order_relaxed);
+        updated = true;
     }
-    return 0.0;
-}
\ No newline at end of file
+    return updated;
+}
+
+void Ultrasonic::setAirTemperature(float celsius) {
+    if (celsius < -40.0 || celsius > 85.0) return;  // Implausible for a tank space
+    airTemperature.store(celsius, std::memory_order_relaxed);
+    airTemperatureUpdatedMs.store((uint32_t)(esp_timer_get_time() / 1000), std::memory_order_release);
+}
+
+float Ultrasonic::getAirTemperature() {
+    uint32_t updated = airTemperatureUpdatedMs.load(std::memory_order_acquire);
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    if (updated == 0 || now - updated > airTemperatureTimeoutMs) return DEFAULT_AIR_TEMPERATURE;
+    return airTemperature.load(std::memory_order_relaxed);
+}
+
+float Ultrasonic::speedOfSound(float celsius) {
+    return 0.03313f * std::sqrt(1.0f + celsius / 273.15f);  // 331.3 m/s at 0 °C
+}
+
+float Ultrasonic::pulseToDistance(uint32_t pulse_ticks, uint32_t resolution_hz, float speed) {
+    float pulse_us = pulse_ticks * (1000000.0f / resolution_hz);
+    return pulse_us * speed / 2;  // Round trip
+}
+
+uint32_t Ultrasonic::distanceToPulse(float distance, uint32_t resolution_hz, float speed) {
+    float pulse_us = distance * 2 / speed;
+    return (uint32_t)(pulse_us * (resolution_hz / 1000000.0f));
+}
@@ -1,21 +1,43 @@
 #ifndef ULTRASONIC_H
 #define ULTRASONIC_H
 
-#include <vector>
-#include "calibration.h"
+#include <stdint.h>
+#include <atomic>
+#include "distance_filter.h"
+#include "echo_capture.h"
 
 class Ultrasonic {
 public:
     Ultrasonic();
-    float getLevelPercentage();
-    void setSimulatedDistance(float distance);
-    void loadCalibrationFromNVS(const std::vector<CalibrationPoint>& calibration);
+    float getDistance() const;  // NaN until the first echo and once echoes stop
+    bool hasReading() const;
+    void setDistance(float distance);
+    bool consumeEchoes(EchoRingBuffer& samples, uint32_t resolution_hz);
+    void configureFilter(const FilterSettings_t& settings) { filter.configure(settings); }
+    const FilterSettings_t& getFilterSettings() const { return filter.getSettings(); }
+    void setAirTemperature(float celsius);  // From the bus or a local probe, safe from any task
+    float getAirTemperature();
+    uint32_t getMeasurementCount() const { return measurementCount.load(std::memory_order_relaxed); }
+    uint32_t getMissedEchoCount() const { return missedEchoCount.load(std::memory_order_relaxed); }
+
+    static float speedOfSound(float celsius);  // cm/us
+    static float pulseToDistance(uint32_t pulse_ticks, uint32_t resolution_hz, float speed = SPEED_OF_SOUND_20C);
+    static uint32_t distanceToPulse(float distance, uint32_t resolution_hz, float speed = SPEED_OF_SOUND_20C);
+
+    static constexpr float SPEED_OF_SOUND_20C = 0.0343;  // cm/us
+    static constexpr float DEFAULT_AIR_TEMPERATURE = 20.0;  // °C
 
 private:
-    float simulatedDistance;
-    std::vector<CalibrationPoint> calibrationPoints;
-    float interpolateLevel(float distance);
-    const float maxDistance = 120.0;  // Max 120 cm
+    std::atomic<float> currentDistance;
+    std::atomic<uint32_t> currentDistanceMs;
+    DistanceFilter filter;
+    std::atomic<float> airTemperature;
+    std::atomic<uint32_t> airTemperatureUpdatedMs;
+    std::atomic<uint32_t> measurementCount;
+    std::atomic<uint32_t> missedEchoCount;
+    const float maxEchoDistance = 400.0;  // Longer pulses are the sensor's no-echo timeout
+    const uint32_t airTemperatureTimeoutMs = 60000;  // Fall back to 20 °C if the source goes quiet
+    const uint32_t readingTimeoutMs = 30000;  // A sensor without an echo for this long has no reading
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,60 @@
+#include "web_assets.h"
+#include <esp_log.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "WebAssets";
+
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+extern const uint8_t config_html_gz_start[] asm("_binary_config_html_gz_start");
+extern const uint8_t config_html_gz_end[] asm("_binary_config_html_gz_end");
+extern const uint8_t wifi_html_gz_start[] asm("_binary_wifi_html_gz_start");
+extern const uint8_t wifi_html_gz_end[] asm("_binary_wifi_html_gz_end");
+
+static WebAsset assets[] = {
+    {"/", "text/html; charset=utf-8", index_html_gz_start, index_html_gz_end, ""},
+    {"/config_form", "text/html; charset=utf-8", config_html_gz_start, config_html_gz_end, ""},
+    {"/wifi_form", "text/html; charset=utf-8", wifi_html_gz_start, wifi_html_gz_end, ""},
+};
+
+// FNV-1a over the compressed bytes; computed once, the content never changes
+// without a new firmware image.
+static void computeEtag(WebAsset& asset) {
+    uint32_t hash = 2166136261UL;
+    for (const uint8_t* p = asset.start; p < asset.end; p++) {
+        hash = (hash ^ *p) * 16777619UL;
+    }
+    snprintf(asset.etag, sizeof(asset.etag), "\"%08lx\"", (unsigned long)hash);
+}
+
+static esp_err_t assetHandler(httpd_req_t* req) {
+    const WebAsset* asset = static_cast<const WebAsset*>(req->user_ctx);
+
+    char if_none_match[sizeof(asset->etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", asset->etag);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->contentType);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");  // Revalidate with the ETag on every load
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    return httpd_resp_send(req, reinterpret_cast<const char*>(asset->start), asset->end - asset->start);
+}
+
+void registerWebAssets(httpd_handle_t server) {
+    for (WebAsset& asset : assets) {
+        if (asset.etag[0] == '\0') computeEtag(asset);
+        httpd_uri_t uri = {};
+        uri.uri = asset.uri;
+        uri.method = HTTP_GET;
+        uri.handler = assetHandler;
+        uri.user_ctx = &asset;
+        httpd_register_uri_handler(server, &uri);
+        ESP_LOGD(TAG, "Serving %s, %d bytes gzipped, ETag %s", asset.uri, (int)(asset.end - asset.start), asset.etag);
+    }
+}
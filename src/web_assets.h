@@ -0,0 +1,22 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_http_server.h>
+
+// Static UI pages from web/, gzipped at build time and embedded in flash
+// (EMBED_FILES in CMakeLists.txt). They are sent as stored, with
+// Content-Encoding: gzip and an ETag, so a reload costs a 304 and serving
+// never copies or allocates.
+struct WebAsset {
+    const char* uri;
+    const char* contentType;
+    const uint8_t* start;
+    const uint8_t* end;
+    char etag[12];
+};
+
+void registerWebAssets(httpd_handle_t server);
+
+#endif
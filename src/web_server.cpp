@@ -1,25 +1,52 @@
 #include "web_server.h"
 #include <esp_log.h>
 #include <esp_http_server.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if !CONFIG_IDF_TARGET_LINUX
 #include <esp_wifi.h>
-#include <nvs_flash.h>
+#endif
 #include <string>
-#include <sstream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include <algorithm>
 #include <cmath>
-#include <iomanip>
 #include "N2kMessages.h"
 #include "calibration.h"
+#include "chunked_writer.h"
 #include "ultrasonic.h"
+#include "web_assets.h"
 
 static const char* TAG = "WebServer";
 
-WebServer::WebServer(N2kCanDriver* nmea2000, Ultrasonic* sensor) : _nmea2000(nmea2000), _sensor(sensor), _server(NULL) {
+static const std::pair<tN2kFluidType, const char*> fluid_types[] = {
+    {N2kft_Water, "fresh water"}, {N2kft_GrayWater, "grey water"}, {N2kft_BlackWater, "black water"},
+    {N2kft_Fuel, "fuel"}, {N2kft_Oil, "oil"}, {N2kft_LiveWell, "live well"}};
+
+static const char* fluidTypeName(tN2kFluidType type) {
+    for (const auto& fluid : fluid_types) {
+        if (fluid.first == type) return fluid.second;
+    }
+    return "unknown";
+}
+
+WebServer::WebServer(N2kCanDriver* nmea2000, ConfigStore* config_store, LevelHistory* history, Ultrasonic* sensors, size_t num_sensors)
+    : _nmea2000(nmea2000), _config(config_store), _history(history), _server(NULL) {
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        tanks[i].sensor = (i < num_sensors) ? &sensors[i] : nullptr;
+        tanks[i].beginUpdate().instance = i;
+        tanks[i].commitUpdate();
+    }
     config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.max_open_sockets = 4;
     config.stack_size = 24576;
-    config.max_uri_handlers = 12;
+    config.max_uri_handlers = 16;
     config.lru_purge_enable = true;
     config.recv_wait_timeout = 5;
     config.send_wait_timeout = 5;
@@ -60,235 +87,253 @@ float convertVolume(float value, const std::string& from_unit, const std::string
     return liter_value;
 }
 
-std::string formatNumber(float value) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(1) << value;
-    return oss.str();
-}
-
-float parseFloat(const std::string& value, float default_value = 0.0) {
-    std::string cleaned = value;
-    std::replace(cleaned.begin(), cleaned.end(), ',', '.');
-    if (cleaned.empty() || cleaned.find_first_not_of(" \t\n") == std::string::npos) {
-        ESP_LOGW(TAG, "Empty or whitespace-only input '%s', returning default: %.1f", value.c_str(), default_value);
+float parseFloat(const char* value, float default_value = 0.0) {
+    char cleaned[64];
+    size_t len = strnlen(value, sizeof(cleaned) - 1);
+    memcpy(cleaned, value, len);
+    cleaned[len] = '\0';
+    std::replace(cleaned, cleaned + len, ',', '.');
+    if (len == 0 || strspn(cleaned, " \t\n") == len) {
+        ESP_LOGW(TAG, "Empty or whitespace-only input '%s', returning default: %.1f", value, default_value);
         return default_value;
     }
 
     bool has_digit = false;
     bool has_decimal = false;
-    for (char c : cleaned) {
-        if (std::isdigit(c)) {
+    for (size_t i = 0; i < len; i++) {
+        char c = cleaned[i];
+        if (std::isdigit((unsigned char)c)) {
             has_digit = true;
         } else if (c == '.' && !has_decimal) {
             has_decimal = true;
-        } else if (c != '-' || (c == '-' && &c != &cleaned[0])) {
-            ESP_LOGW(TAG, "Invalid float format '%s', returning default: %.1f", cleaned.c_str(), default_value);
+        } else if (c != '-' || i != 0) {
+            ESP_LOGW(TAG, "Invalid float format '%s', returning default: %.1f", cleaned, default_value);
             return default_value;
         }
     }
     if (!has_digit) {
-        ESP_LOGW(TAG, "No digits in '%s', returning default: %.1f", cleaned.c_str(), default_value);
+        ESP_LOGW(TAG, "No digits in '%s', returning default: %.1f", cleaned, default_value);
         return default_value;
     }
 
-    size_t pos;
-    float result = std::stof(cleaned, &pos);
-    if (pos != cleaned.length()) {
-        ESP_LOGW(TAG, "Partial parse of '%s' to %.1f, trailing characters ignored", cleaned.c_str(), result);
+    char* end;
+    float result = strtof(cleaned, &end);
+    if (end != cleaned + len) {
+        ESP_LOGW(TAG, "Partial parse of '%s' to %.1f, trailing characters ignored", cleaned, result);
     }
     return result;
 }
 
-esp_err_t WebServer::rootHandler(httpd_req_t* req) {
-    float level_percent = getLevelPercentage();
-    float volume_liters = getTankVolumeLiters();
-
-    std::string resp = "<html><body><h1>Level Sensor</h1>";
-    resp += "<p>Level: " + formatNumber(level_percent) + "%</p>";
-    resp += "<p>Volume: " + formatNumber(convertVolume(volume_liters, "liter", getVolUnit())) + " " + getVolUnit() + "</p>";
-    resp += "<p id='status' style='color:green;display:none'>Saved</p>";
-
-    resp += "<h2>Tank</h2>";
-    resp += "<p>Height: " + formatNumber(convertDistance(tank_height, "cm", dist_unit)) + " " + dist_unit + "</p>";
-    resp += "<p>Volume: " + formatNumber(convertVolume(tank_volume, "liter", vol_unit)) + " " + vol_unit + "</p>";
-    resp += "<p>Offset: " + formatNumber(convertDistance(sensor_offset, "cm", dist_unit)) + " " + dist_unit + "</p>";
-    resp += "<p>Low Alarm: " + formatNumber(low_alarm_percent) + "% (" + formatNumber(convertVolume(getLowAlarmVolume(), "liter", vol_unit)) + " " + vol_unit + ")</p>";
-    resp += "<p>High Alarm: " + formatNumber(high_alarm_percent) + "% (" + formatNumber(convertVolume(getHighAlarmVolume(), "liter", vol_unit)) + " " + vol_unit + ")</p>";
-    resp += "<p>Shape: " + tank_shape + "</p>";
-    resp += "<form id='tankForm' onsubmit='saveTank(event)'><input type='submit' value='Edit Tank Settings'></form>";
-
-    resp += "<h2>Config</h2>";
-    resp += "<p>Interval: " + std::to_string(getTransmissionInterval()) + " ms</p>";
-    std::string device_name = getDeviceName();
-    std::replace(device_name.begin(), device_name.end(), '+', ' ');
-    resp += "<p>Name: " + device_name + "</p>";
-    resp += "<form id='configForm' onsubmit='saveConfig(event)'><input type='submit' value='Edit Config'></form>";
-
-    std::string ssid, password;
-    loadWiFiConfig(ssid, password);
-    resp += "<h2>WiFi</h2>";
-    resp += "<p>SSID: " + ssid + "</p>";
-    resp += "<form id='wifiForm' onsubmit='saveWifi(event)'><input type='submit' value='Edit WiFi'></form>";
-
-    resp += "<h2>System</h2><a href='/reboot'><button>Reboot</button></a>";
-
-    resp += "<script>";
-    resp += "function showStatus(){document.getElementById('status').style.display='block';setTimeout(function(){document.getElementById('status').style.display='none';},3000);}";
-    resp += "async function saveTank(e){e.preventDefault();const w=window.open('/tank_form','_blank','width=400,height=600');}";
-    resp += "async function saveConfig(e){e.preventDefault();const w=window.open('/config_form','_blank','width=400,height=400');}";
-    resp += "async function saveWifi(e){e.preventDefault();const w=window.open('/wifi_form','_blank','width=400,height=400');}";
-    resp += "</script>";
-
-    resp += "</body></html>";
-
-    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
-    httpd_resp_send(req, resp.c_str(), resp.length());
-    ESP_LOGI(TAG, "Served root page, level: %.1f%%", level_percent);
-    return ESP_OK;
+static void writeOption(ChunkedWriter& out, const char* value, const char* label, bool selected) {
+    out.printf("<option value='%s'%s>%s</option>", value, selected ? " selected" : "", label);
 }
 
+// Client-side helpers for the tank form. Only the tank dimensions are
+// substituted, the rest is sent from flash as is.
+static const char tank_form_script[] =
+    "function updateUnits(newUnit){"
+    "  var h=document.getElementById('tank_height'), o=document.getElementById('sensor_offset');"
+    "  h.value=(newUnit=='mm'?cm_h*10:(newUnit=='m'?cm_h/100:(newUnit=='inches'?cm_h/2.54:(newUnit=='ft'?cm_h/30.48:cm_h)))).toFixed(1);"
+    "  o.value=(newUnit=='mm'?cm_o*10:(newUnit=='m'?cm_o/100:(newUnit=='inches'?cm_o/2.54:(newUnit=='ft'?cm_o/30.48:cm_o)))).toFixed(1);"
+    "}"
+    "function updateVolumeUnit(newUnit){"
+    "  var v=document.getElementById('tank_volume');"
+    "  v.value=(newUnit=='m³'?liter/1000:(newUnit=='gallon'?liter/3.78541:(newUnit=='imperial gallon'?liter/4.54609:liter))).toFixed(1);"
+    "}"
+    "function toggleShapeRatio(select, reset){"
+    "  var o = select.options[select.selectedIndex];"
+    "  document.getElementById('shape_ratio_row').style.display = o.dataset.ratio ? 'block' : 'none';"
+    "  document.getElementById('shape_ratio_label').textContent = o.dataset.ratio || '';"
+    "  if (reset && o.dataset.ratio) document.getElementById('shape_ratio').value = o.dataset.default;"
+    "}"
+    "function toggleCalibrationPoints(shape){"
+    "  var display = (shape == 'custom') ? 'block' : 'none';"
+    "  document.getElementById('calibration_settings').style.display = display;"
+    "  updateCalibrationPoints();"
+    "}"
+    "function updateCalibrationPoints(){"
+    "  var numPoints = document.getElementById('num_calibration_points').value;"
+    "  var tankHeight = parseFloat(document.getElementById('tank_height').value);"
+    "  for (var i = 0; i < maxPoints; i++) {"
+    "    var pointDiv = document.getElementById('calibration_point_' + i);"
+    "    if (i < numPoints) {"
+    "      pointDiv.style.display = 'block';"
+    "      if (i == 0) {"
+    "        document.getElementById('calibration_distance_' + i).value = '0';"
+    "        document.getElementById('calibration_percentage_' + i).value = '100';"
+    "      } else if (i == numPoints - 1) {"
+    "        document.getElementById('calibration_distance_' + i).value = tankHeight;"
+    "        document.getElementById('calibration_percentage_' + i).value = '0';"
+    "      } else {"
+    "        var distance = (tankHeight / (numPoints - 1)) * i;"
+    "        var percentage = 100.0 - (100.0 / (numPoints - 1)) * i;"
+    "        document.getElementById('calibration_distance_' + i).value = distance.toFixed(1);"
+    "        document.getElementById('calibration_percentage_' + i).value = percentage.toFixed(1);"
+    "      }"
+    "    } else {"
+    "      pointDiv.style.display = 'none';"
+    "    }"
+    "  }"
+    "}"
+    "async function save(e,endpoint){"
+    "  e.preventDefault();"
+    "  const form=new FormData(e.target);"
+    "  form.set('tank_height', document.getElementById('tank_height').value);"
+    "  form.set('sensor_offset', document.getElementById('sensor_offset').value);"
+    "  form.set('tank_volume', document.getElementById('tank_volume').value);"
+    "  form.set('dist_unit', document.getElementById('dist_unit').value);"
+    "  form.set('vol_unit', document.getElementById('vol_unit').value);"
+    "  await fetch('/'+endpoint,{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:new URLSearchParams(form).toString()});"
+    "  window.opener.showStatus();window.opener.location.reload();window.close();}"
+    "window.onload = function() { var s = document.getElementById('tank_shape'); toggleShapeRatio(s, false); toggleCalibrationPoints(s.value); updateCalibrationPoints(); };";
+
+// Streamed through a ChunkedWriter, so the page is never held in memory as a
+// whole; each block below is formatted into the writer's stack buffer.
 esp_err_t WebServer::tankFormHandler(httpd_req_t* req) {
+    size_t tank_index = tankIndexFromQuery(req);
+    TankSettingsRef snapshot = tanks[tank_index].settings();
+    const TankSettings_t& tank = *snapshot;
     std::vector<CalibrationPoint> calibration;
-    loadCalibrationFromNVS(calibration);
+    loadCalibrationFromNVS(calibration, tank_index);
 
     int num_calibration_points = calibration.size();
     if (num_calibration_points < 3) num_calibration_points = 3;
-    if (num_calibration_points > 8) num_calibration_points = 8;
-
-    std::string resp = "<html><body><h1>Tank Settings</h1>";
-    resp += "<form id='tankForm' onsubmit='save(event, \"tank\")'>";
-    resp += "Height: <input type='text' name='tank_height' value='" + formatNumber(convertDistance(tank_height, "cm", dist_unit)) + "' id='tank_height' onchange='updateCalibrationPoints()'><br>";
-    resp += "Offset: <input type='text' name='sensor_offset' value='" + formatNumber(convertDistance(sensor_offset, "cm", dist_unit)) + "' id='sensor_offset'><br>";
-    resp += "Distance Unit: <select name='dist_unit' id='dist_unit' onchange='updateUnits(this.value)'>";
+    if (num_calibration_points > MAX_CALIBRATION_POINTS) num_calibration_points = MAX_CALIBRATION_POINTS;
+
+    char value[8];
+    ChunkedWriter out(req);
+    out.printf("<html><body><h1>Tank %d Settings</h1>", (int)tank_index + 1);
+    out.print("<form id='tankForm' onsubmit='save(event, \"tank\")'>");
+    out.printf("<input type='hidden' name='tank' value='%d'>", (int)tank_index);
+    out.printf("Instance: <input type='number' name='instance' min='0' max='15' value='%d'><br>", tank.instance);
+    out.print("Fluid: <select name='fluid_type'>");
+    for (const auto& fluid : fluid_types) {
+        snprintf(value, sizeof(value), "%d", (int)fluid.first);
+        writeOption(out, value, fluid.second, tank.fluid_type == fluid.first);
+    }
+    out.print("</select><br>");
+    out.printf("Height: <input type='text' name='tank_height' value='%.1f' id='tank_height' onchange='updateCalibrationPoints()'><br>",
+               convertDistance(tank.tank_height, "cm", dist_unit));
+    out.printf("Offset: <input type='text' name='sensor_offset' value='%.1f' id='sensor_offset'><br>",
+               convertDistance(tank.sensor_offset, "cm", dist_unit));
+    out.printf("Sensor Ahead of Centre: <input type='text' name='sensor_forward' value='%.1f'><br>",
+               convertDistance(tank.sensor_forward, "cm", dist_unit));
+    out.printf("Sensor Starboard of Centre: <input type='text' name='sensor_starboard' value='%.1f'><br>",
+               convertDistance(tank.sensor_starboard, "cm", dist_unit));
+    out.printf("Averaging (s, 0 = off): <input type='number' name='average_seconds' min='0' max='600' value='%u'><br>",
+               (unsigned)tank.average_seconds);
+    out.print("Distance Unit: <select name='dist_unit' id='dist_unit' onchange='updateUnits(this.value)'>");
     for (const char* unit : {"mm", "cm", "m", "inches", "ft"}) {
-        resp += "<option value='" + std::string(unit) + "' " + (dist_unit == unit ? "selected" : "") + ">" + unit + "</option>";
+        writeOption(out, unit, unit, dist_unit == unit);
     }
-    resp += "</select><br>";
-    resp += "Volume: <input type='text' name='tank_volume' value='" + formatNumber(convertVolume(tank_volume, "liter", vol_unit)) + "' id='tank_volume'><br>";
-    resp += "Volume Unit: <select name='vol_unit' id='vol_unit' onchange='updateVolumeUnit(this.value)'>";
+    out.print("</select><br>");
+    out.printf("Volume: <input type='text' name='tank_volume' value='%.1f' id='tank_volume'><br>",
+               convertVolume(tank.tank_volume, "liter", vol_unit));
+    out.print("Volume Unit: <select name='vol_unit' id='vol_unit' onchange='updateVolumeUnit(this.value)'>");
     for (const char* unit : {"liter", "m³", "gallon", "imperial gallon"}) {
-        resp += "<option value='" + std::string(unit) + "' " + (vol_unit == unit ? "selected" : "") + ">" + unit + "</option>";
+        writeOption(out, unit, unit, vol_unit == unit);
     }
-    resp += "</select><br>";
-    resp += "Low Alarm (%): <input type='text' name='low_alarm_percent' value='" + formatNumber(low_alarm_percent) + "'>%<br>";
-    resp += "High Alarm (%): <input type='text' name='high_alarm_percent' value='" + formatNumber(high_alarm_percent) + "'>%<br>";
-    resp += "Shape: <select name='tank_shape' id='tank_shape' onchange='toggleCalibrationPoints(this.value)'>";
-    for (const char* shape : {"rectangular", "cylindrical standing", "cylindrical laying flat", "custom"}) {
-        resp += "<option value='" + std::string(shape) + "' " + (tank_shape == shape ? "selected" : "") + ">" + shape + "</option>";
+    out.print("</select><br>");
+    out.printf("Low Alarm (%%): <input type='text' name='low_alarm_percent' value='%.1f'>%%<br>", tank.low_alarm_percent);
+    out.printf("High Alarm (%%): <input type='text' name='high_alarm_percent' value='%.1f'>%%<br>", tank.high_alarm_percent);
+    out.print("Shape: <select name='tank_shape' id='tank_shape' onchange='toggleShapeRatio(this, true); toggleCalibrationPoints(this.value)'>");
+    for (size_t i = 0; i < tank_shape_model_count; i++) {
+        const TankShapeModel& model = tank_shape_models[i];
+        out.printf("<option value='%s' data-ratio='%s' data-default='%g'%s>%s</option>", model.name,
+                   model.ratioLabel ? model.ratioLabel : "", model.defaultRatio,
+                   strcmp(tank.tank_shape, model.name) == 0 ? " selected" : "", model.name);
     }
-    resp += "</select><br>";
+    writeOption(out, "custom", "custom", strcmp(tank.tank_shape, "custom") == 0);
+    out.print("</select><br>");
+    out.printf("<div id='shape_ratio_row' style='display:none'><span id='shape_ratio_label'></span>: "
+               "<input type='text' name='shape_ratio' id='shape_ratio' value='%.2f'></div>", tank.shape_ratio);
 
     // Add dropdown for number of calibration points
-    resp += "<div id='calibration_settings' style='display:none'>";
-    resp += "Number of Calibration Points: <select name='num_calibration_points' id='num_calibration_points' onchange='updateCalibrationPoints()'>";
-    for (int i = 3; i <= 8; i++) {
-        resp += "<option value='" + std::to_string(i) + "' " + (i == num_calibration_points ? "selected" : "") + ">" + std::to_string(i) + "</option>";
+    out.print("<div id='calibration_settings' style='display:none'>");
+    out.print("Number of Calibration Points: <select name='num_calibration_points' id='num_calibration_points' onchange='updateCalibrationPoints()'>");
+    for (int i = 3; i <= MAX_CALIBRATION_POINTS; i++) {
+        snprintf(value, sizeof(value), "%d", i);
+        writeOption(out, value, value, i == num_calibration_points);
     }
-    resp += "</select><br>";
+    out.print("</select><br>");
 
-    // Add fields for up to 8 calibration points
-    for (int i = 0; i < 8; i++) {
-        resp += "<div id='calibration_point_" + std::to_string(i) + "' style='display:" + (i < num_calibration_points ? "block" : "none") + "'>";
-        resp += "Calibration Point " + std::to_string(i + 1) + ":<br>";
+    // Add fields for up to MAX_CALIBRATION_POINTS calibration points
+    for (int i = 0; i < MAX_CALIBRATION_POINTS && out.ok(); i++) {
+        out.printf("<div id='calibration_point_%d' style='display:%s'>Calibration Point %d:<br>",
+                   i, i < num_calibration_points ? "block" : "none", i + 1);
         if (i == 0) {
-            resp += "Distance: <input type='text' name='calibration_distance_" + std::to_string(i) + "' value='0' disabled><br>";
-            resp += "Percentage: <input type='text' name='calibration_percentage_" + std::to_string(i) + "' value='100' disabled><br>";
+            out.printf("Distance: <input type='text' name='calibration_distance_%d' value='0' disabled><br>", i);
+            out.printf("Percentage: <input type='text' name='calibration_percentage_%d' value='100' disabled><br>", i);
         } else if (i == num_calibration_points - 1) {
-            resp += "Distance: <input type='text' name='calibration_distance_" + std::to_string(i) + "' value='" + formatNumber(tank_height) + "' id='last_calibration_distance' disabled><br>";
-            resp += "Percentage: <input type='text' name='calibration_percentage_" + std::to_string(i) + "' value='0' disabled><br>";
+            out.printf("Distance: <input type='text' name='calibration_distance_%d' value='%.1f' id='last_calibration_distance' disabled><br>",
+                       i, tank.tank_height);
+            out.printf("Percentage: <input type='text' name='calibration_percentage_%d' value='0' disabled><br>", i);
         } else {
-            float distance = (i < calibration.size()) ? calibration[i].distance : (tank_height / (num_calibration_points - 1)) * i;
-            float percentage = (i < calibration.size()) ? calibration[i].percentage : 100.0 - (100.0 / (num_calibration_points - 1)) * i;
-            resp += "Distance: <input type='text' name='calibration_distance_" + std::to_string(i) + "' value='" + formatNumber(distance) + "'><br>";
-            resp += "Percentage: <input type='text' name='calibration_percentage_" + std::to_string(i) + "' value='" + formatNumber(percentage) + "'><br>";
+            float distance = (i < (int)calibration.size()) ? calibration[i].distance : (tank.tank_height / (num_calibration_points - 1)) * i;
+            float percentage = (i < (int)calibration.size()) ? calibration[i].percentage : 100.0 - (100.0 / (num_calibration_points - 1)) * i;
+            out.printf("Distance: <input type='text' name='calibration_distance_%d' value='%.1f'><br>", i, distance);
+            out.printf("Percentage: <input type='text' name='calibration_percentage_%d' value='%.1f'><br>", i, percentage);
         }
-        resp += "</div>";
-    }
-    resp += "</div>";
-
-    resp += "<input type='submit' value='Save'></form>";
-    resp += "<script>";
-    resp += "function updateUnits(newUnit){";
-    resp += "  var h=document.getElementById('tank_height'), o=document.getElementById('sensor_offset'), cm_h=" + std::to_string(tank_height) + ", cm_o=" + std::to_string(sensor_offset) + ";";
-    resp += "  h.value=(newUnit=='mm'?cm_h*10:(newUnit=='m'?cm_h/100:(newUnit=='inches'?cm_h/2.54:(newUnit=='ft'?cm_h/30.48:cm_h)))).toFixed(1);";
-    resp += "  o.value=(newUnit=='mm'?cm_o*10:(newUnit=='m'?cm_o/100:(newUnit=='inches'?cm_o/2.54:(newUnit=='ft'?cm_o/30.48:cm_o)))).toFixed(1);";
-    resp += "}";
-    resp += "function updateVolumeUnit(newUnit){";
-    resp += "  var v=document.getElementById('tank_volume'), liter=" + std::to_string(tank_volume) + ";";
-    resp += "  v.value=(newUnit=='m³'?liter/1000:(newUnit=='gallon'?liter/3.78541:(newUnit=='imperial gallon'?liter/4.54609:liter))).toFixed(1);";
-    resp += "}";
-    resp += "function toggleCalibrationPoints(shape){";
-    resp += "  var display = (shape == 'custom') ? 'block' : 'none';";
-    resp += "  document.getElementById('calibration_settings').style.display = display;";
-    resp += "  updateCalibrationPoints();";
-    resp += "}";
-    resp += "function updateCalibrationPoints(){";
-    resp += "  var numPoints = document.getElementById('num_calibration_points').value;";
-    resp += "  var tankHeight = parseFloat(document.getElementById('tank_height').value);";
-    resp += "  for (var i = 0; i < 8; i++) {";
-    resp += "    var pointDiv = document.getElementById('calibration_point_' + i);";
-    resp += "    if (i < numPoints) {";
-    resp += "      pointDiv.style.display = 'block';";
-    resp += "      if (i == 0) {";
-    resp += "        document.getElementById('calibration_distance_' + i).value = '0';";
-    resp += "        document.getElementById('calibration_percentage_' + i).value = '100';";
-    resp += "      } else if (i == numPoints - 1) {";
-    resp += "        document.getElementById('calibration_distance_' + i).value = tankHeight;";
-    resp += "        document.getElementById('calibration_percentage_' + i).value = '0';";
-    resp += "      } else {";
-    resp += "        var distance = (tankHeight / (numPoints - 1)) * i;";
-    resp += "        var percentage = 100.0 - (100.0 / (numPoints - 1)) * i;";
-    resp += "        document.getElementById('calibration_distance_' + i).value = distance.toFixed(1);";
-    resp += "        document.getElementById('calibration_percentage_' + i).value = percentage.toFixed(1);";
-    resp += "      }";
-    resp += "    } else {";
-    resp += "      pointDiv.style.display = 'none';";
-    resp += "    }";
-    resp += "  }";
-    resp += "}";
-    resp += "async function save(e,endpoint){";
-    resp += "  e.preventDefault();";
-    resp += "  const form=new FormData(e.target);";
-    resp += "  form.set('tank_height', document.getElementById('tank_height').value);";
-    resp += "  form.set('sensor_offset', document.getElementById('sensor_offset').value);";
-    resp += "  form.set('tank_volume', document.getElementById('tank_volume').value);";
-    resp += "  form.set('dist_unit', document.getElementById('dist_unit').value);";
-    resp += "  form.set('vol_unit', document.getElementById('vol_unit').value);";
-    resp += "  await fetch('/'+endpoint,{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:new URLSearchParams(form).toString()});";
-    resp += "  window.opener.showStatus();window.opener.location.reload();window.close();}";
-    resp += "window.onload = function() { toggleCalibrationPoints(document.getElementById('tank_shape').value); updateCalibrationPoints(); };";
-    resp += "</script>";
-    resp += "</body></html>";
+        out.print("</div>");
+    }
+    out.print("</div>");
 
-    httpd_resp_send(req, resp.c_str(), resp.length());
-    return ESP_OK;
+    out.print("<input type='submit' value='Save'></form>");
+    out.printf("<script>var cm_h=%f, cm_o=%f, liter=%f, maxPoints=%d;",
+               tank.tank_height, tank.sensor_offset, tank.tank_volume, MAX_CALIBRATION_POINTS);
+    out.print(tank_form_script);
+    out.print("</script></body></html>");
+
+    esp_err_t err = out.finish();
+    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to send tank form: %d", err);
+    return err;
 }
+
 esp_err_t WebServer::tankHandler(httpd_req_t* req) {
-    char buf[2048];
-    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
-    if (ret <= 0) {
-        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-            httpd_resp_send_408(req);
-            ESP_LOGE(TAG, "Tank request timeout");
-        } else {
-            ESP_LOGE(TAG, "Tank request failed: %d", ret);
-        }
+    // A full calibration table is about 4.5 KB of form fields, more than
+    // one recv returns, so read until the whole body is in
+    char buf[6144];
+    if (req->content_len >= sizeof(buf)) {
+        ESP_LOGE(TAG, "Tank request too large: %d bytes", (int)req->content_len);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request too large");
         return ESP_FAIL;
     }
-    buf[ret] = '\0';
-    ESP_LOGI(TAG, "Tank request (POST) received, length=%d: %s", ret, buf);
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+                ESP_LOGE(TAG, "Tank request timeout");
+            } else {
+                ESP_LOGE(TAG, "Tank request failed: %d", ret);
+            }
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    buf[received] = '\0';
+    ESP_LOGI(TAG, "Tank request (POST) received, length=%d", (int)received);
+    ESP_LOGD(TAG, "Tank request body: %s", buf);
 
     char param[64];
-    float tank_height_new = tank_height;
-    float tank_volume_new = tank_volume;
-    float sensor_offset_new = sensor_offset;
-    float low_alarm_percent_new = low_alarm_percent;
-    float high_alarm_percent_new = high_alarm_percent;
-    std::string tank_shape_new = tank_shape;
+    size_t tank_index = 0;
+    if (httpd_query_key_value(buf, "tank", param, sizeof(param)) == ESP_OK) {
+        tank_index = strtoul(param, NULL, 10);
+        if (tank_index >= MAX_TANKS) tank_index = 0;
+    }
+    Tank& tank = tanks[tank_index];
+    TankSettings_t settings = *tank.settings();
     std::string dist_unit_new = dist_unit;
     std::string vol_unit_new = vol_unit;
     int num_calibration_points = 3;
 
+    if (httpd_query_key_value(buf, "instance", param, sizeof(param)) == ESP_OK) {
+        settings.instance = std::min(strtoul(param, NULL, 10), 15UL);
+    }
+    if (httpd_query_key_value(buf, "fluid_type", param, sizeof(param)) == ESP_OK) {
+        settings.fluid_type = static_cast<tN2kFluidType>(strtoul(param, NULL, 10));
+    }
     if (httpd_query_key_value(buf, "dist_unit", param, sizeof(param)) == ESP_OK) {
         dist_unit_new = param;
     }
@@ -296,31 +341,44 @@ esp_err_t WebServer::tankHandler(httpd_req_t* req) {
         vol_unit_new = param;
     }
     if (httpd_query_key_value(buf, "tank_height", param, sizeof(param)) == ESP_OK) {
-        tank_height_new = convertDistance(parseFloat(param, tank_height), dist_unit_new, "cm");
+        settings.tank_height = convertDistance(parseFloat(param, settings.tank_height), dist_unit_new, "cm");
     }
     if (httpd_query_key_value(buf, "tank_volume", param, sizeof(param)) == ESP_OK) {
-        tank_volume_new = convertVolume(parseFloat(param, tank_volume), vol_unit_new, "liter");
+        settings.tank_volume = convertVolume(parseFloat(param, settings.tank_volume), vol_unit_new, "liter");
     }
     if (httpd_query_key_value(buf, "sensor_offset", param, sizeof(param)) == ESP_OK) {
-        sensor_offset_new = convertDistance(parseFloat(param, sensor_offset), dist_unit_new, "cm");
+        settings.sensor_offset = convertDistance(parseFloat(param, settings.sensor_offset), dist_unit_new, "cm");
+    }
+    if (httpd_query_key_value(buf, "sensor_forward", param, sizeof(param)) == ESP_OK) {
+        settings.sensor_forward = convertDistance(parseFloat(param, settings.sensor_forward), dist_unit_new, "cm");
+    }
+    if (httpd_query_key_value(buf, "sensor_starboard", param, sizeof(param)) == ESP_OK) {
+        settings.sensor_starboard = convertDistance(parseFloat(param, settings.sensor_starboard), dist_unit_new, "cm");
+    }
+    if (httpd_query_key_value(buf, "average_seconds", param, sizeof(param)) == ESP_OK) {
+        settings.average_seconds = std::min(strtoul(param, NULL, 10), 600UL);
     }
     if (httpd_query_key_value(buf, "low_alarm_percent", param, sizeof(param)) == ESP_OK) {
-        low_alarm_percent_new = parseFloat(param, low_alarm_percent);
-        if (low_alarm_percent_new > 100.0) low_alarm_percent_new = 100.0;
-        if (low_alarm_percent_new < 0.0) low_alarm_percent_new = 0.0;
+        settings.low_alarm_percent = parseFloat(param, settings.low_alarm_percent);
+        if (settings.low_alarm_percent > 100.0) settings.low_alarm_percent = 100.0;
+        if (settings.low_alarm_percent < 0.0) settings.low_alarm_percent = 0.0;
     }
     if (httpd_query_key_value(buf, "high_alarm_percent", param, sizeof(param)) == ESP_OK) {
-        high_alarm_percent_new = parseFloat(param, high_alarm_percent);
-        if (high_alarm_percent_new > 100.0) high_alarm_percent_new = 100.0;
-        if (high_alarm_percent_new < 0.0) high_alarm_percent_new = 0.0;
+        settings.high_alarm_percent = parseFloat(param, settings.high_alarm_percent);
+        if (settings.high_alarm_percent > 100.0) settings.high_alarm_percent = 100.0;
+        if (settings.high_alarm_percent < 0.0) settings.high_alarm_percent = 0.0;
     }
     if (httpd_query_key_value(buf, "tank_shape", param, sizeof(param)) == ESP_OK) {
-        tank_shape_new = param;
+        strncpy(settings.tank_shape, param, sizeof(settings.tank_shape) - 1);
+        settings.tank_shape[sizeof(settings.tank_shape) - 1] = '\0';
+    }
+    if (httpd_query_key_value(buf, "shape_ratio", param, sizeof(param)) == ESP_OK) {
+        settings.shape_ratio = parseFloat(param, settings.shape_ratio);
     }
     if (httpd_query_key_value(buf, "num_calibration_points", param, sizeof(param)) == ESP_OK) {
         num_calibration_points = std::stoi(param);
         if (num_calibration_points < 3) num_calibration_points = 3;
-        if (num_calibration_points > 8) num_calibration_points = 8;
+        if (num_calibration_points > MAX_CALIBRATION_POINTS) num_calibration_points = MAX_CALIBRATION_POINTS;
     }
 
     // Handle calibration points
@@ -337,44 +395,22 @@ esp_err_t WebServer::tankHandler(httpd_req_t* req) {
         }
     }
 
-    tank_height = tank_height_new;
-    tank_volume = tank_volume_new;
-    sensor_offset = sensor_offset_new;
-    low_alarm_percent = low_alarm_percent_new;
-    high_alarm_percent = high_alarm_percent_new;
-    tank_shape = tank_shape_new;
+    // Recompile the lookup tables and hand nmea_task the new settings in one swap
+    settings.buildGeometry();
+    settings.custom_transfer.build(calibration);
+    tank.publishSettings(settings);
     dist_unit = dist_unit_new;
     vol_unit = vol_unit_new;
 
-    // Save calibration points to NVS
-    saveCalibrationToNVS(calibration);
+    saveCalibrationToNVS(calibration, tank_index);
 
     saveSettingsToNVS();
 
-    ESP_LOGI(TAG, "Tank settings saved successfully");
+    ESP_LOGI(TAG, "Tank %d settings saved successfully", (int)tank_index);
     httpd_resp_send(req, "OK", 2);
     return ESP_OK;
 }
 
-esp_err_t WebServer::configFormHandler(httpd_req_t* req) {
-    std::string resp = "<html><body><h1>Config</h1>";
-    resp += "<form id='configForm' onsubmit='save(event, \"config\")'>";
-    resp += "Interval (ms): <input type='number' name='interval' min='500' max='10000' value='" + std::to_string(getTransmissionInterval()) + "'><br>";
-    std::string device_name = getDeviceName();
-    std::replace(device_name.begin(), device_name.end(), '+', ' ');
-    resp += "Name: <input type='text' name='device_name' maxlength='31' value='" + device_name + "'><br>";
-    resp += "<input type='submit' value='Save'></form>";
-    resp += "<script>";
-    resp += "async function save(e,endpoint){e.preventDefault();const form=new FormData(e.target);";
-    resp += "await fetch('/'+endpoint,{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:new URLSearchParams(form).toString()});";
-    resp += "window.opener.showStatus();window.close();}";
-    resp += "</script>";
-    resp += "</body></html>";
-
-    httpd_resp_send(req, resp.c_str(), resp.length());
-    return ESP_OK;
-}
-
 esp_err_t WebServer::configHandler(httpd_req_t* req) {
     char buf[1024];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -392,10 +428,46 @@ esp_err_t WebServer::configHandler(httpd_req_t* req) {
         uint32_t interval = std::stoi(param);
         setTransmissionInterval(interval);
     }
+    if (httpd_query_key_value(buf, "min_interval", param, sizeof(param)) == ESP_OK) {
+        _nmea2000->setMinTransmissionInterval(strtoul(param, NULL, 10));
+    }
+    if (httpd_query_key_value(buf, "deadband", param, sizeof(param)) == ESP_OK) {
+        _nmea2000->setLevelDeadband(parseFloat(param, _nmea2000->getLevelDeadband()));
+    }
     if (httpd_query_key_value(buf, "device_name", param, sizeof(param)) == ESP_OK) {
         setDeviceName(param);
     }
 
+    if (httpd_query_key_value(buf, "temperature_source", param, sizeof(param)) == ESP_OK) {
+        uint32_t source = strtoul(param, NULL, 10);
+        temperature_source.store(source, std::memory_order_relaxed);
+        saveToNVM<uint32_t>("temp_source", source);  // NVS keys are at most 15 characters
+    }
+    if (httpd_query_key_value(buf, "num_tanks", param, sizeof(param)) == ESP_OK) {
+        uint32_t count = std::min(std::max(strtoul(param, NULL, 10), 1UL), (unsigned long)MAX_TANKS);
+        num_tanks.store(count, std::memory_order_relaxed);
+        saveToNVM<uint32_t>("num_tanks", count);
+    }
+
+    FilterSettings_t filter = tanks[0].sensor->getFilterSettings();
+    if (httpd_query_key_value(buf, "median_enabled", param, sizeof(param)) == ESP_OK) {
+        filter.medianEnabled = (param[0] == '1');
+    }
+    if (httpd_query_key_value(buf, "median_window", param, sizeof(param)) == ESP_OK) {
+        filter.medianWindow = static_cast<uint8_t>(parseFloat(param, filter.medianWindow));
+    }
+    if (httpd_query_key_value(buf, "kalman_enabled", param, sizeof(param)) == ESP_OK) {
+        filter.kalmanEnabled = (param[0] == '1');
+    }
+    if (httpd_query_key_value(buf, "process_noise", param, sizeof(param)) == ESP_OK) {
+        filter.processNoise = parseFloat(param, filter.processNoise);
+    }
+    if (httpd_query_key_value(buf, "measurement_noise", param, sizeof(param)) == ESP_OK) {
+        filter.measurementNoise = parseFloat(param, filter.measurementNoise);
+    }
+    configureFilters(filter);
+    saveFilterSettingsToNVS(tanks[0].sensor->getFilterSettings());
+
     saveSettingsToNVS();
 
     ESP_LOGI(TAG, "Config saved");
@@ -404,6 +476,12 @@ esp_err_t WebServer::configHandler(httpd_req_t* req) {
 }
 
 esp_err_t WebServer::wifiScanHandler(httpd_req_t* req) {
+#if CONFIG_IDF_TARGET_LINUX
+    // No radio on the host build, report an empty scan
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "[]", 2);
+    return ESP_OK;
+#else
     ESP_LOGI(TAG, "Starting WiFi scan on all channels");
 
     wifi_mode_t current_mode;
@@ -457,42 +535,7 @@ esp_err_t WebServer::wifiScanHandler(httpd_req_t* req) {
     httpd_resp_send(req, json.c_str(), json.length());
     ESP_LOGI(TAG, "WiFi scan completed, found %d APs", ap_count);
     return ESP_OK;
-}
-
-esp_err_t WebServer::wifiFormHandler(httpd_req_t* req) {
-    std::string ssid, password;
-    loadWiFiConfig(ssid, password);
-    std::string resp = "<html><body><h1>WiFi Settings</h1>";
-    resp += "<form id='wifiForm' onsubmit='saveWifi(event)'>";
-    resp += "SSID: <select name='ssid' id='ssid'></select><br>";
-    resp += "<button type='button' onclick='scanNetworks()'>Scan Networks</button><br>";
-    resp += "Password: <input type='text' name='password' id='password' value='" + password + "'><br>";
-    resp += "<input type='submit' value='Save & Connect'></form>";
-    resp += "<br><form id='apModeForm' action='/wifi_reset' method='POST'><input type='submit' value='Switch to AP Mode'></form>";
-    resp += "<script>";
-    resp += "async function scanNetworks(){";
-    resp += "  const res=await fetch('/wifi_scan');";
-    resp += "  const networks=await res.json();";
-    resp += "  const select=document.getElementById('ssid');";
-    resp += "  select.innerHTML='';";
-    resp += "  networks.forEach(n => {";
-    resp += "    const opt=document.createElement('option');";
-    resp += "    opt.value=n.ssid;opt.text=n.ssid + ' (' + n.rssi + ' dBm, Ch ' + n.channel + ')';";
-    resp += "    select.appendChild(opt);";
-    resp += "  });";
-    resp += "}";
-    resp += "async function saveWifi(e){";
-    resp += "  e.preventDefault();";
-    resp += "  const form=new FormData(e.target);";
-    resp += "  await fetch('/wifi',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:new URLSearchParams(form).toString()});";
-    resp += "  window.opener.showStatus();window.close();";
-    resp += "}";
-    resp += "window.onload = scanNetworks;";
-    resp += "</script>";
-    resp += "</body></html>";
-
-    httpd_resp_send(req, resp.c_str(), resp.length());
-    return ESP_OK;
+#endif
 }
 
 esp_err_t WebServer::wifiHandler(httpd_req_t* req) {
@@ -511,6 +554,7 @@ esp_err_t WebServer::wifiHandler(httpd_req_t* req) {
     if (httpd_query_key_value(buf, "ssid", ssid, sizeof(ssid)) == ESP_OK &&
         httpd_query_key_value(buf, "password", password, sizeof(password)) == ESP_OK) {
         connectToWiFi(ssid, password);
+        _config->flush();
         vTaskDelay(pdMS_TO_TICKS(1000));
         esp_restart();
     }
@@ -522,20 +566,15 @@ esp_err_t WebServer::wifiHandler(httpd_req_t* req) {
 
 esp_err_t WebServer::wifiResetHandler(httpd_req_t* req) {
     ESP_LOGI(TAG, "WiFi reset requested, erasing credentials and switching to AP mode");
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("wifi_config", NVS_READWRITE, &nvs);
-    if (ret == ESP_OK) {
-        nvs_erase_all(nvs);
-        nvs_commit(nvs);
-        nvs_close(nvs);
-    } else {
-        ESP_LOGE(TAG, "Failed to open NVS for WiFi reset: %d", ret);
-    }
+    _config->eraseNamespace("wifi_config");
+    _config->flush();
+#if !CONFIG_IDF_TARGET_LINUX
     esp_wifi_stop();
     esp_wifi_deinit();
     esp_netif_create_default_wifi_ap();
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+#endif
     startWiFiAP();
     httpd_resp_send(req, "OK", 2);
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -545,13 +584,386 @@ esp_err_t WebServer::wifiResetHandler(httpd_req_t* req) {
 
 esp_err_t WebServer::rebootHandler(httpd_req_t* req) {
     ESP_LOGI(TAG, "Reboot requested");
+    _config->flush();
     vTaskDelay(pdMS_TO_TICKS(1000));
     esp_restart();
     return ESP_OK;
 }
 
+static void appendMetric(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+static void appendSample(std::string& out, const char* name, const char* labels, double value) {
+    char line[128];
+    snprintf(line, sizeof(line), "%s%s %.10g\n", name, labels, value);
+    out += line;
+}
+
+static void appendPgnSamples(std::string& out, const char* name, const PgnCounters<32>& counters) {
+    char labels[24];
+    for (size_t i = 0; i < counters.capacity(); i++) {
+        uint32_t pgn, count;
+        if (!counters.get(i, pgn, count)) continue;
+        snprintf(labels, sizeof(labels), "{pgn=\"%lu\"}", (unsigned long)pgn);
+        appendSample(out, name, labels, count);
+    }
+    appendSample(out, name, "{pgn=\"other\"}", counters.overflow());
+}
+
+// Prometheus text exposition. Everything read here is an atomic counter or a
+// kernel/driver snapshot, so scraping never blocks the CAN or sensor tasks.
+esp_err_t WebServer::metricsHandler(httpd_req_t* req) {
+    size_t tank_count = getNumTanks();
+    std::string resp;
+    resp.reserve(4096);
+    char labels[48];
+
+    appendMetric(resp, "n2k_rx_frames_total", "counter", "CAN frames received, by PGN");
+    appendPgnSamples(resp, "n2k_rx_frames_total", _nmea2000->getRxPgnCounters());
+    appendMetric(resp, "n2k_tx_frames_total", "counter", "CAN frames sent, by PGN");
+    appendPgnSamples(resp, "n2k_tx_frames_total", _nmea2000->getTxPgnCounters());
+
+    CanTxStats_t tx = _nmea2000->getTxStats();
+    appendMetric(resp, "can_tx_retries_total", "counter", "Transmit attempts refused by the controller");
+    appendSample(resp, "can_tx_retries_total", "", tx.retries);
+    appendMetric(resp, "can_tx_dropped_total", "counter", "Frames dropped on queue overflow or timeout");
+    appendSample(resp, "can_tx_dropped_total", "", tx.dropped);
+    appendMetric(resp, "can_tx_queue_high_water", "gauge", "Most frames waiting in the software TX queue");
+    appendSample(resp, "can_tx_queue_high_water", "", tx.queueHighWater);
+    appendMetric(resp, "can_bus_off_total", "counter", "Bus-off events");
+    appendSample(resp, "can_bus_off_total", "", tx.busOff);
+
+    CanBusStatus_t bus;
+    if (_nmea2000->getBusStatus(bus)) {
+        appendMetric(resp, "can_bus_state", "gauge", "Controller state");
+        for (const char* state : {"running", "bus_off", "recovering", "stopped"}) {
+            snprintf(labels, sizeof(labels), "{state=\"%s\"}", state);
+            appendSample(resp, "can_bus_state", labels, strcmp(state, bus.state) == 0 ? 1 : 0);
+        }
+        appendMetric(resp, "can_tx_error_counter", "gauge", "Transmit error counter (TEC)");
+        appendSample(resp, "can_tx_error_counter", "", bus.txErrors);
+        appendMetric(resp, "can_rx_error_counter", "gauge", "Receive error counter (REC)");
+        appendSample(resp, "can_rx_error_counter", "", bus.rxErrors);
+        appendMetric(resp, "can_rx_missed_total", "counter", "Frames lost to a full RX queue");
+        appendSample(resp, "can_rx_missed_total", "", bus.rxMissed);
+        appendMetric(resp, "can_rx_overrun_total", "counter", "Frames lost to controller FIFO overrun");
+        appendSample(resp, "can_rx_overrun_total", "", bus.rxOverrun);
+        appendMetric(resp, "can_bus_errors_total", "counter", "Bus errors");
+        appendSample(resp, "can_bus_errors_total", "", bus.busErrors);
+        appendMetric(resp, "can_arbitration_lost_total", "counter", "Arbitration losses");
+        appendSample(resp, "can_arbitration_lost_total", "", bus.arbLost);
+        appendMetric(resp, "can_rx_queue_high_water", "gauge", "Most frames seen waiting in the RX queue");
+        appendSample(resp, "can_rx_queue_high_water", "", bus.rxQueueHighWater);
+    }
+
+    appendMetric(resp, "level_measurements_total", "counter", "Echoes accepted into the level filter");
+    for (size_t i = 0; i < tank_count; i++) {
+        snprintf(labels, sizeof(labels), "{tank=\"%d\"}", (int)i + 1);
+        appendSample(resp, "level_measurements_total", labels, tanks[i].sensor ? tanks[i].sensor->getMeasurementCount() : 0);
+    }
+    appendMetric(resp, "level_missed_echoes_total", "counter", "Triggers that timed out without an echo");
+    for (size_t i = 0; i < tank_count; i++) {
+        snprintf(labels, sizeof(labels), "{tank=\"%d\"}", (int)i + 1);
+        appendSample(resp, "level_missed_echoes_total", labels, tanks[i].sensor ? tanks[i].sensor->getMissedEchoCount() : 0);
+    }
+    appendMetric(resp, "level_percent", "gauge", "Current fluid level");
+    for (size_t i = 0; i < tank_count; i++) {
+        float level = tanks[i].getLevelPercentage();
+        if (std::isnan(level)) continue;  // No reading
+        snprintf(labels, sizeof(labels), "{tank=\"%d\"}", (int)i + 1);
+        appendSample(resp, "level_percent", labels, level);
+    }
+    appendMetric(resp, "level_rate_percent_per_hour", "gauge", "Fill (+) or drain (-) rate over the last 10 minutes");
+    for (size_t i = 0; i < tank_count; i++) {
+        float rate = tanks[i].rate.getRatePercentPerHour();
+        if (!std::isfinite(rate)) continue;
+        snprintf(labels, sizeof(labels), "{tank=\"%d\"}", (int)i + 1);
+        appendSample(resp, "level_rate_percent_per_hour", labels, rate);
+    }
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    std::vector<TaskStatus_t> tasks(uxTaskGetNumberOfTasks() + 2);
+    UBaseType_t count = uxTaskGetSystemState(tasks.data(), tasks.size(), NULL);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    appendMetric(resp, "task_runtime_seconds_total", "counter", "CPU time used by each task");
+    for (UBaseType_t i = 0; i < count; i++) {
+        snprintf(labels, sizeof(labels), "{task=\"%s\"}", tasks[i].pcTaskName);
+        appendSample(resp, "task_runtime_seconds_total", labels, tasks[i].ulRunTimeCounter / 1e6);  // esp_timer clock, us
+    }
+#endif
+    appendMetric(resp, "task_stack_high_water_bytes", "gauge", "Least free stack seen for each task");
+    for (UBaseType_t i = 0; i < count; i++) {
+        snprintf(labels, sizeof(labels), "{task=\"%s\"}", tasks[i].pcTaskName);
+        appendSample(resp, "task_stack_high_water_bytes", labels, tasks[i].usStackHighWaterMark);
+    }
+#endif
+
+#if !CONFIG_IDF_TARGET_LINUX
+    appendMetric(resp, "heap_free_bytes", "gauge", "Free heap");
+    appendSample(resp, "heap_free_bytes", "", esp_get_free_heap_size());
+    appendMetric(resp, "heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+    appendSample(resp, "heap_min_free_bytes", "", esp_get_minimum_free_heap_size());
+#endif
+    appendMetric(resp, "nvs_commits_total", "counter", "NVS commits made by the config store");
+    appendSample(resp, "nvs_commits_total", "", _config->getCommitCount());
+    appendMetric(resp, "uptime_seconds", "counter", "Time since boot");
+    appendSample(resp, "uptime_seconds", "", esp_timer_get_time() / 1e6);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_send(req, resp.c_str(), resp.length());
+    return ESP_OK;
+}
+
+esp_err_t WebServer::sendJson(httpd_req_t* req, const JsonWriter& json) {
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "JSON response for %s does not fit in %d bytes", req->uri, (int)sizeof(json_buffer));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+void WebServer::writeDeviceName(JsonWriter& json) {
+    char name[32];
+    strncpy(name, _nmea2000->getDeviceName().c_str(), sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    std::replace(name, name + strlen(name), '+', ' ');
+    json.key("device_name").string(name);
+}
+
+// Live values for the fleet poller. Lengths are in cm and volumes in litres
+// regardless of the display units, which are reported alongside.
+esp_err_t WebServer::apiStatusHandler(httpd_req_t* req) {
+    size_t tank_count = getNumTanks();
+    JsonWriter json(json_buffer, sizeof(json_buffer));
+    json.beginObject();
+    writeDeviceName(json);
+    json.key("units").beginObject().key("distance").string(dist_unit.c_str()).key("volume").string(vol_unit.c_str()).endObject();
+    json.key("interval_ms").number(getTransmissionInterval());
+    if (tanks[0].sensor) json.key("air_temperature_c").number(tanks[0].sensor->getAirTemperature(), 1);
+    json.key("tanks").beginArray();
+    for (size_t i = 0; i < tank_count; i++) {
+        Tank& tank = tanks[i];
+        TankSettingsRef snapshot = tank.settings();
+        const TankSettings_t& settings = *snapshot;
+        json.beginObject();
+        json.key("instance").number((uint32_t)settings.instance);
+        json.key("fluid").string(fluidTypeName(settings.fluid_type));
+        json.key("level_percent").number(tank.getLevelPercentage(), 1);
+        json.key("volume_liters").number(tank.getTankVolumeLiters(), 1);
+        json.key("capacity_liters").number(settings.tank_volume, 1);
+        float level = tank.getLevelPercentage(settings);
+        json.key("rate_liters_per_hour").number(tank.rate.getRatePercentPerHour() * settings.tank_volume / 100.0f, 2);
+        json.key("hours_to_empty").number(tank.rate.hoursUntil(level, 0.0f), 1);
+        json.key("hours_to_full").number(tank.rate.hoursUntil(level, 100.0f), 1);
+        json.key("distance_cm").number(tank.sensor ? tank.sensor->getDistance() : NAN, 1);
+        json.key("alarms").beginObject().key("low").boolean(tank.low_alert.active()).key("high").boolean(tank.high_alert.active()).endObject();
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return sendJson(req, json);
+}
+
+esp_err_t WebServer::apiConfigHandler(httpd_req_t* req) {
+    size_t tank_count = getNumTanks();
+    JsonWriter json(json_buffer, sizeof(json_buffer));
+    json.beginObject();
+    writeDeviceName(json);
+    json.key("units").beginObject().key("distance").string(dist_unit.c_str()).key("volume").string(vol_unit.c_str()).endObject();
+    json.key("interval_ms").number(getTransmissionInterval());
+    json.key("min_interval_ms").number(_nmea2000->getMinTransmissionInterval());
+    json.key("deadband_percent").number(_nmea2000->getLevelDeadband(), 1);
+    json.key("temperature_source").number(getTemperatureSource());
+    json.key("max_tanks").number((uint32_t)MAX_TANKS);
+    if (tanks[0].sensor) {
+        const FilterSettings_t& filter = tanks[0].sensor->getFilterSettings();
+        json.key("filter").beginObject();
+        json.key("median_enabled").boolean(filter.medianEnabled);
+        json.key("median_window").number((uint32_t)filter.medianWindow);
+        json.key("max_median_window").number((uint32_t)MAX_MEDIAN_WINDOW);
+        json.key("kalman_enabled").boolean(filter.kalmanEnabled);
+        json.key("process_noise").number(filter.processNoise, 3);
+        json.key("measurement_noise").number(filter.measurementNoise, 3);
+        json.endObject();
+    }
+    char ssid[33] = "";  // 32 octets max, the password is never read here
+    _config->getString("wifi_config", "ssid", ssid, sizeof(ssid));
+    json.key("wifi_ssid").string(ssid);
+    json.key("tanks").beginArray();
+    for (size_t i = 0; i < tank_count; i++) {
+        TankSettingsRef snapshot = tanks[i].settings();
+        const TankSettings_t& settings = *snapshot;
+        json.beginObject();
+        json.key("instance").number((uint32_t)settings.instance);
+        json.key("fluid").string(fluidTypeName(settings.fluid_type));
+        json.key("shape").string(settings.tank_shape);
+        json.key("shape_ratio").number(settings.shape_ratio, 2);
+        json.key("height_cm").number(settings.tank_height, 1);
+        json.key("capacity_liters").number(settings.tank_volume, 1);
+        json.key("sensor_offset_cm").number(settings.sensor_offset, 1);
+        json.key("sensor_forward_cm").number(settings.sensor_forward, 1);
+        json.key("sensor_starboard_cm").number(settings.sensor_starboard, 1);
+        json.key("average_seconds").number(settings.average_seconds);
+        json.key("low_alarm_percent").number(settings.low_alarm_percent, 1);
+        json.key("high_alarm_percent").number(settings.high_alarm_percent, 1);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return sendJson(req, json);
+}
+
+struct HistoryStream {
+    ChunkedWriter* out;
+    size_t num_tanks;
+    bool binary;
+};
+
+static bool writeHistoryRecord(const HistoryRecord_t& record, void* ctx) {
+    HistoryStream* stream = static_cast<HistoryStream*>(ctx);
+    ChunkedWriter& out = *stream->out;
+    if (stream->binary) {
+        out.write(&record, sizeof(record));
+        return out.ok();
+    }
+    out.printf("%lu,%u,%lu", (unsigned long)record.time, (unsigned)record.boot, (unsigned long)record.uptime);
+    for (size_t i = 0; i < stream->num_tanks; i++) {
+        if (record.level[i] == HISTORY_NO_DATA) {
+            out.print(",");
+        } else {
+            out.printf(",%u.%02u", record.level[i] / 100, record.level[i] % 100);
+        }
+    }
+    out.print("\n");
+    return out.ok();
+}
+
+// Parses a resolution given in seconds, optionally with an s, m or h suffix
+static uint32_t parseResolution(const char* text) {
+    char* end;
+    uint32_t value = strtoul(text, &end, 10);
+    if (*end == 'm') return value * 60;
+    if (*end == 'h') return value * 3600;
+    return value;
+}
+
+// GET /history?from=&to=&res=&format=
+// from and to are inclusive Unix times in seconds, res is 1s, 1m (default)
+// or 1h. Records from before the clock was set have time 0 and are only
+// sent when from is 0; boot and uptime order them. format=bin sends the raw little-endian HistoryRecord_t records
+// instead of CSV. Records are streamed as they are read from flash, so the
+// response length does not depend on free RAM.
+esp_err_t WebServer::historyHandler(httpd_req_t* req) {
+    size_t tank_count = getNumTanks();
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+    uint32_t resolution = 60;
+    bool binary = false;
+    char query[96], param[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "from", param, sizeof(param)) == ESP_OK) from = strtoul(param, NULL, 10);
+        if (httpd_query_key_value(query, "to", param, sizeof(param)) == ESP_OK) to = strtoul(param, NULL, 10);
+        if (httpd_query_key_value(query, "res", param, sizeof(param)) == ESP_OK) resolution = parseResolution(param);
+        if (httpd_query_key_value(query, "format", param, sizeof(param)) == ESP_OK) binary = (strcmp(param, "bin") == 0);
+    }
+    if (resolution != 1 && resolution != 60 && resolution != 3600) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "res must be 1s, 1m or 1h");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, binary ? "application/octet-stream" : "text/csv");
+    ChunkedWriter out(req);
+    if (!binary) {
+        out.print("time,boot,uptime");
+        for (size_t i = 0; i < tank_count; i++) out.printf(",tank%d_percent", (int)i + 1);
+        out.print("\n");
+    }
+    HistoryStream stream = {&out, tank_count, binary};
+    if (_history) _history->forEach(resolution, from, to, writeHistoryRecord, &stream);
+    return out.finish();
+}
+
+// The handshake arrives as a GET; afterwards the handler is called for each
+// frame the client sends, which the page never does beyond control frames.
+esp_err_t WebServer::levelStreamHandler(httpd_req_t* req) {
+    if (req->method == HTTP_GET) {
+        ws_clients.fetch_add(1, std::memory_order_relaxed);
+        ESP_LOGI(TAG, "Level stream client connected");
+        return ESP_OK;
+    }
+
+    uint8_t buf[32];
+    httpd_ws_frame_t frame = {};
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK || frame.len > sizeof(buf)) return ESP_FAIL;
+    frame.payload = buf;
+    return httpd_ws_recv_frame(req, &frame, sizeof(buf));
+}
+
+// Called by ultrasonicTask after every measurement round. Only formats the
+// update; the sockets are written from the httpd task in sendLevelUpdate().
+void WebServer::publishLevels() {
+    if (_server == NULL || ws_clients.load(std::memory_order_relaxed) == 0) return;
+    if (level_update_pending.load(std::memory_order_acquire)) return;
+
+    size_t tank_count = getNumTanks();
+    int len = snprintf(level_update, sizeof(level_update), "{\"t\":[");
+    for (size_t i = 0; i < tank_count && len < (int)sizeof(level_update); i++) {
+        Tank& tank = tanks[i];
+        int alarms = (tank.low_alert.active() ? 1 : 0) | (tank.high_alert.active() ? 2 : 0);
+        float level = tank.getLevelPercentage();
+        if (std::isnan(level)) {  // No reading, JSON has no NaN
+            len += snprintf(level_update + len, sizeof(level_update) - len, "%s[null,null,%d]", i ? "," : "", alarms);
+        } else {
+            len += snprintf(level_update + len, sizeof(level_update) - len, "%s[%.1f,%.1f,%d]", i ? "," : "",
+                            level, tank.getTankVolumeLiters(), alarms);
+        }
+    }
+    if (len < (int)sizeof(level_update)) len += snprintf(level_update + len, sizeof(level_update) - len, "]}");
+    if (len >= (int)sizeof(level_update)) return;
+    level_update_len = len;
+
+    level_update_pending.store(true, std::memory_order_release);
+    if (httpd_queue_work(_server, sendLevelUpdate, this) != ESP_OK) {
+        level_update_pending.store(false, std::memory_order_release);
+    }
+}
+
+void WebServer::sendLevelUpdate(void* arg) {
+    WebServer* self = static_cast<WebServer*>(arg);
+    int fds[8];
+    size_t num_fds = sizeof(fds) / sizeof(fds[0]);
+    uint32_t clients = 0;
+    if (httpd_get_client_list(self->_server, &num_fds, fds) == ESP_OK) {
+        httpd_ws_frame_t frame = {};
+        frame.final = true;
+        frame.type = HTTPD_WS_TYPE_TEXT;
+        frame.payload = reinterpret_cast<uint8_t*>(self->level_update);
+        frame.len = self->level_update_len;
+        for (size_t i = 0; i < num_fds; i++) {
+            if (httpd_ws_get_fd_info(self->_server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) continue;
+            if (httpd_ws_send_frame_async(self->_server, fds[i], &frame) == ESP_OK) clients++;
+        }
+    }
+    self->ws_clients.store(clients, std::memory_order_relaxed);  // Drops clients that went away
+    self->level_update_pending.store(false, std::memory_order_release);
+}
+
 void WebServer::start() {
     ESP_LOGI(TAG, "Starting HTTP server...");
+#if !CONFIG_IDF_TARGET_LINUX
     wifi_mode_t mode;
     esp_err_t wifi_status = esp_wifi_get_mode(&mode);
     if (wifi_status == ESP_OK) {
@@ -559,6 +971,7 @@ void WebServer::start() {
     } else {
         ESP_LOGE(TAG, "Failed to get WiFi mode: %d", wifi_status);
     }
+#endif
 
     esp_err_t err = httpd_start(&_server, &config);
     if (err != ESP_OK) {
@@ -566,32 +979,40 @@ void WebServer::start() {
         return;
     }
 
-    httpd_uri_t root = { .uri = "/", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->rootHandler(r); }, .user_ctx = this };
     httpd_uri_t tank_form = { .uri = "/tank_form", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->tankFormHandler(r); }, .user_ctx = this };
     httpd_uri_t tank = { .uri = "/tank", .method = HTTP_POST, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->tankHandler(r); }, .user_ctx = this };
-    httpd_uri_t config_form = { .uri = "/config_form", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->configFormHandler(r); }, .user_ctx = this };
     httpd_uri_t config = { .uri = "/config", .method = HTTP_POST, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->configHandler(r); }, .user_ctx = this };
     httpd_uri_t wifi_scan = { .uri = "/wifi_scan", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->wifiScanHandler(r); }, .user_ctx = this };
-    httpd_uri_t wifi_form = { .uri = "/wifi_form", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->wifiFormHandler(r); }, .user_ctx = this };
     httpd_uri_t wifi = { .uri = "/wifi", .method = HTTP_POST, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->wifiHandler(r); }, .user_ctx = this };
     httpd_uri_t wifi_reset = { .uri = "/wifi_reset", .method = HTTP_POST, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->wifiResetHandler(r); }, .user_ctx = this };
     httpd_uri_t reboot = { .uri = "/reboot", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->rebootHandler(r); }, .user_ctx = this };
+    httpd_uri_t metrics = { .uri = "/metrics", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->metricsHandler(r); }, .user_ctx = this };
+    httpd_uri_t level_stream = { .uri = "/ws", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->levelStreamHandler(r); }, .user_ctx = this, .is_websocket = true };
+    httpd_uri_t api_status = { .uri = "/api/v1/status", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->apiStatusHandler(r); }, .user_ctx = this };
+    httpd_uri_t api_config = { .uri = "/api/v1/config", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->apiConfigHandler(r); }, .user_ctx = this };
+    httpd_uri_t history = { .uri = "/history", .method = HTTP_GET, .handler = [](httpd_req_t* r) { return static_cast<WebServer*>(r->user_ctx)->historyHandler(r); }, .user_ctx = this };
 
-    httpd_register_uri_handler(_server, &root);
     httpd_register_uri_handler(_server, &tank_form);
     httpd_register_uri_handler(_server, &tank);
-    httpd_register_uri_handler(_server, &config_form);
     httpd_register_uri_handler(_server, &config);
     httpd_register_uri_handler(_server, &wifi_scan);
-    httpd_register_uri_handler(_server, &wifi_form);
     httpd_register_uri_handler(_server, &wifi);
     httpd_register_uri_handler(_server, &wifi_reset);
     httpd_register_uri_handler(_server, &reboot);
+    httpd_register_uri_handler(_server, &metrics);
+    httpd_register_uri_handler(_server, &level_stream);
+    httpd_register_uri_handler(_server, &api_status);
+    httpd_register_uri_handler(_server, &api_config);
+    httpd_register_uri_handler(_server, &history);
+    registerWebAssets(_server);
 
     ESP_LOGI(TAG, "HTTP server started");
 }
 
 void WebServer::startWiFiAP() {
+#if CONFIG_IDF_TARGET_LINUX
+    ESP_LOGI(TAG, "WiFi AP not available on the host build, serving on host network");
+#else
     ESP_LOGI(TAG, "Starting WiFi AP...");
     wifi_config_t wifi_config = {};
     strcpy((char*)wifi_config.ap.ssid, "NMEA2000_Sensor");
@@ -607,9 +1028,12 @@ void WebServer::startWiFiAP() {
     ret = esp_wifi_start();
     if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to start WiFi AP: %d", ret);
     ESP_LOGI(TAG, "WiFi AP started on Channel 11");
+#endif
 }
 
 void WebServer::connectToWiFi(const char* ssid, const char* password) {
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_err_t ret;
     ESP_LOGI(TAG, "Connecting to WiFi STA: SSID=%s, Password=%s", ssid, password);
     wifi_config_t wifi_config = {};
     strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
@@ -621,7 +1045,7 @@ void WebServer::connectToWiFi(const char* ssid, const char* password) {
     wifi_config.sta.pmf_cfg.capable = true;
     wifi_config.sta.pmf_cfg.required = false;
 
-    esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    ret = esp_wifi_set_mode(WIFI_MODE_STA);
     if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to set STA mode: %d", ret);
     ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
     if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to set STA config: %d", ret);
@@ -631,60 +1055,18 @@ void WebServer::connectToWiFi(const char* ssid, const char* password) {
     if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to start WiFi STA: %d", ret);
     ESP_ERROR_CHECK(esp_wifi_set_max_tx_power(80));
     ESP_LOGI(TAG, "WiFi STA started, attempting connection...");
+#endif
 
-    nvs_handle_t nvs;
-    ret = nvs_open("wifi_config", NVS_READWRITE, &nvs);
-    if (ret == ESP_OK) {
-        nvs_set_str(nvs, "ssid", ssid);
-        nvs_set_str(nvs, "password", password);
-        esp_err_t commit_ret = nvs_commit(nvs);
-        if (commit_ret == ESP_OK) {
-            ESP_LOGI(TAG, "WiFi credentials committed to NVS");
-        } else {
-            ESP_LOGE(TAG, "Failed to commit WiFi credentials to NVS: %d", commit_ret);
-        }
-        nvs_close(nvs);
-    } else {
-        ESP_LOGE(TAG, "Failed to open NVS for WiFi config: %d", ret);
-    }
+    _config->setString("wifi_config", "ssid", ssid);
+    _config->setString("wifi_config", "password", password);
 }
 
-float WebServer::getLevelPercentage() {
-    float raw_distance = _sensor->getLevelPercentage();
-    float distance = raw_distance - sensor_offset;
-    if (distance < 0) distance = 0;
-    float height = tank_height - sensor_offset;
-    if (height <= 0) return 100.0;
-
-    if (tank_shape == "rectangular" || tank_shape == "cylindrical standing") {
-        return 100.0 * (1.0 - distance / height);
-    } else if (tank_shape == "cylindrical laying flat") {
-        float h = distance / height;
-        float volume_percent = std::acos(1 - 2 * h) / M_PI + (2 * h - 1) * std::sqrt(2 * h - h * h) / M_PI;
-        return 100.0 * (1.0 - volume_percent);
-    } else if (tank_shape == "custom") {
-        std::vector<CalibrationPoint> calibration;
-        loadCalibrationFromNVS(calibration);
-        if (calibration.empty()) return 0.0;
-        if (distance <= calibration.front().distance) return calibration.front().percentage;
-        if (distance >= calibration.back().distance) return calibration.back().percentage;
-
-        for (size_t i = 0; i < calibration.size() - 1; i++) {
-            if (distance >= calibration[i].distance && distance <= calibration[i + 1].distance) {
-                float d1 = calibration[i].distance;
-                float p1 = calibration[i].percentage;
-                float d2 = calibration[i + 1].distance;
-                float p2 = calibration[i + 1].percentage;
-                return p1 + (distance - d1) * (p2 - p1) / (d2 - d1);
-            }
-        }
-    }
-    return 0.0;
+float WebServer::getLevelPercentage(size_t tank) {
+    return tanks[tank].getLevelPercentage();
 }
 
-float WebServer::getTankVolumeLiters() {
-    float percent = getLevelPercentage() / 100.0;
-    return tank_volume * percent;
+float WebServer::getTankVolumeLiters(size_t tank) {
+    return tanks[tank].getTankVolumeLiters();
 }
 
 uint32_t WebServer::getTransmissionInterval() {
@@ -705,83 +1087,46 @@ void WebServer::setDeviceName(const std::string& name) {
     _nmea2000->setDeviceName(name);
 }
 
-void WebServer::updateCalibration(const std::vector<CalibrationPoint>& calibration) {
-    _sensor->loadCalibrationFromNVS(calibration);
-}
-
-void WebServer::checkAndSendAlarms() {
-    float volume_liters = getTankVolumeLiters();
-    float low_alarm_liters = getLowAlarmVolume();
-    float high_alarm_liters = getHighAlarmVolume();
-    static bool low_alarm_active = false;
-    static bool high_alarm_active = false;
-
-    if (volume_liters <= low_alarm_liters && !low_alarm_active) {
-        ESP_LOGI(TAG, "Low fluid level alarm triggered: %.1f liters", volume_liters);
-        low_alarm_active = true;
-    } else if (volume_liters > low_alarm_liters && low_alarm_active) {
-        low_alarm_active = false;
-    }
-
-    if (volume_liters >= high_alarm_liters && !high_alarm_active) {
-        ESP_LOGI(TAG, "High fluid level alarm triggered: %.1f liters", volume_liters);
-        high_alarm_active = true;
-    } else if (volume_liters < high_alarm_liters && high_alarm_active) {
-        high_alarm_active = false;
+void WebServer::configureFilters(const FilterSettings_t& settings) {
+    for (Tank& tank : tanks) {
+        if (tank.sensor) tank.sensor->configureFilter(settings);
     }
 }
 
-void WebServer::saveCalibrationToNVS(const std::vector<CalibrationPoint>& calibration) {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("calibration", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for calibration: %d", ret);
-        return;
+size_t WebServer::tankIndexFromQuery(httpd_req_t* req) {
+    char query[32], param[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "tank", param, sizeof(param)) == ESP_OK) {
+        size_t tank = strtoul(param, NULL, 10);
+        if (tank < MAX_TANKS) return tank;
     }
+    return 0;
+}
 
-    // Save the number of calibration points
-    nvs_set_u8(nvs, "num_points", static_cast<uint8_t>(calibration.size()));
+std::string WebServer::tankNvsKey(const char* key, size_t tank) {
+    // Tank 1 keeps the original key names so existing settings carry over
+    return tank == 0 ? std::string(key) : std::string(key) + std::to_string(tank);
+}
 
-    // Save the calibration points as a blob
+void WebServer::saveCalibrationToNVS(const std::vector<CalibrationPoint>& calibration, size_t tank) {
     std::vector<float> blob(calibration.size() * 2);
     for (size_t i = 0; i < calibration.size(); i++) {
         blob[i * 2] = calibration[i].distance;
         blob[i * 2 + 1] = calibration[i].percentage;
     }
-    nvs_set_blob(nvs, "points", blob.data(), blob.size() * sizeof(float));
-
-    // Commit the changes
-    esp_err_t commit_ret = nvs_commit(nvs);
-    if (commit_ret == ESP_OK) {
-        ESP_LOGI(TAG, "Calibration committed to NVS, points: %d", calibration.size());
-    } else {
-        ESP_LOGE(TAG, "Failed to commit calibration to NVS: %d", commit_ret);
-    }
-    nvs_close(nvs);
+    _config->setU8("calibration", tankNvsKey("num_points", tank).c_str(), static_cast<uint8_t>(calibration.size()));
+    _config->setBlob("calibration", tankNvsKey("points", tank).c_str(), blob.data(), blob.size() * sizeof(float));
 }
 
-void WebServer::loadCalibrationFromNVS(std::vector<CalibrationPoint>& calibration) {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("calibration", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for calibration: %d", ret);
-        return;
-    }
-
-    // Get the number of calibration points
+void WebServer::loadCalibrationFromNVS(std::vector<CalibrationPoint>& calibration, size_t tank) {
     uint8_t num_points = 0;
-    ret = nvs_get_u8(nvs, "num_points", &num_points);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get number of calibration points: %d", ret);
-        nvs_close(nvs);
+    if (!_config->getU8("calibration", tankNvsKey("num_points", tank).c_str(), num_points)) {
+        ESP_LOGW(TAG, "No calibration points stored for tank %d", (int)tank + 1);
         return;
     }
 
-    // Load the calibration points as a blob
-    size_t blob_size = num_points * 2 * sizeof(float);
     std::vector<float> blob(num_points * 2);
-    ret = nvs_get_blob(nvs, "points", blob.data(), &blob_size);
-    if (ret == ESP_OK && blob_size == num_points * 2 * sizeof(float)) {
+    if (_config->getBlob("calibration", tankNvsKey("points", tank).c_str(), blob.data(), blob.size() * sizeof(float))) {
         calibration.clear();
         for (uint8_t i = 0; i < num_points; i++) {
             CalibrationPoint point;
@@ -789,140 +1134,139 @@ void WebServer::loadCalibrationFromNVS(std::vector<CalibrationPoint>& calibratio
             point.percentage = blob[i * 2 + 1];
             calibration.push_back(point);
         }
-        ESP_LOGI(TAG, "Loaded %d calibration points from NVS", num_points);
+        ESP_LOGI(TAG, "Loaded %d calibration points for tank %d from NVS", num_points, (int)tank + 1);
     } else {
-        ESP_LOGE(TAG, "Failed to load calibration points from NVS: %d", ret);
+        ESP_LOGE(TAG, "Failed to load calibration points for tank %d from NVS", (int)tank + 1);
     }
-    nvs_close(nvs);
 }
 
 void WebServer::loadWiFiConfig(std::string& ssid, std::string& password) {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("wifi_config", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for WiFi config: %d", ret);
-        return;
-    }
-
-    char ssid_buf[33] = {0}, pwd_buf[65] = {0};
-    size_t len = sizeof(ssid_buf);
-    ret = nvs_get_str(nvs, "ssid", ssid_buf, &len);
-    if (ret == ESP_OK) {
-        ssid = ssid_buf;
+    if (_config->getString("wifi_config", "ssid", ssid)) {
         ESP_LOGI(TAG, "Loaded WiFi SSID: %s", ssid.c_str());
     } else {
-        ESP_LOGW(TAG, "No WiFi SSID found in NVS: %d", ret);
+        ESP_LOGW(TAG, "No WiFi SSID found in NVS");
     }
-    len = sizeof(pwd_buf);
-    ret = nvs_get_str(nvs, "password", pwd_buf, &len);
-    if (ret == ESP_OK) {
-        password = pwd_buf;
+    if (_config->getString("wifi_config", "password", password)) {
         ESP_LOGI(TAG, "Loaded WiFi password");
     } else {
-        ESP_LOGW(TAG, "No WiFi password found in NVS: %d", ret);
+        ESP_LOGW(TAG, "No WiFi password found in NVS");
     }
-    nvs_close(nvs);
 }
 
 void WebServer::saveSettingsToNVS() {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("n2k_config", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for settings: %d", ret);
-        return;
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        TankSettingsRef snapshot = tanks[i].settings();
+        const TankSettings_t& tank = *snapshot;
+        DeviceSettings_t settings = {};  // Zeroed so unchanged settings compare equal
+        strncpy(settings.deviceName, getDeviceName().c_str(), sizeof(settings.deviceName) - 1);
+        settings.deviceName[sizeof(settings.deviceName) - 1] = '\0';
+        settings.tankHeight = tank.tank_height;
+        settings.tankVolume = tank.tank_volume;
+        settings.sensorOffset = tank.sensor_offset;
+        settings.lowAlarmPercent = tank.low_alarm_percent;
+        settings.highAlarmPercent = tank.high_alarm_percent;
+        strncpy(settings.tankShape, tank.tank_shape, sizeof(settings.tankShape) - 1);
+        settings.tankShape[sizeof(settings.tankShape) - 1] = '\0';
+        strncpy(settings.distUnit, dist_unit.c_str(), sizeof(settings.distUnit) - 1);
+        settings.distUnit[sizeof(settings.distUnit) - 1] = '\0';
+        strncpy(settings.volUnit, vol_unit.c_str(), sizeof(settings.volUnit) - 1);
+        settings.volUnit[sizeof(settings.volUnit) - 1] = '\0';
+        settings.interval = getTransmissionInterval();
+
+        TankChannel_t channel = {};
+        channel.instance = tank.instance;
+        channel.fluidType = tank.fluid_type;
+
+        _config->setBlob("n2k_config", tankNvsKey("settings", i).c_str(), &settings, sizeof(DeviceSettings_t));
+        _config->setBlob("n2k_config", tankNvsKey("channel", i).c_str(), &channel, sizeof(TankChannel_t));
+        _config->setU32("n2k_config", tankNvsKey("shape_ratio", i).c_str(), (uint32_t)(tank.shape_ratio * 1000.0 + 0.5));
+
+        TankMounting_t mounting = {};
+        mounting.sensorForward = tank.sensor_forward;
+        mounting.sensorStarboard = tank.sensor_starboard;
+        mounting.averageSeconds = tank.average_seconds;
+        _config->setBlob("n2k_config", tankNvsKey("mounting", i).c_str(), &mounting, sizeof(TankMounting_t));
     }
+}
 
-    DeviceSettings_t settings;
-    strncpy(settings.deviceName, getDeviceName().c_str(), sizeof(settings.deviceName) - 1);
-    settings.deviceName[sizeof(settings.deviceName) - 1] = '\0';
-    settings.tankHeight = tank_height;
-    settings.tankVolume = tank_volume;
-    settings.sensorOffset = sensor_offset;
-    settings.lowAlarmPercent = low_alarm_percent;
-    settings.highAlarmPercent = high_alarm_percent;
-    strncpy(settings.tankShape, tank_shape.c_str(), sizeof(settings.tankShape) - 1);
-    settings.tankShape[sizeof(settings.tankShape) - 1] = '\0';
-    strncpy(settings.distUnit, dist_unit.c_str(), sizeof(settings.distUnit) - 1);
-    settings.distUnit[sizeof(settings.distUnit) - 1] = '\0';
-    strncpy(settings.volUnit, vol_unit.c_str(), sizeof(settings.volUnit) - 1);
-    settings.volUnit[sizeof(settings.volUnit) - 1] = '\0';
-    settings.interval = getTransmissionInterval();
-
-    ret = nvs_set_blob(nvs, "settings", &settings, sizeof(DeviceSettings_t));
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set settings blob: %d", ret);
-        nvs_close(nvs);
-        return;
-    }
+void WebServer::loadSettingFromNVS() {
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        TankSettings_t& tank = tanks[i].beginUpdate();  // Built in place, too big for the main task's stack
+        DeviceSettings_t settings;
+        if (_config->getBlob("n2k_config", tankNvsKey("settings", i).c_str(), &settings, sizeof(DeviceSettings_t))) {
+            tank.tank_height = settings.tankHeight;
+            tank.tank_volume = settings.tankVolume;
+            tank.sensor_offset = settings.sensorOffset;
+            tank.low_alarm_percent = settings.lowAlarmPercent;
+            tank.high_alarm_percent = settings.highAlarmPercent;
+            strncpy(tank.tank_shape, settings.tankShape, sizeof(tank.tank_shape) - 1);
+            tank.tank_shape[sizeof(tank.tank_shape) - 1] = '\0';
+            if (i == 0) {
+                setDeviceName(settings.deviceName);
+                dist_unit = settings.distUnit;
+                vol_unit = settings.volUnit;
+                setTransmissionInterval(settings.interval);
+            }
+            ESP_LOGI(TAG, "Settings for tank %d loaded from NVS", (int)i + 1);
+        } else {
+            ESP_LOGW(TAG, "No settings for tank %d found in NVS or invalid size, using defaults", (int)i + 1);
+        }
 
-    esp_err_t commit_ret = nvs_commit(nvs);
-    if (commit_ret == ESP_OK) {
-        ESP_LOGI(TAG, "Settings committed to NVS");
-    } else {
-        ESP_LOGE(TAG, "Failed to commit settings to NVS: %d", commit_ret);
+        TankChannel_t channel;
+        if (_config->getBlob("n2k_config", tankNvsKey("channel", i).c_str(), &channel, sizeof(TankChannel_t))) {
+            tank.instance = channel.instance;
+            tank.fluid_type = static_cast<tN2kFluidType>(channel.fluidType);
+        }
+
+        TankMounting_t mounting;
+        if (_config->getBlob("n2k_config", tankNvsKey("mounting", i).c_str(), &mounting, sizeof(TankMounting_t))) {
+            tank.sensor_forward = mounting.sensorForward;
+            tank.sensor_starboard = mounting.sensorStarboard;
+            tank.average_seconds = mounting.averageSeconds;
+        }
+
+        uint32_t ratio_thousandths;
+        if (_config->getU32("n2k_config", tankNvsKey("shape_ratio", i).c_str(), ratio_thousandths)) {
+            tank.shape_ratio = ratio_thousandths / 1000.0;  // 0.001 steps
+        }
+        tank.buildGeometry();
+
+        std::vector<CalibrationPoint> calibration;
+        loadCalibrationFromNVS(calibration, i);
+        tank.custom_transfer.build(calibration);
+        tanks[i].commitUpdate();
+    }
+    uint32_t source = getTemperatureSource();
+    _config->getU32("n2k_config", "temp_source", source);
+    temperature_source.store(source, std::memory_order_relaxed);
+    uint32_t stored_tanks = getNumTanks();
+    _config->getU32("n2k_config", "num_tanks", stored_tanks);
+    num_tanks.store(std::min(std::max(stored_tanks, (uint32_t)1), (uint32_t)MAX_TANKS), std::memory_order_relaxed);
+
+    FilterSettings_t filter;
+    if (loadFilterSettingsFromNVS(filter)) {
+        configureFilters(filter);
     }
-    nvs_close(nvs);
 }
 
-void WebServer::loadSettingFromNVS() {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("n2k_config", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for settings: %d", ret);
-        return;
-    }
+void WebServer::saveFilterSettingsToNVS(const FilterSettings_t& settings) {
+    _config->setBlob("n2k_config", "filter", &settings, sizeof(FilterSettings_t));
+}
 
-    DeviceSettings_t settings;
-    size_t size = sizeof(DeviceSettings_t);
-    ret = nvs_get_blob(nvs, "settings", &settings, &size);
-    if (ret == ESP_OK && size == sizeof(DeviceSettings_t)) {
-        setDeviceName(settings.deviceName);
-        tank_height = settings.tankHeight;
-        tank_volume = settings.tankVolume;
-        sensor_offset = settings.sensorOffset;
-        low_alarm_percent = settings.lowAlarmPercent;
-        high_alarm_percent = settings.highAlarmPercent;
-        tank_shape = settings.tankShape;
-        dist_unit = settings.distUnit;
-        vol_unit = settings.volUnit;
-        setTransmissionInterval(settings.interval);
-        ESP_LOGI(TAG, "Settings loaded from NVS");
-    } else {
-        ESP_LOGW(TAG, "No settings found in NVS or invalid size, using defaults: %d", ret);
+bool WebServer::loadFilterSettingsFromNVS(FilterSettings_t& settings) {
+    if (!_config->getBlob("n2k_config", "filter", &settings, sizeof(FilterSettings_t))) {
+        ESP_LOGW(TAG, "No filter settings found in NVS, using defaults");
+        return false;
     }
-    nvs_close(nvs);
+    ESP_LOGI(TAG, "Filter settings loaded from NVS");
+    return true;
 }
 
 template<typename T>
 void WebServer::saveToNVM(const char* key, T value) {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("n2k_config", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for key '%s': %d", key, ret);
-        return;
-    }
-
     if constexpr (std::is_same<T, uint32_t>::value) {
-        ret = nvs_set_u32(nvs, key, value);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set uint32 '%s' = %u: %d", key, value, ret);
-        } else {
-            ESP_LOGI(TAG, "Saved uint32 '%s' = %u to NVS", key, value);
-        }
+        _config->setU32("n2k_config", key, value);
     } else if constexpr (std::is_same<T, std::string>::value) {
-        ret = nvs_set_str(nvs, key, value.c_str());
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set string '%s' = '%s': %d", key, value.c_str(), ret);
-        } else {
-            ESP_LOGI(TAG, "Saved string '%s' = '%s' to NVS", key, value.c_str());
-        }
-    }
-
-    esp_err_t commit_ret = nvs_commit(nvs);
-    if (commit_ret == ESP_OK) {
-        ESP_LOGI(TAG, "NVS commit successful for key '%s'", key);
-    } else {
-        ESP_LOGE(TAG, "Failed to commit NVS for key '%s': %d", key, commit_ret);
+        _config->setString("n2k_config", key, value);
     }
-    nvs_close(nvs);
-}
\ No newline at end of file
+}
@@ -1,65 +1,78 @@
 #ifndef WEB_SERVER_H
 #define WEB_SERVER_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include "n2k_can_driver.h"
 #include "calibration.h"
+#include "config_store.h"
+#include "distance_filter.h"
+#include "history.h"
+#include "json_writer.h"
+#include "tank.h"
 #include <esp_http_server.h>
 
 class Ultrasonic;
 
+#define TEMPERATURE_SOURCE_NONE 0xFF
+
 class WebServer {
 public:
-    WebServer(N2kCanDriver* nmea2000, Ultrasonic* sensor);
+    WebServer(N2kCanDriver* nmea2000, ConfigStore* config_store, LevelHistory* history, Ultrasonic* sensors, size_t num_sensors);
     ~WebServer();
 
     void start();
     void startWiFiAP();
     void connectToWiFi(const char* ssid, const char* password);
-    float getLevelPercentage();
-    float getTankVolumeLiters();
+    float getLevelPercentage(size_t tank = 0);
+    float getTankVolumeLiters(size_t tank = 0);
+    size_t getNumTanks() { return num_tanks.load(std::memory_order_relaxed); }
+    Tank& getTank(size_t tank) { return tanks[tank]; }
     uint32_t getTransmissionInterval();
     std::string getDeviceName();
     std::string getVolUnit() { return vol_unit; }
+    uint32_t getTemperatureSource() { return temperature_source.load(std::memory_order_relaxed); }
     void setTransmissionInterval(uint32_t interval);
     void setDeviceName(const std::string& name);
-    void updateCalibration(const std::vector<CalibrationPoint>& calibration);
-    void checkAndSendAlarms();
-    void saveCalibrationToNVS(const std::vector<CalibrationPoint>& calibration);
-    void loadCalibrationFromNVS(std::vector<CalibrationPoint>& calibration);
+    void saveCalibrationToNVS(const std::vector<CalibrationPoint>& calibration, size_t tank = 0);
+    void loadCalibrationFromNVS(std::vector<CalibrationPoint>& calibration, size_t tank = 0);
     void loadWiFiConfig(std::string& ssid, std::string& password);
     void saveSettingsToNVS();
     void loadSettingFromNVS();
+    void saveFilterSettingsToNVS(const FilterSettings_t& settings);
+    bool loadFilterSettingsFromNVS(FilterSettings_t& settings);
 
-    float getLowAlarmVolume() { return tank_volume * low_alarm_percent / 100.0; }
-    float getHighAlarmVolume() { return tank_volume * high_alarm_percent / 100.0; }
+    float getLowAlarmVolume(size_t tank = 0) { return tanks[tank].settings()->getLowAlarmVolume(); }
+    float getHighAlarmVolume(size_t tank = 0) { return tanks[tank].settings()->getHighAlarmVolume(); }
 
-    esp_err_t rootHandler(httpd_req_t* req);
     esp_err_t tankFormHandler(httpd_req_t* req);
     esp_err_t tankHandler(httpd_req_t* req);
-    esp_err_t configFormHandler(httpd_req_t* req);
     esp_err_t configHandler(httpd_req_t* req);
     esp_err_t wifiScanHandler(httpd_req_t* req);
-    esp_err_t wifiFormHandler(httpd_req_t* req);
     esp_err_t wifiHandler(httpd_req_t* req);
     esp_err_t wifiResetHandler(httpd_req_t* req);
     esp_err_t rebootHandler(httpd_req_t* req);
+    esp_err_t metricsHandler(httpd_req_t* req);
+    esp_err_t levelStreamHandler(httpd_req_t* req);
+    esp_err_t apiStatusHandler(httpd_req_t* req);
+    esp_err_t apiConfigHandler(httpd_req_t* req);
+    esp_err_t historyHandler(httpd_req_t* req);
+    void publishLevels();  // Pushes the current levels to every /ws client
 
 private:
     N2kCanDriver* _nmea2000;
-    Ultrasonic* _sensor;
+    ConfigStore* _config;
+    LevelHistory* _history;
     httpd_handle_t _server;
     httpd_config_t config;
 
-    float tank_height = 100.0;
-    float tank_volume = 100.0;
-    float sensor_offset = 0.0;
-    float low_alarm_percent = 10.0;
-    float high_alarm_percent = 90.0;
-    std::string tank_shape = "rectangular";
+    Tank tanks[MAX_TANKS];
+    // Written by the /config handler, read on nmea_task and ultrasonic_task
+    std::atomic<uint32_t> num_tanks{1};
     std::string dist_unit = "cm";
     std::string vol_unit = "liter";
+    std::atomic<uint32_t> temperature_source{TEMPERATURE_SOURCE_NONE};  // tN2kTempSource used for speed-of-sound compensation
 
     struct DeviceSettings_t {
         char deviceName[32];
@@ -74,6 +87,35 @@ private:
         uint32_t interval;        // ms
     };
 
+    struct TankChannel_t {
+        uint8_t instance;
+        uint8_t fluidType;        // tN2kFluidType
+    };
+
+    struct TankMounting_t {
+        float sensorForward;      // cm
+        float sensorStarboard;    // cm
+        uint32_t averageSeconds;
+    };
+
+    // Live level stream: publishLevels() fills level_update and hands it to
+    // the httpd task, which sends it to every WebSocket client. While one
+    // update is in flight newer ones are skipped rather than queued.
+    char level_update[160];
+    size_t level_update_len = 0;
+    std::atomic<bool> level_update_pending{false};
+    std::atomic<uint32_t> ws_clients{0};
+    static void sendLevelUpdate(void* arg);
+
+    // Only touched from httpd handlers, which all run on the server task
+    char json_buffer[2048];
+    esp_err_t sendJson(httpd_req_t* req, const JsonWriter& json);
+    void writeDeviceName(JsonWriter& json);
+
+    void configureFilters(const FilterSettings_t& settings);
+    size_t tankIndexFromQuery(httpd_req_t* req);
+    std::string tankNvsKey(const char* key, size_t tank);
+
     template<typename T>
     void saveToNVM(const char* key, T value);
 };
@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stdint.h>
+#include <benchmark/benchmark.h>
+
+// Heap allocations made through operator new since the program started
+uint64_t alloc_count();
+
+// Reports the allocations made while it lives as an allocs/op counter.
+// Put one in front of the benchmark loop.
+class AllocsPerOp {
+public:
+    explicit AllocsPerOp(benchmark::State& state) : state(state), start(alloc_count()) {}
+    ~AllocsPerOp() {
+        state.counters["allocs/op"] = benchmark::Counter((double)(alloc_count() - start), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& state;
+    uint64_t start;
+};
+
+#endif
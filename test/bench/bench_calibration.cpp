@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "alloc_counter.h"
+#include "calibration.h"
+#include "geometry.h"
+
+// Calibration table of a 100 cm horizontal cylinder, sensor on top:
+// distance 0 is full, 100 is empty
+static std::vector<CalibrationPoint> cylinderTable(int points) {
+    const TankShapeModel* model = findTankShape("cylindrical laying flat");
+    std::vector<CalibrationPoint> table;
+    for (int i = 0; i < points; i++) {
+        double distance = 100.0 * i / (points - 1);
+        table.push_back({(float)distance, (float)(100.0 * model->fill(1.0 - distance / 100.0, model->defaultRatio))});
+    }
+    return table;
+}
+
+// Distances spread over the whole table so every segment gets searched
+static std::vector<float> sweep() {
+    std::vector<float> distances;
+    for (int i = 0; i < 256; i++) distances.push_back((i * 37 % 256) * 100.0f / 255.0f);
+    return distances;
+}
+
+static void BM_LevelTransferFunction_evaluate(benchmark::State& state) {
+    LevelTransferFunction transfer;
+    transfer.build(cylinderTable(state.range(0)));
+    std::vector<float> distances = sweep();
+    size_t i = 0;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(transfer.evaluate(distances[i++ & 255]));
+    }
+}
+BENCHMARK(BM_LevelTransferFunction_evaluate)->Arg(3)->Arg(8)->Arg(64)->Unit(benchmark::kNanosecond);
+
+// Piecewise linear interpolation with a linear scan, the reference the PCHIP
+// evaluate is compared against
+static float linear(const std::vector<CalibrationPoint>& table, float distance) {
+    if (distance <= table.front().distance) return table.front().percentage;
+    if (distance >= table.back().distance) return table.back().percentage;
+    size_t i = 0;
+    while (distance > table[i + 1].distance) i++;
+    const CalibrationPoint& a = table[i];
+    const CalibrationPoint& b = table[i + 1];
+    return a.percentage + (b.percentage - a.percentage) * (distance - a.distance) / (b.distance - a.distance);
+}
+
+static void BM_LinearInterpolation(benchmark::State& state) {
+    std::vector<CalibrationPoint> table = cylinderTable(state.range(0));
+    std::vector<float> distances = sweep();
+    size_t i = 0;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(linear(table, distances[i++ & 255]));
+    }
+}
+BENCHMARK(BM_LinearInterpolation)->Arg(3)->Arg(8)->Arg(64)->Unit(benchmark::kNanosecond);
+
+static void BM_LevelTransferFunction_build(benchmark::State& state) {
+    std::vector<CalibrationPoint> table = cylinderTable(state.range(0));
+    LevelTransferFunction transfer;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        transfer.build(table);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_LevelTransferFunction_build)->Arg(3)->Arg(8)->Arg(64)->Unit(benchmark::kNanosecond);
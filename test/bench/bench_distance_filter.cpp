@@ -0,0 +1,36 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "alloc_counter.h"
+#include "distance_filter.h"
+
+// Per-sample cost of each filter stage on ultrasonic_task. Input is a
+// slowly falling level with echo noise and an occasional spike.
+static void BM_DistanceFilter_update(benchmark::State& state) {
+    FilterSettings_t settings = DistanceFilter::defaultSettings();
+    settings.medianEnabled = state.range(0) > 0;
+    settings.medianWindow = state.range(0) > 0 ? state.range(0) : 5;
+    settings.kalmanEnabled = state.range(1);
+    DistanceFilter filter;
+    filter.configure(settings);
+
+    std::vector<float> samples;
+    for (int i = 0; i < 1024; i++) {
+        float noise = ((i * 7919) % 101 - 50) / 100.0f;
+        samples.push_back(i % 97 == 0 ? 350.0f : 40.0f + i * 0.01f + noise);
+    }
+    size_t i = 0;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(filter.update(samples[i++ & 1023]));
+    }
+}
+// {median window or 0 for off, Kalman on}
+BENCHMARK(BM_DistanceFilter_update)
+    ->ArgNames({"median", "kalman"})
+    ->Args({0, 0})
+    ->Args({5, 0})
+    ->Args({MAX_MEDIAN_WINDOW, 0})
+    ->Args({0, 1})
+    ->Args({5, 1})
+    ->Args({MAX_MEDIAN_WINDOW, 1})
+    ->Unit(benchmark::kNanosecond);
@@ -0,0 +1,16 @@
+#include <benchmark/benchmark.h>
+#include "alloc_counter.h"
+#include "N2kMessages.h"
+
+// PGN 127505 assembly as nmea_task does it for every level it sends
+static void BM_SetN2kFluidLevel(benchmark::State& state) {
+    double level = 0.0;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        tN2kMsg msg;
+        SetN2kFluidLevel(msg, 1, N2kft_Fuel, level / 100.0, 300.0 * level / 100.0);
+        benchmark::DoNotOptimize(msg.Data);
+        level = level < 100.0 ? level + 0.7 : 0.0;
+    }
+}
+BENCHMARK(BM_SetN2kFluidLevel)->Unit(benchmark::kNanosecond);
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <string.h>
+#include "alloc_counter.h"
+#include "geometry.h"
+#include "tank.h"
+#include "ultrasonic.h"
+
+// The level nmea_task computes for every tank on every pass, for each shape
+// model and the 8-point custom table
+static void BM_Tank_getLevelPercentage(benchmark::State& state, const char* shape) {
+    Ultrasonic sensor;
+    sensor.setDistance(37.0f);
+    Tank tank;
+    tank.sensor = &sensor;
+    TankSettings_t& settings = tank.beginUpdate();
+    strncpy(settings.tank_shape, shape, sizeof(settings.tank_shape) - 1);
+    settings.tank_height = 100.0f;
+    settings.sensor_offset = 5.0f;
+    settings.buildGeometry();
+    settings.custom_transfer.build({{5, 100}, {18, 88}, {31, 71}, {44, 55}, {57, 39}, {70, 24}, {83, 10}, {100, 0}});
+    tank.commitUpdate();
+
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tank.getLevelPercentage());
+    }
+}
+
+static bool registered = [] {
+    for (size_t i = 0; i < tank_shape_model_count; i++) {
+        std::string name = std::string("BM_Tank_getLevelPercentage/") + tank_shape_models[i].name;
+        benchmark::RegisterBenchmark(name.c_str(), BM_Tank_getLevelPercentage, tank_shape_models[i].name)->Unit(benchmark::kNanosecond);
+    }
+    benchmark::RegisterBenchmark("BM_Tank_getLevelPercentage/custom", BM_Tank_getLevelPercentage, "custom")->Unit(benchmark::kNanosecond);
+    return true;
+}();
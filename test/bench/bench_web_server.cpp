@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include <nvs_flash.h>
+#include <memory>
+#include "alloc_counter.h"
+#include "fake_can_transport.h"
+#include "fake_httpd.h"
+#include "json_writer.h"
+#include "ultrasonic.h"
+#include "web_server.h"
+
+float parseFloat(const char* value, float default_value);
+
+static void BM_parseFloat(benchmark::State& state) {
+    const char* inputs[] = {"42", "123.45", "12,5", "-0.75"};
+    size_t i = 0;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseFloat(inputs[i++ & 3], 0.0f));
+    }
+}
+BENCHMARK(BM_parseFloat)->Unit(benchmark::kNanosecond);
+
+// Number formatting of the JSON API, one value with one decimal
+static void BM_JsonWriter_number(benchmark::State& state) {
+    char buffer[64];
+    float value = 0.0f;
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginArray().number(value, 1).endArray();
+        benchmark::DoNotOptimize(buffer);
+        value += 0.37f;
+    }
+}
+BENCHMARK(BM_JsonWriter_number)->Unit(benchmark::kNanosecond);
+
+// GET /tank_form with an 8-point calibration table, streamed in chunks
+static void BM_WebServer_tankForm(benchmark::State& state) {
+    fake_nvs_reset();
+    ConfigStore config;
+    FakeCanTransport transport;
+    N2kCanDriver driver(&transport, &config);
+    Ultrasonic sensors[MAX_TANKS];
+    std::unique_ptr<WebServer> web(new WebServer(&driver, &config, nullptr, sensors, MAX_TANKS));
+    web->saveCalibrationToNVS({{0, 100}, {13, 88}, {26, 71}, {39, 55}, {52, 39}, {65, 24}, {78, 10}, {100, 0}});
+
+    FakeHttpRequest request(HTTP_GET, "/tank_form");
+    web->tankFormHandler(&request.req);  // Sizes the response buffer
+    size_t page_bytes = request.response.size();
+
+    AllocsPerOp allocs(state);
+    for (auto _ : state) {
+        request.response.clear();
+        request.chunks = 0;
+        request.complete = false;
+        web->tankFormHandler(&request.req);
+    }
+    state.SetBytesProcessed(state.iterations() * page_bytes);
+}
+BENCHMARK(BM_WebServer_tankForm)->Unit(benchmark::kNanosecond);
@@ -0,0 +1,7 @@
+#ifndef ESP_INTR_ALLOC_H
+#define ESP_INTR_ALLOC_H
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+#endif
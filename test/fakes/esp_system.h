@@ -0,0 +1,14 @@
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Returns on the host; fake_restart_count() tells a test it was called
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+uint32_t fake_restart_count(void);
+
+#endif
@@ -0,0 +1,30 @@
+#include "fake_can_transport.h"
+#include <string.h>
+
+bool FakeCanTransport::sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) {
+    if (!isOpen || !acceptFrames) return false;
+    CanFrame frame = {};
+    frame.id = id;
+    frame.len = len;
+    memcpy(frame.data, buf, len);
+    sent.push_back(frame);
+    return true;
+}
+
+bool FakeCanTransport::getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) {
+    if (received.empty()) return false;
+    const CanFrame& frame = received.front();
+    id = frame.id;
+    len = frame.len;
+    memcpy(buf, frame.data, frame.len);
+    received.pop_front();
+    return true;
+}
+
+void FakeCanTransport::receive(unsigned long id, unsigned char len, const unsigned char* buf) {
+    CanFrame frame = {};
+    frame.id = id;
+    frame.len = len;
+    memcpy(frame.data, buf, len);
+    received.push_back(frame);
+}
@@ -0,0 +1,32 @@
+#ifndef FAKE_CAN_TRANSPORT_H
+#define FAKE_CAN_TRANSPORT_H
+
+#include <deque>
+#include <vector>
+#include "can_transport.h"
+#include "can_tx_queue.h"
+
+// CanTransport that records what is sent and hands out queued frames.
+// acceptFrames = false makes sendFrame() refuse like a busy controller.
+class FakeCanTransport : public CanTransport {
+public:
+    void setReceiveFilter(const std::vector<unsigned long>& pgns) override { filterPgns = pgns; }
+    bool open() override { isOpen = openResult; return openResult; }
+    void close() override { isOpen = false; }
+    bool sendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool wait_sent) override;
+    bool getFrame(unsigned long& id, unsigned char& len, unsigned char* buf) override;
+    bool waitForFrame(uint32_t timeout_ms) override { return !received.empty(); }
+    uint32_t getBusOffCount() const override { return busOffCount; }
+
+    void receive(unsigned long id, unsigned char len, const unsigned char* buf);
+
+    bool openResult = true;
+    bool isOpen = false;
+    bool acceptFrames = true;
+    uint32_t busOffCount = 0;
+    std::vector<unsigned long> filterPgns;
+    std::vector<CanFrame> sent;
+    std::deque<CanFrame> received;
+};
+
+#endif
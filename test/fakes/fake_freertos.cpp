@@ -0,0 +1,202 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "fake_freertos.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+struct FakeTask {
+    std::string name;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+    std::atomic<bool> deleted{false};
+};
+
+struct FakeQueue {
+    size_t length;
+    size_t itemSize;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+// Thrown into a task blocked in a FreeRTOS call once it has been deleted,
+// unwinding it back to its thread function
+struct TaskDeleted {};
+
+thread_local FakeTask* current_task = nullptr;
+std::atomic<size_t> live_tasks{0};
+const auto start_time = std::chrono::steady_clock::now();
+
+FakeTask* currentTask() {
+    if (!current_task) {  // A thread the test started itself
+        current_task = new FakeTask;
+        current_task->name = "main";
+    }
+    return current_task;
+}
+
+// Waits on cv with its mutex held until ready() or the timeout. Checks for
+// deletion of the calling task on every wakeup.
+template<typename Lock, typename Ready>
+bool waitFor(std::condition_variable& cv, Lock& lock, TickType_t ticks, Ready ready) {
+    FakeTask* self = currentTask();
+    auto check = [&] { return ready() || self->deleted; };
+    bool ok;
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, check);
+        ok = true;
+    } else {
+        ok = cv.wait_for(lock, std::chrono::milliseconds(ticks), check);
+    }
+    if (self->deleted) throw TaskDeleted();
+    return ok && ready();
+}
+
+}  // namespace
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority, TaskHandle_t* created) {
+    FakeTask* task = new FakeTask;
+    task->name = name ? name : "";
+    live_tasks++;
+    if (created) *created = task;
+    task->thread = std::thread([task, code, arg] {
+        current_task = task;
+        try {
+            code(arg);
+        } catch (const TaskDeleted&) {
+        }
+    });
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (!task) task = currentTask();
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->deleted = true;
+    }
+    task->wake.notify_all();
+    if (task == current_task) {  // Unwinds to the thread function, which then ends
+        task->thread.detach();
+        live_tasks--;
+        throw TaskDeleted();
+    }
+    task->thread.join();  // A task blocked on a queue notices within QueuePollTicks
+    live_tasks--;
+    delete task;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    FakeTask* self = currentTask();
+    std::unique_lock<std::mutex> lock(self->mutex);
+    waitFor(self->wake, lock, ticks, [] { return false; });
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return currentTask();
+}
+
+TickType_t xTaskGetTickCount(void) {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    FakeTask* self = currentTask();
+    std::unique_lock<std::mutex> lock(self->mutex);
+    if (!waitFor(self->wake, lock, ticks_to_wait, [self] { return self->notifications > 0; })) return 0;
+    uint32_t value = self->notifications;
+    self->notifications = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->wake.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken) *higher_priority_task_woken = pdFALSE;
+}
+
+size_t fake_task_count(void) {
+    return live_tasks.load();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    FakeQueue* queue = new FakeQueue;
+    queue->length = length;
+    queue->itemSize = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+// Queue waits poll the caller's deletion flag every few ms, since a delete
+// only signals the task's own condition variable
+static const TickType_t QueuePollTicks = 5;
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto has_room = [queue] { return queue->items.size() < queue->length; };
+    while (!has_room()) {
+        if (ticks_to_wait == 0) return pdFAIL;
+        TickType_t wait = (ticks_to_wait == portMAX_DELAY || ticks_to_wait > QueuePollTicks) ? QueuePollTicks : ticks_to_wait;
+        waitFor(queue->changed, lock, wait, has_room);
+        if (ticks_to_wait != portMAX_DELAY) ticks_to_wait -= wait;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto has_item = [queue] { return !queue->items.empty(); };
+    while (!has_item()) {
+        if (ticks_to_wait == 0) return pdFAIL;
+        TickType_t wait = (ticks_to_wait == portMAX_DELAY || ticks_to_wait > QueuePollTicks) ? QueuePollTicks : ticks_to_wait;
+        waitFor(queue->changed, lock, wait, has_item);
+        if (ticks_to_wait != portMAX_DELAY) ticks_to_wait -= wait;
+    }
+    memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+bool fake_wait_until(const std::function<bool()>& condition, uint32_t timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
@@ -0,0 +1,11 @@
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+#include <stdint.h>
+#include <functional>
+
+// Polls condition until it holds or timeout_ms of wall time pass, for
+// results that another fake task produces
+bool fake_wait_until(const std::function<bool()>& condition, uint32_t timeout_ms = 2000);
+
+#endif
@@ -0,0 +1,233 @@
+#include "fake_httpd.h"
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+struct FakeServer {
+    httpd_config_t config;
+    std::vector<httpd_uri_t> handlers;
+    std::vector<std::pair<int, bool>> clients;  // fd, websocket
+    std::map<int, std::vector<std::string>> wsSent;
+};
+
+httpd_handle_t last_started = nullptr;
+
+FakeHttpRequest& exchange(httpd_req_t* r) {
+    return *static_cast<FakeHttpRequest*>(r->aux);
+}
+
+const char* statusLine(httpd_err_code_t error) {
+    switch (error) {
+    case HTTPD_400_BAD_REQUEST: return "400 Bad Request";
+    case HTTPD_404_NOT_FOUND: return "404 Not Found";
+    case HTTPD_408_REQ_TIMEOUT: return "408 Request Timeout";
+    default: return "500 Internal Server Error";
+    }
+}
+
+}  // namespace
+
+FakeHttpRequest::FakeHttpRequest(httpd_method_t method, const char* uri, const std::string& body) : body(body) {
+    memset(&req, 0, sizeof(req));
+    req.method = method;
+    strncpy(req.uri, uri, HTTPD_MAX_URI_LEN);
+    req.content_len = body.size();
+    req.aux = this;
+    const char* question = strchr(uri, '?');
+    if (question) query = question + 1;
+}
+
+std::string FakeHttpRequest::responseHeader(const char* field) const {
+    for (const auto& header : responseHeaders) {
+        if (header.first == field) return header.second;
+    }
+    return "";
+}
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {
+    FakeServer* server = new FakeServer;
+    server->config = *config;
+    *handle = server;
+    last_started = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    if (handle == last_started) last_started = nullptr;
+    delete static_cast<FakeServer*>(handle);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {
+    FakeServer* server = static_cast<FakeServer*>(handle);
+    for (const httpd_uri_t& existing : server->handlers) {
+        if (strcmp(existing.uri, uri_handler->uri) == 0 && existing.method == uri_handler->method) return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+    if (server->handlers.size() >= server->config.max_uri_handlers) return ESP_ERR_HTTPD_HANDLERS_FULL;
+    server->handlers.push_back(*uri_handler);
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg) {
+    work(arg);
+    return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t* fds, int* client_fds) {
+    FakeServer* server = static_cast<FakeServer*>(handle);
+    if (server->clients.size() > *fds) return ESP_ERR_INVALID_ARG;
+    *fds = server->clients.size();
+    for (size_t i = 0; i < server->clients.size(); i++) client_fds[i] = server->clients[i].first;
+    return ESP_OK;
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+    FakeHttpRequest& request = exchange(r);
+    size_t remaining = request.body.size() - request.bodyRead;
+    if (remaining == 0) return HTTPD_SOCK_ERR_TIMEOUT;
+    size_t n = std::min(remaining, buf_len);
+    if (request.recvLimit > 0) n = std::min(n, (size_t)request.recvLimit);
+    memcpy(buf, request.body.data() + request.bodyRead, n);
+    request.bodyRead += n;
+    return (int)n;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {
+    const std::string& query = exchange(r).query;
+    if (query.empty()) return ESP_ERR_NOT_FOUND;
+    if (buf_len == 0) return ESP_ERR_INVALID_ARG;
+    size_t n = std::min(query.size(), buf_len - 1);
+    memcpy(buf, query.data(), n);
+    buf[n] = '\0';
+    return n < query.size() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {
+    const std::map<std::string, std::string>& headers = exchange(r).headers;
+    auto header = headers.find(field);
+    if (header == headers.end()) return ESP_ERR_NOT_FOUND;
+    if (val_size == 0) return ESP_ERR_INVALID_ARG;
+    size_t n = std::min(header->second.size(), val_size - 1);
+    memcpy(val, header->second.data(), n);
+    val[n] = '\0';
+    return n < header->second.size() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+// Same rules as the real one: '&' separated key=value pairs, no URL
+// decoding, values cut to fit with ESP_ERR_HTTPD_RESULT_TRUNC
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+    if (!qry || !key || !val || val_size == 0) return ESP_ERR_INVALID_ARG;
+    size_t key_len = strlen(key);
+    const char* pair = qry;
+    while (*pair) {
+        const char* end = strchr(pair, '&');
+        if (!end) end = pair + strlen(pair);
+        const char* equals = (const char*)memchr(pair, '=', end - pair);
+        if (equals && (size_t)(equals - pair) == key_len && strncmp(pair, key, key_len) == 0) {
+            size_t len = end - equals - 1;
+            size_t n = std::min(len, val_size - 1);
+            memcpy(val, equals + 1, n);
+            val[n] = '\0';
+            return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        pair = *end ? end + 1 : end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+    exchange(r).status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+    exchange(r).contentType = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {
+    exchange(r).responseHeaders.emplace_back(field, value);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    FakeHttpRequest& request = exchange(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? strlen(buf) : 0;
+    request.response.assign(buf ? buf : "", buf ? buf_len : 0);
+    request.complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    FakeHttpRequest& request = exchange(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? strlen(buf) : 0;
+    if (request.failChunkAfter >= 0 && request.chunks >= (size_t)request.failChunkAfter) return ESP_ERR_HTTPD_RESP_SEND;
+    if (!buf || buf_len == 0) {
+        request.complete = true;
+        return ESP_OK;
+    }
+    request.response.append(buf, buf_len);
+    request.chunks++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* r, httpd_err_code_t error, const char* msg) {
+    FakeHttpRequest& request = exchange(r);
+    request.status = statusLine(error);
+    request.contentType = "text/html";
+    request.response = msg ? msg : "";
+    request.complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_408(httpd_req_t* r) {
+    return httpd_resp_send_err(r, HTTPD_408_REQ_TIMEOUT, "Server closed this connection");
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t* r, httpd_ws_frame_t* frame, size_t max_len) {
+    return ESP_FAIL;  // Clients never send anything the firmware reads
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int fd, httpd_ws_frame_t* frame) {
+    FakeServer* server = static_cast<FakeServer*>(handle);
+    server->wsSent[fd].emplace_back(reinterpret_cast<const char*>(frame->payload), frame->len);
+    return ESP_OK;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t handle, int sockfd) {
+    FakeServer* server = static_cast<FakeServer*>(handle);
+    for (const auto& client : server->clients) {
+        if (client.first == sockfd) return client.second ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+    }
+    return HTTPD_WS_CLIENT_INVALID;
+}
+
+httpd_handle_t fake_httpd_last_started(void) {
+    return last_started;
+}
+
+const httpd_uri_t* fake_httpd_find_handler(httpd_handle_t handle, const char* uri, httpd_method_t method) {
+    FakeServer* server = static_cast<FakeServer*>(handle);
+    std::string path(uri, strcspn(uri, "?"));
+    for (const httpd_uri_t& handler : server->handlers) {
+        if (path == handler.uri && handler.method == method) return &handler;
+    }
+    return nullptr;
+}
+
+esp_err_t fake_httpd_dispatch(httpd_handle_t handle, FakeHttpRequest& request) {
+    const httpd_uri_t* handler = fake_httpd_find_handler(handle, request.req.uri, (httpd_method_t)request.req.method);
+    if (!handler) return httpd_resp_send_err(&request.req, HTTPD_404_NOT_FOUND, "Nothing matches the given URI");
+    request.req.handle = handle;
+    request.req.user_ctx = handler->user_ctx;
+    return handler->handler(&request.req);
+}
+
+void fake_httpd_add_client(httpd_handle_t handle, int fd, bool websocket) {
+    static_cast<FakeServer*>(handle)->clients.emplace_back(fd, websocket);
+}
+
+const std::vector<std::string>& fake_httpd_ws_sent(httpd_handle_t handle, int fd) {
+    return static_cast<FakeServer*>(handle)->wsSent[fd];
+}
@@ -0,0 +1,43 @@
+#ifndef FAKE_HTTPD_H
+#define FAKE_HTTPD_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <esp_http_server.h>
+
+// One request/response exchange. The handler under test gets req; whatever
+// it sends is collected in the response fields.
+struct FakeHttpRequest {
+    FakeHttpRequest(httpd_method_t method, const char* uri, const std::string& body = "");
+
+    httpd_req_t req;
+    std::string query;  // From the uri, after the '?'
+    std::map<std::string, std::string> headers;
+    std::string body;
+    size_t bodyRead = 0;
+    int recvLimit = 0;      // Most bytes one httpd_req_recv() returns, 0 for no limit
+    int failChunkAfter = -1;  // httpd_resp_send_chunk() fails from this chunk on
+
+    std::string status = "200 OK";
+    std::string contentType = "text/html";
+    std::vector<std::pair<std::string, std::string>> responseHeaders;
+    std::string response;
+    size_t chunks = 0;   // Non-empty chunks sent
+    bool complete = false;  // Response sent or chunked response terminated
+
+    std::string responseHeader(const char* field) const;
+};
+
+// Server from the latest httpd_start() that is still running, for code that
+// keeps its handle private
+httpd_handle_t fake_httpd_last_started(void);
+// Registered handlers of a server from httpd_start()
+const httpd_uri_t* fake_httpd_find_handler(httpd_handle_t handle, const char* uri, httpd_method_t method);
+// Runs the registered handler for request's method and uri with its user_ctx
+esp_err_t fake_httpd_dispatch(httpd_handle_t handle, FakeHttpRequest& request);
+void fake_httpd_add_client(httpd_handle_t handle, int fd, bool websocket);
+const std::vector<std::string>& fake_httpd_ws_sent(httpd_handle_t handle, int fd);
+
+#endif
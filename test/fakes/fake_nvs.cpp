@@ -0,0 +1,245 @@
+#include <nvs_flash.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+
+namespace {
+
+enum class Type { U8, U32, Str, Blob };
+
+struct Value {
+    Type type;
+    std::vector<uint8_t> bytes;  // Strings include the terminator
+};
+
+typedef std::map<std::string, Value> Namespace;
+
+struct Handle {
+    std::string ns;
+    bool writable;
+    bool eraseAll;  // Pending nvs_erase_all()
+    std::map<std::string, Value> writes;
+    std::vector<std::string> erasedKeys;
+};
+
+std::mutex mutex;
+std::map<std::string, Namespace> store;
+std::map<nvs_handle_t, Handle> handles;
+nvs_handle_t next_handle = 1;
+int commit_failures = 0;
+esp_err_t commit_error = ESP_FAIL;
+int erase_failures = 0;
+esp_err_t erase_error = ESP_FAIL;
+uint32_t commits = 0;
+uint32_t writes = 0;
+
+bool validKey(const char* key) {
+    return key && strlen(key) < NVS_KEY_NAME_MAX_SIZE;
+}
+
+// Reads see the handle's own pending writes, like the real library where
+// they are already on flash
+esp_err_t lookup(nvs_handle_t handle, const char* key, Type type, const Value*& value) {
+    auto h = handles.find(handle);
+    if (h == handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!validKey(key)) return ESP_ERR_NVS_KEY_TOO_LONG;
+    auto pending = h->second.writes.find(key);
+    if (pending != h->second.writes.end()) {
+        value = &pending->second;
+    } else {
+        if (h->second.eraseAll) return ESP_ERR_NVS_NOT_FOUND;
+        for (const std::string& erased : h->second.erasedKeys) {
+            if (erased == key) return ESP_ERR_NVS_NOT_FOUND;
+        }
+        auto ns = store.find(h->second.ns);
+        if (ns == store.end()) return ESP_ERR_NVS_NOT_FOUND;
+        auto stored = ns->second.find(key);
+        if (stored == ns->second.end()) return ESP_ERR_NVS_NOT_FOUND;
+        value = &stored->second;
+    }
+    return value->type == type ? ESP_OK : ESP_ERR_NVS_TYPE_MISMATCH;
+}
+
+esp_err_t write(nvs_handle_t handle, const char* key, Type type, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->second.writable) return ESP_ERR_NVS_READ_ONLY;
+    if (!validKey(key)) return ESP_ERR_NVS_KEY_TOO_LONG;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    h->second.writes[key] = Value{type, std::vector<uint8_t>(bytes, bytes + size)};
+    return ESP_OK;
+}
+
+esp_err_t readFixed(nvs_handle_t handle, const char* key, Type type, void* out, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Value* value;
+    esp_err_t ret = lookup(handle, key, type, value);
+    if (ret != ESP_OK) return ret;
+    memcpy(out, value->bytes.data(), size);
+    return ESP_OK;
+}
+
+esp_err_t readVariable(nvs_handle_t handle, const char* key, Type type, void* out, size_t* length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Value* value;
+    esp_err_t ret = lookup(handle, key, type, value);
+    if (ret != ESP_OK) return ret;
+    if (!out) {
+        *length = value->bytes.size();
+        return ESP_OK;
+    }
+    if (*length < value->bytes.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, value->bytes.data(), value->bytes.size());
+    *length = value->bytes.size();
+    return ESP_OK;
+}
+
+}  // namespace
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    store.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!validKey(name)) return ESP_ERR_NVS_INVALID_NAME;
+    if (open_mode == NVS_READONLY && store.find(name) == store.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (open_mode == NVS_READWRITE) store[name];
+    handles[next_handle] = Handle{name, open_mode == NVS_READWRITE, false, {}, {}};
+    *out_handle = next_handle++;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    handles.erase(handle);  // Uncommitted writes are lost
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    Handle& pending = h->second;
+    if (commit_failures > 0) {
+        commit_failures--;
+        pending.eraseAll = false;
+        pending.writes.clear();
+        pending.erasedKeys.clear();
+        return commit_error;
+    }
+    Namespace& ns = store[pending.ns];
+    if (pending.eraseAll) ns.clear();
+    for (const std::string& key : pending.erasedKeys) ns.erase(key);
+    for (auto& write : pending.writes) ns[write.first] = write.second;
+    writes += pending.writes.size();
+    commits++;
+    pending.eraseAll = false;
+    pending.writes.clear();
+    pending.erasedKeys.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->second.writable) return ESP_ERR_NVS_READ_ONLY;
+    if (erase_failures > 0) {
+        erase_failures--;
+        return erase_error;
+    }
+    h->second.eraseAll = true;
+    h->second.writes.clear();
+    h->second.erasedKeys.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->second.writable) return ESP_ERR_NVS_READ_ONLY;
+    if (!validKey(key)) return ESP_ERR_NVS_KEY_TOO_LONG;
+    h->second.writes.erase(key);
+    h->second.erasedKeys.push_back(key);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return write(handle, key, Type::U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    return readFixed(handle, key, Type::U8, out_value, sizeof(*out_value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return write(handle, key, Type::U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    return readFixed(handle, key, Type::U32, out_value, sizeof(*out_value));
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return write(handle, key, Type::Str, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    return readVariable(handle, key, Type::Str, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return write(handle, key, Type::Blob, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    return readVariable(handle, key, Type::Blob, out_value, length);
+}
+
+void fake_nvs_reset(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    store.clear();
+    handles.clear();
+    commit_failures = 0;
+    erase_failures = 0;
+    commits = 0;
+    writes = 0;
+}
+
+void fake_nvs_fail_commits(int count, esp_err_t err) {
+    std::lock_guard<std::mutex> lock(mutex);
+    commit_failures = count;
+    commit_error = err;
+}
+
+void fake_nvs_fail_erases(int count, esp_err_t err) {
+    std::lock_guard<std::mutex> lock(mutex);
+    erase_failures = count;
+    erase_error = err;
+}
+
+uint32_t fake_nvs_commit_count(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return commits;
+}
+
+uint32_t fake_nvs_write_count(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writes;
+}
+
+bool fake_nvs_contains(const char* ns, const char* key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto n = store.find(ns);
+    return n != store.end() && n->second.find(key) != n->second.end();
+}
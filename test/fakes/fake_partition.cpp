@@ -0,0 +1,98 @@
+#include <esp_partition.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+
+#define FAKE_SECTOR_SIZE 4096
+
+namespace {
+
+struct FakePartition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+    uint32_t erases;
+};
+
+std::mutex mutex;
+std::map<std::string, std::unique_ptr<FakePartition>> partitions;
+
+FakePartition* find(const esp_partition_t* partition) {
+    for (auto& entry : partitions) {
+        if (&entry.second->info == partition) return entry.second.get();
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : partitions) {
+        const esp_partition_t& info = entry.second->info;
+        if (info.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && info.subtype != subtype) continue;
+        if (label && strcmp(info.label, label) != 0) continue;
+        return &info;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    FakePartition* fake = find(partition);
+    if (!fake) return ESP_ERR_INVALID_ARG;
+    if (src_offset > fake->data.size() || size > fake->data.size() - src_offset) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, fake->data.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    FakePartition* fake = find(partition);
+    if (!fake) return ESP_ERR_INVALID_ARG;
+    if (dst_offset > fake->data.size() || size > fake->data.size() - dst_offset) return ESP_ERR_INVALID_SIZE;
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; i++) fake->data[dst_offset + i] &= bytes[i];  // Programming only clears bits
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    FakePartition* fake = find(partition);
+    if (!fake) return ESP_ERR_INVALID_ARG;
+    if (offset % FAKE_SECTOR_SIZE != 0 || size % FAKE_SECTOR_SIZE != 0) return ESP_ERR_INVALID_ARG;
+    if (offset > fake->data.size() || size > fake->data.size() - offset) return ESP_ERR_INVALID_SIZE;
+    memset(fake->data.data() + offset, 0xFF, size);
+    fake->erases++;
+    return ESP_OK;
+}
+
+const esp_partition_t* fake_partition_add(const char* label, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<FakePartition> fake(new FakePartition);
+    memset(&fake->info, 0, sizeof(fake->info));
+    fake->info.type = ESP_PARTITION_TYPE_DATA;
+    fake->info.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    fake->info.size = size;
+    fake->info.erase_size = FAKE_SECTOR_SIZE;
+    strncpy(fake->info.label, label, sizeof(fake->info.label) - 1);
+    fake->data.assign(size, 0xFF);
+    fake->erases = 0;
+    std::unique_ptr<FakePartition>& slot = partitions[label];
+    slot = std::move(fake);
+    return &slot->info;
+}
+
+void fake_partition_remove_all(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    partitions.clear();
+}
+
+uint32_t fake_partition_erase_count(const esp_partition_t* partition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    FakePartition* fake = find(partition);
+    return fake ? fake->erases : 0;
+}
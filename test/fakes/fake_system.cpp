@@ -0,0 +1,73 @@
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+
+static std::atomic<int> log_level{ESP_LOG_WARN};
+static std::atomic<uint32_t> restarts{0};
+static std::atomic<uint32_t> gpio_levels{0};
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    log_level.store(level);  // Per-tag levels are not needed on the host
+}
+
+void fake_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > log_level.load()) return;
+    static const char letters[] = "NEWIDV";
+    fprintf(stderr, "%c (%s) ", letters[level], tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void esp_restart(void) {
+    restarts++;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return 0;
+}
+
+uint32_t fake_restart_count(void) {
+    return restarts.load();
+}
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+    return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num < 0 || gpio_num >= 32) return ESP_ERR_INVALID_ARG;
+    if (level) {
+        gpio_levels.fetch_or(1u << gpio_num);
+    } else {
+        gpio_levels.fetch_and(~(1u << gpio_num));
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= 32) return 0;
+    return (gpio_levels.load() >> gpio_num) & 1;
+}
+
+// The NMEA2000 library expects the Arduino clock functions outside Arduino;
+// weak in case it brings its own
+extern "C" __attribute__((weak)) uint32_t millis() {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+extern "C" __attribute__((weak)) void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,80 @@
+#include <esp_timer.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    int64_t due;
+};
+
+static std::atomic<int64_t> now_us{1000000};  // Starts at 1 s so uptimes are never zero
+static std::mutex timers_mutex;
+static std::set<esp_timer_handle_t> timers;
+
+int64_t esp_timer_get_time(void) {
+    return now_us.load();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (!create_args || !create_args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    esp_timer_handle_t timer = new esp_timer{create_args->callback, create_args->arg, false, 0};
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    timers.insert(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->due = now_us.load() + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timers.erase(timer);
+    delete timer;
+    return ESP_OK;
+}
+
+void fake_timer_advance_us(uint64_t us) {
+    int64_t target = now_us.load() + (int64_t)us;
+    while (true) {
+        esp_timer_handle_t next = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(timers_mutex);
+            for (esp_timer_handle_t timer : timers) {
+                if (timer->armed && timer->due <= target && (!next || timer->due < next->due)) next = timer;
+            }
+            if (!next) break;
+            next->armed = false;
+            now_us.store(next->due);
+        }
+        next->callback(next->arg);  // Unlocked, it may restart its timer
+    }
+    now_us.store(target);
+}
+
+void fake_timer_advance_ms(uint32_t ms) {
+    fake_timer_advance_us((uint64_t)ms * 1000);
+}
+
+size_t fake_timer_pending(void) {
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    size_t count = 0;
+    for (esp_timer_handle_t timer : timers) count += timer->armed ? 1 : 0;
+    return count;
+}
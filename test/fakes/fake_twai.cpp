@@ -0,0 +1,190 @@
+#include <driver/twai.h>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+std::mutex mutex;
+std::condition_variable alerted;
+bool installed = false;
+bool recovery_started = false;
+bool fail_transmit = false;
+twai_general_config_t general;
+twai_filter_config_t filter;
+twai_status_info_t status;
+uint32_t pending_alerts = 0;
+std::deque<twai_message_t> rx_queue;
+std::vector<twai_message_t> transmitted;
+
+// Extended frames: the single filter compares ID28..ID0 against bits 31..3
+// of code and mask, the dual filter compares ID28..ID13 against each half.
+// A set mask bit is don't-care. Standard frames only get through an
+// accept-all filter here; the firmware drops them anyway.
+bool accepts(uint32_t id, bool extd) {
+    if (!extd) return filter.single_filter && filter.acceptance_mask == 0xFFFFFFFF;
+    if (filter.single_filter) {
+        uint32_t frame = id << 3;
+        return ((frame ^ filter.acceptance_code) & ~filter.acceptance_mask & ~0x7u) == 0;
+    }
+    uint32_t top = (id >> 13) & 0xFFFF;
+    for (int shift : {16, 0}) {
+        uint32_t code = (filter.acceptance_code >> shift) & 0xFFFF;
+        uint32_t mask = (filter.acceptance_mask >> shift) & 0xFFFF;
+        if (((top ^ code) & ~mask) == 0) return true;
+    }
+    return false;
+}
+
+void raise(uint32_t alerts) {
+    pending_alerts |= alerts & general.alerts_enabled;
+    alerted.notify_all();
+}
+
+}  // namespace
+
+esp_err_t twai_driver_install(const twai_general_config_t* g_config, const twai_timing_config_t* t_config, const twai_filter_config_t* f_config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (installed) return ESP_ERR_INVALID_STATE;
+    if (!g_config || !t_config || !f_config) return ESP_ERR_INVALID_ARG;
+    installed = true;
+    general = *g_config;
+    filter = *f_config;
+    status = {};
+    status.state = TWAI_STATE_STOPPED;
+    return ESP_OK;
+}
+
+esp_err_t twai_driver_uninstall(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state == TWAI_STATE_RUNNING || status.state == TWAI_STATE_RECOVERING) return ESP_ERR_INVALID_STATE;
+    installed = false;
+    rx_queue.clear();
+    pending_alerts = 0;
+    return ESP_OK;
+}
+
+esp_err_t twai_start(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state != TWAI_STATE_STOPPED) return ESP_ERR_INVALID_STATE;
+    status.state = TWAI_STATE_RUNNING;
+    return ESP_OK;
+}
+
+esp_err_t twai_stop(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state != TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    status.state = TWAI_STATE_STOPPED;
+    return ESP_OK;
+}
+
+esp_err_t twai_transmit(const twai_message_t* message, TickType_t ticks_to_wait) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state != TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    if (fail_transmit) return ESP_ERR_TIMEOUT;
+    transmitted.push_back(*message);
+    return ESP_OK;
+}
+
+esp_err_t twai_receive(twai_message_t* message, TickType_t ticks_to_wait) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed) return ESP_ERR_INVALID_STATE;
+    if (rx_queue.empty()) return ESP_ERR_TIMEOUT;
+    *message = rx_queue.front();
+    rx_queue.pop_front();
+    status.msgs_to_rx = rx_queue.size();
+    return ESP_OK;
+}
+
+esp_err_t twai_read_alerts(uint32_t* alerts, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!installed) return ESP_ERR_INVALID_STATE;
+    auto ready = [] { return pending_alerts != 0; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        alerted.wait(lock, ready);
+    } else if (!alerted.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), ready)) {
+        *alerts = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    *alerts = pending_alerts;
+    pending_alerts = 0;
+    return ESP_OK;
+}
+
+esp_err_t twai_initiate_recovery(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state != TWAI_STATE_BUS_OFF) return ESP_ERR_INVALID_STATE;
+    status.state = TWAI_STATE_RECOVERING;
+    recovery_started = true;
+    return ESP_OK;
+}
+
+esp_err_t twai_get_status_info(twai_status_info_t* status_info) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed) return ESP_ERR_INVALID_STATE;
+    *status_info = status;
+    return ESP_OK;
+}
+
+void fake_twai_reset(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    installed = false;
+    recovery_started = false;
+    fail_transmit = false;
+    pending_alerts = 0;
+    status = {};
+    rx_queue.clear();
+    transmitted.clear();
+}
+
+bool fake_twai_bus_frame(uint32_t id, bool extd, uint8_t len, const uint8_t* data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed || status.state != TWAI_STATE_RUNNING || !accepts(id, extd)) return false;
+    if (rx_queue.size() >= general.rx_queue_len) {
+        status.rx_missed_count++;
+        raise(TWAI_ALERT_RX_QUEUE_FULL);
+        return true;
+    }
+    twai_message_t message = {};
+    message.extd = extd;
+    message.identifier = id;
+    message.data_length_code = len;
+    for (uint8_t i = 0; i < len && i < 8; i++) message.data[i] = data[i];
+    rx_queue.push_back(message);
+    status.msgs_to_rx = rx_queue.size();
+    raise(TWAI_ALERT_RX_DATA);
+    return true;
+}
+
+void fake_twai_raise_alerts(uint32_t alerts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    raise(alerts);
+}
+
+void fake_twai_set_state(twai_state_t state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    status.state = state;
+}
+
+void fake_twai_fail_transmit(bool fail) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fail_transmit = fail;
+}
+
+size_t fake_twai_transmitted(twai_message_t* messages, size_t max) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < transmitted.size() && i < max; i++) messages[i] = transmitted[i];
+    return transmitted.size();
+}
+
+const twai_filter_config_t* fake_twai_filter(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return installed ? &filter : nullptr;
+}
+
+bool fake_twai_recovery_started(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recovery_started;
+}
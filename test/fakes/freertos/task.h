@@ -0,0 +1,23 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+typedef struct FakeTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority, TaskHandle_t* created);
+// Deleting another task waits until it next blocks in a FreeRTOS call
+// (where it is unwound) and joins its thread
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken);
+
+size_t fake_task_count(void);  // Tasks created and not deleted
+
+#endif
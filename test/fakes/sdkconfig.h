@@ -0,0 +1,7 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Host test build: the same switches as the ESP-IDF linux target
+#define CONFIG_IDF_TARGET_LINUX 1
+
+#endif
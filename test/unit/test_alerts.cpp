@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include "alerts.h"
+#include "N2kMessages.h"
+
+TEST(LevelAlert, HighAlertTriggersAndClearsWithHysteresis) {
+    LevelAlert alert(true);
+    EXPECT_FALSE(alert.evaluate(89.0f, 90.0f, 0));
+    EXPECT_TRUE(alert.evaluate(90.0f, 90.0f, 100));
+    EXPECT_TRUE(alert.active());
+    EXPECT_TRUE(alert.textDue());
+    alert.sent(100);
+    EXPECT_FALSE(alert.evaluate(89.5f, 90.0f, 200));  // Inside the hysteresis band
+    EXPECT_TRUE(alert.active());
+    EXPECT_TRUE(alert.evaluate(88.9f, 90.0f, 300));
+    EXPECT_FALSE(alert.active());
+    EXPECT_EQ(N2kts_AlertStateNormal, alert.state(300));
+}
+
+TEST(LevelAlert, LowAlertTriggersBelowThreshold) {
+    LevelAlert alert(false);
+    EXPECT_FALSE(alert.evaluate(11.0f, 10.0f, 0));
+    EXPECT_TRUE(alert.evaluate(9.0f, 10.0f, 0));
+    EXPECT_EQ(N2kts_AlertStateActive, alert.state(0));
+}
+
+TEST(LevelAlert, ActiveAlertRepeatsItsStatus) {
+    LevelAlert alert(true);
+    alert.evaluate(95.0f, 90.0f, 1000);
+    EXPECT_EQ(0u, alert.msUntilDue(1000));
+    alert.sent(1000);
+    EXPECT_EQ((uint32_t)ALERT_STATUS_INTERVAL_MS - 500, alert.msUntilDue(1500));
+    EXPECT_EQ(0u, alert.msUntilDue(1000 + ALERT_STATUS_INTERVAL_MS));
+
+    LevelAlert idle(true);
+    EXPECT_EQ(UINT32_MAX, idle.msUntilDue(0));
+}
+
+TEST(LevelAlert, AcknowledgeAndSilence) {
+    LevelAlert alert(true);
+    EXPECT_FALSE(alert.respond(N2kts_AlertResponseAcknowledge, 1, 0));  // Nothing active
+    alert.evaluate(95.0f, 90.0f, 0);
+    alert.sent(0);
+
+    EXPECT_TRUE(alert.respond(N2kts_AlertResponseTemporarySilence, 7, 1000));
+    EXPECT_EQ(N2kts_AlertStateSilenced, alert.state(1000));
+    alert.sent(1000);
+    EXPECT_TRUE(alert.evaluate(95.0f, 90.0f, 1000 + ALERT_SILENCE_MS));  // Silence ran out
+    EXPECT_EQ(N2kts_AlertStateActive, alert.state(1000 + ALERT_SILENCE_MS));
+
+    EXPECT_FALSE(alert.respond(N2kts_AlertResponseTestCommandOn, 7, 2000));
+    EXPECT_TRUE(alert.respond(N2kts_AlertResponseAcknowledge, 7, 2000));
+    EXPECT_EQ(N2kts_AlertStateAcknowledged, alert.state(2000));
+    EXPECT_FALSE(alert.respond(N2kts_AlertResponseAcknowledge, 8, 2100));
+}
+
+TEST(LevelAlert, FillsAlertMessages) {
+    LevelAlert alert(false);
+    alert.evaluate(5.0f, 10.0f, 0);
+    tN2kMsg status;
+    alert.setStatus(status, 2, 0x1234, 0, 0);
+    EXPECT_EQ(126983u, status.PGN);
+    char description[] = "Tank 1 low";
+    tN2kMsg text;
+    alert.setText(text, 2, 0x1234, 0, description);
+    EXPECT_EQ(126985u, text.PGN);
+}
+
+// The web UI polls active() from the httpd task while nmea_task evaluates
+TEST(LevelAlert, ActiveIsReadableFromAnotherTask) {
+    LevelAlert alert(true);
+    std::atomic<bool> stop{false};
+    std::atomic<int> reads{0};
+    std::thread web([&] {
+        while (!stop) {
+            alert.active();
+            reads++;
+        }
+    });
+    uint32_t i = 0;
+    for (; i < 2000 || reads < 100; i++) {
+        alert.evaluate(i % 2 ? 95.0f : 85.0f, 90.0f, i);
+        alert.sent(i);
+    }
+    alert.evaluate(95.0f, 90.0f, i);
+    stop = true;
+    web.join();
+    EXPECT_TRUE(alert.active());
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "calibration.h"
+#include "geometry.h"
+
+// Fill percentage of a 100 cm horizontal cylinder, sensor on top: distance 0
+// is full, 100 is empty
+static double cylinderPercent(double distance) {
+    const TankShapeModel* model = findTankShape("cylindrical laying flat");
+    return 100.0 * model->fill(1.0 - distance / 100.0, model->defaultRatio);
+}
+
+static std::vector<CalibrationPoint> cylinderTable(int points) {
+    std::vector<CalibrationPoint> table;
+    for (int i = 0; i < points; i++) {
+        double distance = 100.0 * i / (points - 1);
+        table.push_back({(float)distance, (float)cylinderPercent(distance)});
+    }
+    return table;
+}
+
+// Piecewise linear interpolation of a sorted table, the reference PCHIP has
+// to beat
+static double linear(const std::vector<CalibrationPoint>& table, double distance) {
+    size_t i = 0;
+    while (i + 2 < table.size() && distance > table[i + 1].distance) i++;
+    const CalibrationPoint& a = table[i];
+    const CalibrationPoint& b = table[i + 1];
+    return a.percentage + (b.percentage - a.percentage) * (distance - a.distance) / (b.distance - a.distance);
+}
+
+TEST(LevelTransferFunction, EmptyTableReadsZero) {
+    LevelTransferFunction transfer;
+    EXPECT_TRUE(transfer.empty());
+    EXPECT_EQ(0.0f, transfer.evaluate(42.0f));
+}
+
+TEST(LevelTransferFunction, SinglePointIsConstant) {
+    LevelTransferFunction transfer;
+    transfer.build({{30.0f, 55.0f}});
+    EXPECT_EQ(55.0f, transfer.evaluate(0.0f));
+    EXPECT_EQ(55.0f, transfer.evaluate(100.0f));
+}
+
+TEST(LevelTransferFunction, TwoPointsAreLinear) {
+    LevelTransferFunction transfer;
+    transfer.build({{10.0f, 100.0f}, {90.0f, 0.0f}});
+    EXPECT_FLOAT_EQ(50.0f, transfer.evaluate(50.0f));
+    EXPECT_FLOAT_EQ(75.0f, transfer.evaluate(30.0f));
+}
+
+TEST(LevelTransferFunction, PassesThroughEveryPoint) {
+    std::vector<CalibrationPoint> points = {{5, 100}, {20, 90}, {35, 70}, {60, 40}, {80, 12}, {95, 0}};
+    LevelTransferFunction transfer;
+    transfer.build(points);
+    EXPECT_EQ(points.size(), transfer.size());
+    for (const CalibrationPoint& point : points) {
+        EXPECT_NEAR(point.percentage, transfer.evaluate(point.distance), 1e-4) << "at " << point.distance;
+    }
+}
+
+TEST(LevelTransferFunction, ClampsOutsideTheTable) {
+    LevelTransferFunction transfer;
+    transfer.build({{10, 100}, {50, 45}, {90, 0}});
+    EXPECT_EQ(100.0f, transfer.evaluate(-5.0f));
+    EXPECT_EQ(0.0f, transfer.evaluate(250.0f));
+}
+
+TEST(LevelTransferFunction, KeepsAtMostMaxPoints) {
+    std::vector<CalibrationPoint> points;
+    for (int i = 0; i < MAX_CALIBRATION_POINTS + 10; i++) points.push_back({(float)i, 100.0f - i});
+    LevelTransferFunction transfer;
+    transfer.build(points);
+    EXPECT_EQ((size_t)MAX_CALIBRATION_POINTS, transfer.size());
+}
+
+TEST(LevelTransferFunction, StaysMonotoneOnMonotoneData) {
+    // Steep then flat: an unconstrained cubic spline overshoots here
+    LevelTransferFunction transfer;
+    transfer.build({{0, 100}, {10, 98}, {20, 95}, {25, 40}, {30, 5}, {60, 4}, {100, 0}});
+    float previous = transfer.evaluate(0.0f);
+    for (int i = 1; i <= 10000; i++) {
+        float value = transfer.evaluate(i / 100.0f);
+        EXPECT_LE(value, previous + 1e-4f) << "at " << i / 100.0f;
+        previous = value;
+    }
+}
+
+TEST(LevelTransferFunction, DoesNotOvershootSteps) {
+    std::vector<CalibrationPoint> points = {{0, 100}, {20, 100}, {21, 0}, {40, 0}, {41, 100}, {60, 100}};
+    LevelTransferFunction transfer;
+    transfer.build(points);
+    for (size_t i = 0; i + 1 < points.size(); i++) {
+        float low = std::min(points[i].percentage, points[i + 1].percentage);
+        float high = std::max(points[i].percentage, points[i + 1].percentage);
+        for (int k = 0; k <= 100; k++) {
+            float distance = points[i].distance + (points[i + 1].distance - points[i].distance) * k / 100.0f;
+            float value = transfer.evaluate(distance);
+            EXPECT_GE(value, low - 1e-4f) << "at " << distance;
+            EXPECT_LE(value, high + 1e-4f) << "at " << distance;
+        }
+    }
+}
+
+TEST(LevelTransferFunction, HorizontalCylinderBeatsLinear) {
+    struct {
+        int points;
+        double bound;  // Largest error in percent of the tank
+    } cases[] = {{3, 5.8}, {8, 0.58}, {64, 0.021}};
+    for (const auto& c : cases) {
+        std::vector<CalibrationPoint> table = cylinderTable(c.points);
+        LevelTransferFunction transfer;
+        transfer.build(table);
+        double pchip_error = 0.0;
+        double linear_error = 0.0;
+        for (int i = 0; i <= 10000; i++) {
+            double distance = i / 100.0;
+            double exact = cylinderPercent(distance);
+            pchip_error = std::max(pchip_error, std::fabs(transfer.evaluate((float)distance) - exact));
+            linear_error = std::max(linear_error, std::fabs(linear(table, distance) - exact));
+        }
+        EXPECT_LT(pchip_error, c.bound) << c.points << " points";
+        EXPECT_LE(pchip_error, linear_error + 1e-3) << c.points << " points";
+    }
+}
+
+TEST(LevelTransferFunction, SortsAndKeepsTheFirstDuplicate) {
+    LevelTransferFunction sorted;
+    sorted.build({{5, 100}, {35, 70}, {60, 40}, {95, 0}});
+    LevelTransferFunction shuffled;
+    shuffled.build({{60, 40}, {5, 100}, {35, 70}, {95, 0}, {35, 10}, {60, 90}});
+    EXPECT_EQ(sorted.size(), shuffled.size());
+    for (int i = 0; i <= 100; i++) {
+        EXPECT_EQ(sorted.evaluate((float)i), shuffled.evaluate((float)i)) << "at " << i;
+    }
+}
+
+TEST(LevelTransferFunction, EvaluateIsCheap) {
+    LevelTransferFunction transfer;
+    transfer.build(cylinderTable(MAX_CALIBRATION_POINTS));
+    const int iterations = 100000;
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) sink = transfer.evaluate((i * 37 % 1000) / 10.0f);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    (void)sink;
+    EXPECT_LT(elapsed.count() / iterations, 1000) << "ns per evaluate";  // About 10 ns on a desktop
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "can_filter.h"
+
+static unsigned long frameId(unsigned priority, unsigned long pgn, unsigned source, unsigned destination = 0xFF) {
+    if (((pgn >> 8) & 0xFF) < 240) pgn = (pgn & ~0xFFUL) | destination;
+    return ((unsigned long)priority << 26) | (pgn << 8) | source;
+}
+
+TEST(CanFilter, PgnFromPdu2IdKeepsTheGroupExtension) {
+    EXPECT_EQ(127505u, n2kPgnFromId(frameId(6, 127505, 0x23)));
+    EXPECT_EQ(130311u, n2kPgnFromId(frameId(5, 130311, 0x01)));
+}
+
+TEST(CanFilter, PgnFromPdu1IdDropsTheDestination) {
+    EXPECT_EQ(59904u, n2kPgnFromId(frameId(6, 59904, 0x10, 0x42)));
+    EXPECT_EQ(126208u, n2kPgnFromId(frameId(3, 126208, 0x10, 0xFF)));
+}
+
+TEST(CanFilter, AcceptanceMatchesAnySourceAndPriority) {
+    for (unsigned long pgn : {127505UL, 130312UL, 59904UL, 60928UL}) {
+        uint32_t id, care;
+        n2kPgnAcceptance(pgn, id, care);
+        for (unsigned priority : {0u, 3u, 7u}) {
+            for (unsigned source : {0u, 0x42u, 0xFEu}) {
+                unsigned long frame = frameId(priority, pgn, source, 0x17);
+                EXPECT_EQ(id, frame & care) << pgn;
+            }
+        }
+        EXPECT_NE(id, frameId(6, 127508, 0x23) & care) << pgn;
+    }
+}
+
+TEST(CanFilter, ReceivePgnsAppendSystemPgnsWithoutDuplicates) {
+    const unsigned long app[] = {130312L, 59904L, 127257L, 0};
+    std::vector<unsigned long> pgns = n2kReceivePgns(app);
+    EXPECT_EQ(130312u, pgns[0]);
+    EXPECT_EQ(1, std::count(pgns.begin(), pgns.end(), 59904UL));
+    for (size_t i = 0; N2kSystemPgns[i]; i++) {
+        EXPECT_NE(pgns.end(), std::find(pgns.begin(), pgns.end(), N2kSystemPgns[i]));
+    }
+}
+
+TEST(CanFilter, ReceivePgnsWithoutApplicationList) {
+    std::vector<unsigned long> pgns = n2kReceivePgns(nullptr);
+    size_t system = 0;
+    while (N2kSystemPgns[system]) system++;
+    EXPECT_EQ(system, pgns.size());
+}
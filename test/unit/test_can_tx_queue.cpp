@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "can_tx_queue.h"
+
+static CanFrame frame(unsigned priority, unsigned long pgn, bool continuation = false, unsigned char tag = 0) {
+    CanFrame f = {};
+    f.id = ((unsigned long)priority << 26) | (pgn << 8) | 0x23;
+    f.len = 8;
+    f.data[0] = tag;
+    f.continuation = continuation;
+    return f;
+}
+
+TEST(CanTxQueue, OrdersByPriorityThenFifo) {
+    CanTxQueue queue(8);
+    size_t dropped;
+    ASSERT_TRUE(queue.push(frame(6, 127505, false, 1), dropped));
+    ASSERT_TRUE(queue.push(frame(6, 127505, false, 2), dropped));
+    ASSERT_TRUE(queue.push(frame(2, 126983, false, 3), dropped));
+    ASSERT_TRUE(queue.push(frame(6, 127505, false, 4), dropped));
+    unsigned char order[] = {3, 1, 2, 4};
+    for (unsigned char tag : order) {
+        ASSERT_FALSE(queue.empty());
+        EXPECT_EQ(tag, queue.front().data[0]);
+        queue.pop();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(CanTxQueue, FullQueueRejectsLessUrgentFrames) {
+    CanTxQueue queue(2);
+    size_t dropped;
+    queue.push(frame(3, 127505), dropped);
+    queue.push(frame(3, 127505), dropped);
+    EXPECT_FALSE(queue.push(frame(6, 127505), dropped));
+    EXPECT_EQ(0u, dropped);
+    EXPECT_EQ(2u, queue.size());
+}
+
+TEST(CanTxQueue, UrgentFrameEvictsTheLastMessageWhole) {
+    CanTxQueue queue(4);
+    size_t dropped;
+    queue.push(frame(3, 127505, false, 1), dropped);
+    queue.push(frame(6, 126996, false, 2), dropped);  // Fast packet, three frames
+    queue.push(frame(6, 126996, true, 3), dropped);
+    queue.push(frame(6, 126996, true, 4), dropped);
+    ASSERT_TRUE(queue.push(frame(2, 126983, false, 5), dropped));
+    EXPECT_EQ(3u, dropped);
+    EXPECT_EQ(2u, queue.size());
+    EXPECT_EQ(5, queue.front().data[0]);
+}
+
+TEST(CanTxQueue, RejectedContinuationTakesBackItsMessage) {
+    CanTxQueue queue(3);
+    size_t dropped;
+    queue.push(frame(3, 127505), dropped);
+    queue.push(frame(6, 126996, false), dropped);
+    queue.push(frame(6, 126996, true), dropped);
+    EXPECT_FALSE(queue.push(frame(6, 126996, true), dropped));
+    EXPECT_EQ(2u, dropped);
+    EXPECT_EQ(1u, queue.size());
+    EXPECT_FALSE(queue.push(frame(6, 126996, true), dropped));  // Rest of the message stays out
+    EXPECT_EQ(1u, queue.size());
+    EXPECT_TRUE(queue.push(frame(6, 126996, false), dropped));  // Next message is fine
+}
+
+TEST(CanTxQueue, PopMessageDropsContinuations) {
+    CanTxQueue queue(4);
+    size_t dropped;
+    queue.push(frame(6, 126996, false), dropped);
+    queue.push(frame(6, 126996, true), dropped);
+    queue.push(frame(6, 127505, false, 9), dropped);
+    EXPECT_EQ(2u, queue.popMessage());
+    EXPECT_EQ(9, queue.front().data[0]);
+}
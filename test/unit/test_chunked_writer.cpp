@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "chunked_writer.h"
+#include "fake_httpd.h"
+
+TEST(ChunkedWriterTest, BuffersSmallWritesIntoOneChunk) {
+    FakeHttpRequest request(HTTP_GET, "/page");
+    ChunkedWriter out(&request.req);
+    out.print("<html>").printf("<p>%d of %s</p>", 3, "three").write("</html>", 7);
+    EXPECT_EQ(0u, request.chunks);
+    EXPECT_EQ(ESP_OK, out.finish());
+    EXPECT_EQ(1u, request.chunks);
+    EXPECT_TRUE(request.complete);
+    EXPECT_EQ("<html><p>3 of three</p></html>", request.response);
+}
+
+TEST(ChunkedWriterTest, SendsAFullBufferAsOneChunk) {
+    FakeHttpRequest request(HTTP_GET, "/page");
+    ChunkedWriter out(&request.req);
+    std::string body(600, 'x');
+    for (size_t i = 0; i < body.size(); i++) body[i] = 'a' + i % 26;
+    out.write(body.data(), body.size());
+    EXPECT_EQ(2u, request.chunks);
+    EXPECT_EQ(2u * CHUNKED_WRITER_BUFFER, request.response.size());
+    EXPECT_FALSE(request.complete);
+    EXPECT_EQ(ESP_OK, out.finish());
+    EXPECT_EQ(3u, request.chunks);
+    EXPECT_EQ(body, request.response);
+}
+
+TEST(ChunkedWriterTest, PrintfThatDoesNotFitStartsANewChunk) {
+    FakeHttpRequest request(HTTP_GET, "/page");
+    ChunkedWriter out(&request.req);
+    std::string filler(CHUNKED_WRITER_BUFFER - 4, '-');
+    out.print(filler.c_str());
+    out.printf("%s", "twelve bytes");
+    EXPECT_EQ(1u, request.chunks);
+    EXPECT_EQ(filler, request.response);
+    EXPECT_EQ(ESP_OK, out.finish());
+    EXPECT_EQ(filler + "twelve bytes", request.response);
+}
+
+TEST(ChunkedWriterTest, PrintfLargerThanTheBufferFails) {
+    FakeHttpRequest request(HTTP_GET, "/page");
+    ChunkedWriter out(&request.req);
+    std::string huge(CHUNKED_WRITER_BUFFER, 'y');
+    out.print("before");
+    out.printf("%s", huge.c_str());
+    EXPECT_FALSE(out.ok());
+    out.print("after");
+    EXPECT_EQ(ESP_ERR_INVALID_SIZE, out.finish());
+    EXPECT_EQ("before", request.response);
+    EXPECT_FALSE(request.complete);
+}
+
+TEST(ChunkedWriterTest, DropsEverythingAfterAFailedSend) {
+    FakeHttpRequest request(HTTP_GET, "/page");
+    request.failChunkAfter = 1;
+    ChunkedWriter out(&request.req);
+    std::string body(3 * CHUNKED_WRITER_BUFFER, 'z');
+    out.write(body.data(), body.size());
+    EXPECT_FALSE(out.ok());
+    out.printf("%d", 42).print("more");
+    EXPECT_EQ(ESP_ERR_HTTPD_RESP_SEND, out.finish());
+    EXPECT_EQ(1u, request.chunks);
+    EXPECT_FALSE(request.complete);
+}
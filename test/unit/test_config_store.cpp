@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <string>
+#include "config_store.h"
+#include "fake_freertos.h"
+
+class ConfigStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override { fake_nvs_reset(); }
+};
+
+TEST_F(ConfigStoreTest, ReadsThroughFromNvs) {
+    nvs_handle_t nvs;
+    ASSERT_EQ(ESP_OK, nvs_open("tank", NVS_READWRITE, &nvs));
+    nvs_set_u32(nvs, "height", 120);
+    nvs_set_str(nvs, "shape", "wedge");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+
+    ConfigStore store;
+    uint32_t height = 0;
+    EXPECT_TRUE(store.getU32("tank", "height", height));
+    EXPECT_EQ(120u, height);
+    std::string shape;
+    EXPECT_TRUE(store.getString("tank", "shape", shape));
+    EXPECT_EQ("wedge", shape);
+    uint8_t missing;
+    EXPECT_FALSE(store.getU8("tank", "missing", missing));
+    EXPECT_FALSE(store.getU8("nothing", "here", missing));
+}
+
+TEST_F(ConfigStoreTest, WritesAreDebouncedIntoOneCommit) {
+    ConfigStore store(2000);
+    store.setU32("tank", "height", 80);
+    store.setU32("tank", "volume", 200);
+    store.setString("tank", "shape", "capsule");
+    EXPECT_EQ(0u, fake_nvs_commit_count());
+    uint32_t height = 0;
+    EXPECT_TRUE(store.getU32("tank", "height", height));  // Served from the cache meanwhile
+    EXPECT_EQ(80u, height);
+
+    fake_timer_advance_ms(1999);
+    store.setU32("tank", "height", 90);  // Pushes the commit out again
+    fake_timer_advance_ms(1999);
+    EXPECT_EQ(0u, fake_nvs_commit_count());
+    fake_timer_advance_ms(1);
+    ASSERT_TRUE(fake_wait_until([&] { return store.getCommitCount() == 1; }));
+    EXPECT_EQ(1u, fake_nvs_commit_count());
+    EXPECT_EQ(3u, fake_nvs_write_count());
+}
+
+TEST_F(ConfigStoreTest, UnchangedValuesCostNothing) {
+    ConfigStore store;
+    store.setU8("filter", "median", 1);
+    store.flush();
+    EXPECT_EQ(1u, store.getCommitCount());
+    EXPECT_EQ(1u, fake_nvs_write_count());
+    store.setU8("filter", "median", 1);
+    store.flush();
+    EXPECT_EQ(1u, store.getCommitCount());
+    EXPECT_EQ(1u, fake_nvs_write_count());
+}
+
+TEST_F(ConfigStoreTest, FailedCommitIsRetried) {
+    ConfigStore store(1000);
+    fake_nvs_fail_commits(1, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    store.setBlob("cal", "points", "\x01\x02\x03", 3);
+    fake_timer_advance_ms(1000);
+    ASSERT_TRUE(fake_wait_until([] { return fake_timer_pending() == 1; }));  // Rescheduled
+    EXPECT_FALSE(fake_nvs_contains("cal", "points"));
+
+    fake_timer_advance_ms(1000);
+    ASSERT_TRUE(fake_wait_until([&] { return store.getCommitCount() == 1; }));
+    EXPECT_TRUE(fake_nvs_contains("cal", "points"));
+}
+
+TEST_F(ConfigStoreTest, RetriesBackOff) {
+    ConfigStore store(1000);
+    fake_nvs_fail_commits(2, ESP_FAIL);
+    store.setU32("tank", "height", 80);
+    fake_timer_advance_ms(1000);
+    ASSERT_TRUE(fake_wait_until([] { return fake_timer_pending() == 1; }));  // Retry after 1 s
+    fake_timer_advance_ms(1000);
+    ASSERT_TRUE(fake_wait_until([] { return fake_timer_pending() == 1; }));  // Then after 2 s
+    fake_timer_advance_ms(1999);
+    EXPECT_EQ(0u, store.getCommitCount());
+    fake_timer_advance_ms(1);
+    ASSERT_TRUE(fake_wait_until([&] { return store.getCommitCount() == 1; }));
+    EXPECT_TRUE(fake_nvs_contains("tank", "height"));
+}
+
+TEST_F(ConfigStoreTest, KeyNvsCannotStoreIsDroppedNotRetried) {
+    ConfigStore store(1000);
+    store.setU32("n2k_config", "temperature_source", 2);  // 18 characters, NVS allows 15
+    store.setU32("n2k_config", "num_tanks", 2);
+    fake_timer_advance_ms(1000);
+    ASSERT_TRUE(fake_wait_until([&] { return store.getCommitCount() == 1; }));
+    store.flush();  // Waits for the flush task to finish; nothing is left to write
+    EXPECT_EQ(1u, store.getCommitCount());
+    EXPECT_EQ(0u, fake_timer_pending());  // No retry scheduled
+    EXPECT_TRUE(fake_nvs_contains("n2k_config", "num_tanks"));
+    EXPECT_FALSE(fake_nvs_contains("n2k_config", "temperature_source"));
+
+    uint32_t source = 0;
+    EXPECT_TRUE(store.getU32("n2k_config", "temperature_source", source));  // Still in the cache
+    EXPECT_EQ(2u, source);
+}
+
+TEST_F(ConfigStoreTest, EraseNamespaceHidesAndRemovesValues) {
+    nvs_handle_t nvs;
+    nvs_open("wifi", NVS_READWRITE, &nvs);
+    nvs_set_str(nvs, "ssid", "boat");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+
+    ConfigStore store;
+    store.eraseNamespace("wifi");
+    std::string ssid;
+    EXPECT_FALSE(store.getString("wifi", "ssid", ssid));
+    store.flush();
+    EXPECT_FALSE(fake_nvs_contains("wifi", "ssid"));
+}
+
+TEST_F(ConfigStoreTest, FailedEraseIsRetriedBeforeWrites) {
+    ConfigStore store;
+    store.setString("wifi", "ssid", "old");
+    store.flush();
+    fake_nvs_fail_erases(1, ESP_FAIL);
+    store.eraseNamespace("wifi");
+    store.setString("wifi", "password", "secret");
+    store.flush();
+    EXPECT_TRUE(fake_nvs_contains("wifi", "ssid"));
+    EXPECT_FALSE(fake_nvs_contains("wifi", "password"));
+    store.flush();
+    EXPECT_FALSE(fake_nvs_contains("wifi", "ssid"));
+    EXPECT_TRUE(fake_nvs_contains("wifi", "password"));
+}
+
+TEST_F(ConfigStoreTest, StringIntoAFixedBuffer) {
+    ConfigStore store;
+    store.setString("nmea_config", "device_name", "Fresh water");
+    char fits[12];
+    EXPECT_TRUE(store.getString("nmea_config", "device_name", fits, sizeof(fits)));
+    EXPECT_STREQ("Fresh water", fits);
+    char short_buffer[11];
+    EXPECT_FALSE(store.getString("nmea_config", "device_name", short_buffer, sizeof(short_buffer)));
+}
+
+TEST_F(ConfigStoreTest, BlobSizeMustMatch) {
+    ConfigStore store;
+    uint32_t values[2] = {1, 2};
+    store.setBlob("cal", "table", values, sizeof(values));
+    uint32_t read[2];
+    EXPECT_TRUE(store.getBlob("cal", "table", read, sizeof(read)));
+    EXPECT_EQ(2u, read[1]);
+    EXPECT_FALSE(store.getBlob("cal", "table", read, sizeof(uint32_t)));
+}
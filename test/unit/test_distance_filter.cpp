@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "distance_filter.h"
+
+static FilterSettings_t settings(bool median, uint8_t window, bool kalman) {
+    FilterSettings_t s = DistanceFilter::defaultSettings();
+    s.medianEnabled = median;
+    s.medianWindow = window;
+    s.kalmanEnabled = kalman;
+    return s;
+}
+
+TEST(DistanceFilter, PassesThroughWhenDisabled) {
+    DistanceFilter filter;
+    filter.configure(settings(false, 5, false));
+    EXPECT_EQ(12.5f, filter.update(12.5f));
+    EXPECT_EQ(80.0f, filter.update(80.0f));
+}
+
+TEST(DistanceFilter, ConfigureSanitizesTheWindow) {
+    DistanceFilter filter;
+    filter.configure(settings(true, 1, true));
+    EXPECT_EQ(3, filter.getSettings().medianWindow);
+    filter.configure(settings(true, 8, true));
+    EXPECT_EQ(7, filter.getSettings().medianWindow);
+    filter.configure(settings(true, 40, true));
+    EXPECT_EQ(MAX_MEDIAN_WINDOW, filter.getSettings().medianWindow);
+
+    FilterSettings_t noise = DistanceFilter::defaultSettings();
+    noise.processNoise = -1;
+    noise.measurementNoise = 0;
+    filter.configure(noise);
+    EXPECT_EQ(DistanceFilter::defaultSettings().processNoise, filter.getSettings().processNoise);
+    EXPECT_EQ(DistanceFilter::defaultSettings().measurementNoise, filter.getSettings().measurementNoise);
+}
+
+TEST(DistanceFilter, MedianOfTheWindow) {
+    DistanceFilter filter;
+    filter.configure(settings(true, 3, false));
+    filter.update(10.0f);
+    filter.update(30.0f);
+    EXPECT_EQ(20.0f, filter.update(20.0f));
+    EXPECT_EQ(30.0f, filter.update(40.0f));  // 30, 20, 40
+}
+
+TEST(DistanceFilter, KalmanConvergesOnAStep) {
+    DistanceFilter filter;
+    filter.configure(settings(false, 5, true));
+    EXPECT_EQ(50.0f, filter.update(50.0f));  // First sample initializes the estimate
+    float out = 50.0f;
+    for (int i = 0; i < 200; i++) out = filter.update(60.0f);
+    EXPECT_NEAR(60.0f, out, 0.01f);
+}
+
+TEST(DistanceFilter, ResetForgetsHistory) {
+    DistanceFilter filter;
+    for (int i = 0; i < 10; i++) filter.update(100.0f);
+    filter.reset();
+    EXPECT_EQ(20.0f, filter.update(20.0f));
+}
+
+TEST(DistanceFilter, RejectsASingleSampleSpike) {
+    DistanceFilter filter;
+    filter.configure(settings(true, 5, true));
+    for (int i = 0; i < 20; i++) filter.update(50.0f);
+    EXPECT_NEAR(50.0f, filter.update(300.0f), 1e-3f);  // Bad echo off a baffle
+    EXPECT_NEAR(50.0f, filter.update(50.0f), 1e-3f);
+    EXPECT_NEAR(50.0f, filter.update(0.5f), 1e-3f);    // And one from the transducer ringing
+    for (int i = 0; i < 5; i++) EXPECT_NEAR(50.0f, filter.update(50.0f), 1e-3f);
+
+    // Without the median the Kalman stage alone lets it through
+    DistanceFilter smoothing_only;
+    smoothing_only.configure(settings(false, 5, true));
+    for (int i = 0; i < 20; i++) smoothing_only.update(50.0f);
+    EXPECT_GT(smoothing_only.update(300.0f), 51.0f);
+}
+
+TEST(DistanceFilter, WindowRejectsUpToHalfItsLengthInARow) {
+    DistanceFilter filter;
+    filter.configure(settings(true, 5, false));
+    for (int i = 0; i < 5; i++) filter.update(50.0f);
+    EXPECT_EQ(50.0f, filter.update(300.0f));
+    EXPECT_EQ(50.0f, filter.update(300.0f));
+    EXPECT_EQ(300.0f, filter.update(300.0f));  // Three of five is a real level change
+}
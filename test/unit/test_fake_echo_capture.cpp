@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "fake_echo_capture.h"
+#include "ultrasonic.h"
+
+TEST(FakeEchoCapture, TriggerQueuesAnEchoAndNotifies) {
+    FakeEchoCapture capture;
+    ASSERT_TRUE(capture.start());
+    capture.setDistance(50.0f);
+    capture.trigger();
+    EXPECT_TRUE(capture.waitForEcho(0));
+    uint32_t pulse;
+    ASSERT_TRUE(capture.samples().pop(pulse));
+    EXPECT_NEAR(50.2f, Ultrasonic::pulseToDistance(pulse, capture.getResolutionHz()), 0.02f);
+    EXPECT_FALSE(capture.samples().pop(pulse));
+    EXPECT_FALSE(capture.waitForEcho(0));
+}
+
+TEST(FakeEchoCapture, SweepsBetweenLimits) {
+    FakeEchoCapture capture;
+    capture.start();
+    capture.setDistance(119.9f);
+    float highest = 0;
+    for (int i = 0; i < 20; i++) {
+        capture.trigger();
+        uint32_t pulse;
+        capture.samples().pop(pulse);
+        float distance = Ultrasonic::pulseToDistance(pulse, capture.getResolutionHz());
+        highest = std::max(highest, distance);
+    }
+    EXPECT_LT(highest, 120.5f);
+    capture.waitForEcho(0);  // Clear the notifications
+}
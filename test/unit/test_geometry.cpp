@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "geometry.h"
+
+TEST(TankShapes, FillIsMonotoneFromEmptyToFull) {
+    for (size_t i = 0; i < tank_shape_model_count; i++) {
+        const TankShapeModel& model = tank_shape_models[i];
+        EXPECT_NEAR(0.0, model.fill(0.0, model.defaultRatio), 1e-9) << model.name;
+        EXPECT_NEAR(1.0, model.fill(1.0, model.defaultRatio), 1e-9) << model.name;
+        double previous = 0.0;
+        for (int step = 1; step <= 100; step++) {
+            double fill = model.fill(step / 100.0, model.defaultRatio);
+            EXPECT_GE(fill, previous) << model.name << " at " << step;
+            previous = fill;
+        }
+    }
+}
+
+TEST(TankShapes, SymmetricShapesAreHalfFullAtHalfHeight) {
+    for (const char* name : {"rectangular", "cylindrical laying flat", "spherical", "capsule"}) {
+        const TankShapeModel* model = findTankShape(name);
+        ASSERT_NE(nullptr, model) << name;
+        EXPECT_NEAR(0.5, model->fill(0.5, model->defaultRatio), 1e-9) << name;
+    }
+}
+
+TEST(TankShapes, UnknownShapeIsNotFound) {
+    EXPECT_EQ(nullptr, findTankShape("custom"));
+}
+
+TEST(TankGeometry, DefaultIsLinear) {
+    TankGeometry geometry;
+    EXPECT_FALSE(geometry.empty());
+    EXPECT_NEAR(0.37f, geometry.fillFraction(0.37f), 1e-6);
+}
+
+TEST(TankGeometry, TableFollowsTheModel) {
+    TankGeometry geometry;
+    geometry.build("cylindrical laying flat", 0);
+    const TankShapeModel* model = findTankShape("cylindrical laying flat");
+    for (int step = 0; step <= 50; step++) {
+        float h = step / 50.0f;
+        EXPECT_NEAR(model->fill(h, 0), geometry.fillFraction(h), 2e-3) << h;
+    }
+}
+
+TEST(TankGeometry, OutOfRangeRatioFallsBackToTheDefault) {
+    TankGeometry geometry;
+    EXPECT_FLOAT_EQ(0.3f, geometry.build("wedge", 4.0f));
+    EXPECT_FLOAT_EQ(0.3f, geometry.build("wedge", NAN));
+    EXPECT_FLOAT_EQ(0.6f, geometry.build("wedge", 0.6f));
+}
+
+TEST(TankGeometry, CustomShapeLeavesTheTableEmpty) {
+    TankGeometry geometry;
+    geometry.build("custom", 0);
+    EXPECT_TRUE(geometry.empty());
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <vector>
+#include "fake_freertos.h"
+#include "history.h"
+
+namespace {
+
+bool collect(const HistoryRecord_t& record, void* ctx) {
+    static_cast<std::vector<HistoryRecord_t>*>(ctx)->push_back(record);
+    return true;
+}
+
+HistoryRecord_t recordAt(uint32_t time) {
+    HistoryRecord_t record = {};
+    record.time = time;
+    record.level[0] = (uint16_t)(time % 10000);
+    record.boot = 1;
+    record.uptime = time;
+    return record;
+}
+
+}  // namespace
+
+TEST(FlashRingLogTest, WrapsOntoItsOldestSector) {
+    const esp_partition_t* partition = fake_partition_add("ringlog", 3 * HISTORY_SECTOR_SIZE);
+    FlashRingLog log(0x54534554);
+    ASSERT_TRUE(log.begin(partition, 0, 3));
+    for (uint32_t t = 1; t <= 775; t++) ASSERT_TRUE(log.append(recordAt(t)));
+
+    // 255 records per sector: 1..765 fill all three, 766 erases the first
+    std::vector<HistoryRecord_t> records;
+    EXPECT_TRUE(log.forEach(0, UINT32_MAX, collect, &records));
+    ASSERT_EQ(520u, records.size());
+    EXPECT_EQ(256u, records.front().time);
+    EXPECT_EQ(775u, records.back().time);
+    for (size_t i = 1; i < records.size(); i++) EXPECT_EQ(records[i - 1].time + 1, records[i].time);
+    EXPECT_EQ(4u, fake_partition_erase_count(partition));
+
+    records.clear();
+    EXPECT_TRUE(log.forEach(300, 310, collect, &records));
+    EXPECT_EQ(11u, records.size());
+}
+
+TEST(FlashRingLogTest, ResumesAfterReboot) {
+    const esp_partition_t* partition = fake_partition_add("ringlog", 3 * HISTORY_SECTOR_SIZE);
+    {
+        FlashRingLog log(0x54534554);
+        ASSERT_TRUE(log.begin(partition, 0, 3));
+        for (uint32_t t = 1; t <= 300; t++) ASSERT_TRUE(log.append(recordAt(t)));
+    }
+
+    FlashRingLog log(0x54534554);
+    ASSERT_TRUE(log.begin(partition, 0, 3));
+    ASSERT_TRUE(log.append(recordAt(301)));
+    std::vector<HistoryRecord_t> records;
+    log.forEach(0, UINT32_MAX, collect, &records);
+    ASSERT_EQ(301u, records.size());
+    EXPECT_EQ(1u, records.front().time);
+    EXPECT_EQ(301u, records.back().time);
+
+    // Another magic shares nothing with it
+    FlashRingLog other(0x52485443);
+    ASSERT_TRUE(other.begin(partition, 0, 3));
+    records.clear();
+    other.forEach(0, UINT32_MAX, collect, &records);
+    EXPECT_TRUE(records.empty());
+}
+
+TEST(FlashRingLogTest, RejectsBadRanges) {
+    const esp_partition_t* partition = fake_partition_add("ringlog", 3 * HISTORY_SECTOR_SIZE);
+    FlashRingLog log(0x54534554);
+    EXPECT_FALSE(log.begin(partition, 0, 1));
+    EXPECT_FALSE(log.begin(partition, 2, 2));
+    EXPECT_FALSE(log.begin(nullptr, 0, 2));
+    EXPECT_FALSE(log.append(recordAt(1)));
+}
+
+// The writer task lives as long as the process, so one history is begun
+// once and checked through every tier
+TEST(LevelHistoryTest, AveragesIntoEveryTier) {
+    fake_nvs_reset();
+    fake_partition_add("history", 12 * HISTORY_SECTOR_SIZE);
+    ConfigStore config;
+    static LevelHistory history;
+    history.begin(&config);
+    uint32_t boots = 0;
+    EXPECT_TRUE(config.getU32("history", "boot_count", boots));
+    EXPECT_EQ(1u, boots);
+    EXPECT_TRUE(fake_nvs_contains("history", "boot_count"));
+
+    // Start on a minute boundary so every minute gets 60 samples
+    fake_timer_advance_us(60000000 - esp_timer_get_time() % 60000000);
+    for (int i = 0; i <= 180; i++) {
+        float levels[2] = {42.5f, (i % 2) ? NAN : 10.0f};
+        history.addSample(levels, 2);
+        fake_timer_advance_ms(1000);
+    }
+    float levels[2] = {42.5f, 10.0f};
+    history.addSample(levels, 2);  // Closes second 180 and with it the third minute
+
+    std::vector<HistoryRecord_t> seconds;
+    EXPECT_TRUE(history.forEach(1, 0, UINT32_MAX, collect, &seconds));
+    ASSERT_EQ(181u, seconds.size());
+    EXPECT_EQ(4250, seconds.back().level[0]);
+    EXPECT_EQ(1000, seconds[0].level[1]);
+    EXPECT_EQ(HISTORY_NO_DATA, seconds[1].level[1]);
+    EXPECT_EQ(HISTORY_NO_DATA, seconds.back().level[2]);
+    EXPECT_EQ(1, seconds.back().boot);
+    EXPECT_EQ(seconds[0].uptime + 180, seconds.back().uptime);
+    EXPECT_NE(0u, seconds.back().time);  // The host clock is set
+
+    std::vector<HistoryRecord_t> minutes;
+    ASSERT_TRUE(fake_wait_until([&] {
+        minutes.clear();
+        history.forEach(60, 0, UINT32_MAX, collect, &minutes);
+        return minutes.size() == 3;
+    }));
+    for (const HistoryRecord_t& minute : minutes) {
+        EXPECT_EQ(4250, minute.level[0]);
+        EXPECT_EQ(1000, minute.level[1]);  // Averaged over the valid half only
+        EXPECT_EQ(0u, minute.uptime % 60);
+    }
+    EXPECT_EQ(minutes[0].uptime + 120, minutes[2].uptime);
+
+    std::vector<HistoryRecord_t> hours;
+    history.forEach(3600, 0, UINT32_MAX, collect, &hours);
+    EXPECT_TRUE(hours.empty());
+}
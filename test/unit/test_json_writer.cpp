@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cmath>
+#include <string.h>
+#include "json_writer.h"
+
+TEST(JsonWriter, WritesNestedObjectsAndArrays) {
+    char buffer[128];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.key("name").string("tank \"A\"");
+    json.key("levels").beginArray().number(12.345f).number((uint32_t)7).endArray();
+    json.key("ok").boolean(true);
+    json.endObject();
+    EXPECT_TRUE(json.ok());
+    EXPECT_EQ(std::string("{\"name\":\"tank \\\"A\\\"\",\"levels\":[12.35,7],\"ok\":true}"), json.c_str());
+}
+
+TEST(JsonWriter, NonFiniteNumbersBecomeNull) {
+    char buffer[64];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginArray().number(NAN).number(INFINITY, 1).endArray();
+    EXPECT_EQ(std::string("[null,null]"), json.c_str());
+}
+
+TEST(JsonWriter, OverflowIsReportedAndTerminated) {
+    char buffer[16];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject().key("description").string("much longer than the buffer").endObject();
+    EXPECT_FALSE(json.ok());
+    EXPECT_LT(json.length(), sizeof(buffer));
+    EXPECT_EQ(strlen(buffer), json.length());
+}
+
+TEST(JsonWriter, UnbalancedNestingIsNotOk) {
+    char buffer[32];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject().key("a").beginArray();
+    EXPECT_FALSE(json.ok());
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <algorithm>
+#include "fake_can_transport.h"
+#include "n2k_can_driver.h"
+
+namespace {
+
+// Makes the tNMEA2000 frame hooks callable from the tests
+class TestDriver : public N2kCanDriver {
+public:
+    using N2kCanDriver::N2kCanDriver;
+    using N2kCanDriver::CANSendFrame;
+    using N2kCanDriver::CANGetFrame;
+};
+
+unsigned long n2kId(unsigned long pgn, unsigned char priority = 6, unsigned char source = 0x23) {
+    return ((unsigned long)priority << 26) | (pgn << 8) | source;
+}
+
+const unsigned long ReceivePgns[] = {127505, 130312, 0};
+
+uint32_t countOf(const PgnCounters<32>& counters, uint32_t pgn) {
+    for (size_t i = 0; i < counters.capacity(); i++) {
+        uint32_t slot_pgn, count;
+        if (counters.get(i, slot_pgn, count) && slot_pgn == pgn) return count;
+    }
+    return 0;
+}
+
+}  // namespace
+
+class N2kCanDriverTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fake_nvs_reset();
+        driver.ExtendReceiveMessages(ReceivePgns);
+        driver.Init();
+    }
+
+    FakeCanTransport transport;
+    ConfigStore config;
+    TestDriver driver{&transport, &config, 8};
+    const unsigned char data[8] = {0x40, 1, 2, 3, 4, 5, 6, 7};
+};
+
+TEST_F(N2kCanDriverTest, InitSetsTheFilterAndOpens) {
+    EXPECT_TRUE(driver.isOpen());
+    EXPECT_TRUE(transport.isOpen);
+    const std::vector<unsigned long>& pgns = transport.filterPgns;
+    EXPECT_NE(pgns.end(), std::find(pgns.begin(), pgns.end(), 127505ul));
+    EXPECT_NE(pgns.end(), std::find(pgns.begin(), pgns.end(), 130312ul));
+    EXPECT_NE(pgns.end(), std::find(pgns.begin(), pgns.end(), 60928ul));  // Address claim
+}
+
+TEST_F(N2kCanDriverTest, StaysClosedWhenTheTransportFails) {
+    FakeCanTransport broken;
+    broken.openResult = false;
+    TestDriver closed(&broken, &config);
+    closed.Init();
+    EXPECT_FALSE(closed.isOpen());
+    EXPECT_FALSE(closed.CANSendFrame(n2kId(127505), 8, data));
+    EXPECT_FALSE(closed.waitForFrame(0));
+}
+
+TEST_F(N2kCanDriverTest, SendsAndCountsByPgn) {
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(127505), 8, data));
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(127505, 6, 0x24), 8, data));
+    ASSERT_EQ(2u, transport.sent.size());
+    EXPECT_EQ(n2kId(127505), transport.sent[0].id);
+    EXPECT_EQ(0, memcmp(data, transport.sent[0].data, 8));
+    CanTxStats_t stats = driver.getTxStats();
+    EXPECT_EQ(2u, stats.sent);
+    EXPECT_EQ(0u, stats.queued);
+    EXPECT_EQ(2u, countOf(driver.getTxPgnCounters(), 127505));
+    EXPECT_FALSE(driver.CANSendFrame(n2kId(127505), 9, data));
+}
+
+TEST_F(N2kCanDriverTest, QueuesWhileBusyAndExpiresStaleFrames) {
+    transport.acceptFrames = false;
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(127505), 8, data));
+    EXPECT_TRUE(driver.hasPendingTx());
+    fake_timer_advance_ms(100);
+    driver.pumpTxQueue();
+    CanTxStats_t stats = driver.getTxStats();
+    EXPECT_EQ(2u, stats.retries);
+    EXPECT_EQ(1u, stats.queued);
+    EXPECT_EQ(1u, stats.queueHighWater);
+
+    fake_timer_advance_ms(150);
+    driver.pumpTxQueue();
+    stats = driver.getTxStats();
+    EXPECT_EQ(1u, stats.dropped);
+    EXPECT_EQ(0u, stats.queued);
+    EXPECT_TRUE(transport.sent.empty());
+}
+
+TEST_F(N2kCanDriverTest, StartedFastPacketsNeverExpire) {
+    unsigned char first[8] = {0x40, 20, 1, 2, 3, 4, 5, 6};
+    unsigned char second[8] = {0x41, 7, 8, 9, 10, 11, 12, 13};
+    unsigned char third[8] = {0x42, 14, 15, 16, 17, 18, 19, 20};
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(126996), 8, first));
+    transport.acceptFrames = false;
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(126996), 8, second));
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(126996), 8, third));
+
+    fake_timer_advance_ms(1000);
+    driver.pumpTxQueue();
+    EXPECT_EQ(0u, driver.getTxStats().dropped);
+    EXPECT_EQ(2u, driver.getTxStats().queued);
+
+    transport.acceptFrames = true;
+    driver.pumpTxQueue();
+    ASSERT_EQ(3u, transport.sent.size());
+    EXPECT_EQ(0x42, transport.sent[2].data[0]);
+}
+
+TEST_F(N2kCanDriverTest, FullQueueRejectsLessUrgentFrames) {
+    transport.acceptFrames = false;
+    for (int i = 0; i < 10; i++) driver.CANSendFrame(n2kId(127505), 8, data);
+    CanTxStats_t stats = driver.getTxStats();
+    EXPECT_EQ(8u, stats.queued);
+    EXPECT_EQ(8u, stats.queueHighWater);
+    EXPECT_EQ(2u, stats.dropped);
+
+    EXPECT_TRUE(driver.CANSendFrame(n2kId(126992, 3), 8, data));  // Evicts a level frame
+    EXPECT_EQ(3u, driver.getTxStats().dropped);
+    transport.acceptFrames = true;
+    driver.pumpTxQueue();
+    ASSERT_EQ(8u, transport.sent.size());
+    EXPECT_EQ(n2kId(126992, 3), transport.sent[0].id);
+}
+
+TEST_F(N2kCanDriverTest, CountsReceivedFrames) {
+    transport.receive(n2kId(127505, 6, 0x10), 8, data);
+    transport.receive(n2kId(130312, 5, 0x11), 8, data);
+    EXPECT_TRUE(driver.waitForFrame(0));
+    unsigned long id;
+    unsigned char len;
+    unsigned char buf[8];
+    EXPECT_TRUE(driver.CANGetFrame(id, len, buf));
+    EXPECT_EQ(n2kId(127505, 6, 0x10), id);
+    EXPECT_EQ(8, len);
+    EXPECT_TRUE(driver.CANGetFrame(id, len, buf));
+    EXPECT_FALSE(driver.CANGetFrame(id, len, buf));
+    EXPECT_EQ(2u, driver.getRxFrameCount());
+    EXPECT_EQ(1u, countOf(driver.getRxPgnCounters(), 130312));
+}
+
+TEST_F(N2kCanDriverTest, ClampsAndPersistsSettings) {
+    driver.setTransmissionInterval(100);
+    EXPECT_EQ(500u, driver.getTransmissionInterval());
+    driver.setTransmissionInterval(60000);
+    EXPECT_EQ(10000u, driver.getTransmissionInterval());
+    driver.setMinTransmissionInterval(20);
+    EXPECT_EQ(100u, driver.getMinTransmissionInterval());
+    driver.setLevelDeadband(0.0f);
+    EXPECT_FLOAT_EQ(0.1f, driver.getLevelDeadband());
+    driver.setLevelDeadband(40.0f);
+    EXPECT_FLOAT_EQ(25.0f, driver.getLevelDeadband());
+    driver.setLevelDeadband(1.5f);
+    driver.setTransmissionInterval(2000);
+    driver.setMinTransmissionInterval(5000);
+    driver.setDeviceName("A device name well past thirty-one characters");
+    EXPECT_EQ(31u, driver.getDeviceName().size());
+
+    TxScheduleSettings_t schedule = driver.getTxSchedule();
+    EXPECT_EQ(2000u, schedule.maxIntervalMs);
+    EXPECT_EQ(2000u, schedule.minIntervalMs);  // Never above the maximum
+    EXPECT_FLOAT_EQ(1.5f, schedule.deadband);
+
+    config.flush();
+    EXPECT_TRUE(fake_nvs_contains("nmea_config", "tx_deadband"));
+    ConfigStore reloaded;
+    FakeCanTransport other;
+    TestDriver restored(&other, &reloaded);
+    restored.loadSettings();
+    EXPECT_EQ(2000u, restored.getTransmissionInterval());
+    EXPECT_EQ(5000u, restored.getMinTransmissionInterval());
+    EXPECT_FLOAT_EQ(1.5f, restored.getLevelDeadband());
+    EXPECT_EQ(driver.getDeviceName(), restored.getDeviceName());
+}
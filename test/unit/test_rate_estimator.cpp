@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "rate_estimator.h"
+
+static const uint32_t Step = RATE_WINDOW_MS / RATE_WINDOW_SAMPLES;
+
+TEST(RateEstimator, UnknownUntilTheWindowSpansAMinute) {
+    RateEstimator rate;
+    uint32_t t = 0;
+    for (; t < RATE_MIN_SPAN_MS; t += Step) rate.addSample(50.0f, 1000 + t);
+    EXPECT_TRUE(std::isnan(rate.getRatePercentPerHour()));
+    rate.addSample(50.0f, 1000 + t);
+    EXPECT_NEAR(0.0f, rate.getRatePercentPerHour(), 1e-3);
+}
+
+TEST(RateEstimator, SlopeOfALinearDrain) {
+    RateEstimator rate;
+    const float per_hour = -12.0f;
+    for (uint32_t t = 0; t <= 2 * RATE_WINDOW_MS; t += Step) {
+        rate.addSample(80.0f + per_hour * t / 3600000.0f, 5000 + t);
+    }
+    EXPECT_NEAR(per_hour, rate.getRatePercentPerHour(), 0.01f);
+    EXPECT_NEAR(5.0f, rate.hoursUntil(20.0f, -40.0f), 0.01f);  // 60 % at 12 %/h
+    EXPECT_TRUE(std::isnan(rate.hoursUntil(20.0f, 90.0f)));    // Moving away
+}
+
+TEST(RateEstimator, SamplesCloserThanTheStepAreSkipped) {
+    RateEstimator rate;
+    rate.addSample(10.0f, 0);
+    for (uint32_t t = 1; t < Step; t += 100) rate.addSample(90.0f, t);
+    for (uint32_t t = Step; t <= RATE_MIN_SPAN_MS + Step; t += Step) rate.addSample(10.0f, t);
+    EXPECT_NEAR(0.0f, rate.getRatePercentPerHour(), 1e-3);
+}
+
+TEST(RateEstimator, StableLevelHasNoTimeToTarget) {
+    RateEstimator rate;
+    for (uint32_t t = 0; t <= RATE_WINDOW_MS; t += Step) rate.addSample(50.0f + 0.1f * t / 3600000.0f, t);
+    EXPECT_TRUE(std::isnan(rate.hoursUntil(50.0f, 90.0f)));
+}
+
+TEST(RateEstimator, IgnoresNonFiniteLevels) {
+    RateEstimator rate;
+    for (uint32_t t = 0; t <= RATE_MIN_SPAN_MS + Step; t += Step) {
+        rate.addSample(NAN, t);
+        rate.addSample(30.0f, t);
+    }
+    EXPECT_NEAR(0.0f, rate.getRatePercentPerHour(), 1e-3);
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+#include <cmath>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "tank.h"
+#include "ultrasonic.h"
+
+static TankSettings_t shapedSettings(const char* shape) {
+    TankSettings_t settings;
+    strncpy(settings.tank_shape, shape, sizeof(settings.tank_shape) - 1);
+    settings.tank_height = 100.0f;
+    settings.sensor_offset = 10.0f;
+    settings.buildGeometry();
+    return settings;
+}
+
+TEST(TankSettings, RectangularLevelIsLinearBelowTheOffset) {
+    TankSettings_t settings = shapedSettings("rectangular");
+    EXPECT_NEAR(100.0f, settings.levelPercentage(10.0f), 1e-4);
+    EXPECT_NEAR(100.0f, settings.levelPercentage(2.0f), 1e-4);  // Above the offset
+    EXPECT_NEAR(50.0f, settings.levelPercentage(55.0f), 1e-4);
+    EXPECT_NEAR(0.0f, settings.levelPercentage(100.0f), 1e-4);
+}
+
+TEST(TankSettings, ShapedLevelFollowsTheModel) {
+    TankSettings_t settings = shapedSettings("cylindrical laying flat");
+    const TankShapeModel* model = findTankShape("cylindrical laying flat");
+    EXPECT_NEAR(50.0f, settings.levelPercentage(55.0f), 0.1f);
+    EXPECT_NEAR(100.0 * model->fill(0.2, 0), settings.levelPercentage(82.0f), 0.2f);
+}
+
+TEST(TankSettings, CustomShapeUsesTheCalibrationTable) {
+    TankSettings_t settings = shapedSettings("custom");
+    settings.custom_transfer.build({{0, 100}, {45, 50}, {90, 0}});
+    EXPECT_NEAR(50.0f, settings.levelPercentage(55.0f), 1e-3);
+}
+
+TEST(TankSettings, TiltCorrection) {
+    TankSettings_t settings;
+    settings.sensor_forward = 50.0f;
+    settings.sensor_starboard = -20.0f;
+    EXPECT_FLOAT_EQ(40.0f, settings.tiltCorrectedDistance(40.0f, 0, 0));
+    float pitch = 0.1f;
+    EXPECT_NEAR(40.0f - 50.0f * std::tan(pitch), settings.tiltCorrectedDistance(40.0f, pitch, 0), 1e-4);
+    EXPECT_FLOAT_EQ(40.0f, settings.tiltCorrectedDistance(40.0f, 1.0f, 0));  // Beyond 45 degrees
+}
+
+TEST(Tank, LevelFromTheSensorBeforeTheFirstUpdate) {
+    Ultrasonic sensor;
+    Tank tank;
+    EXPECT_TRUE(std::isnan(tank.getLevelPercentage()));
+    tank.sensor = &sensor;
+    tank.publishSettings(shapedSettings("rectangular"));
+    EXPECT_TRUE(std::isnan(tank.getLevelPercentage()));  // No echo yet
+    EXPECT_TRUE(std::isnan(tank.getTankVolumeLiters()));
+    sensor.setDistance(55.0f);
+    EXPECT_NEAR(50.0f, tank.getLevelPercentage(), 1e-4);
+}
+
+TEST(Tank, LevelIsUnknownOnceTheSensorGoesQuiet) {
+    Ultrasonic sensor;
+    Tank tank;
+    tank.sensor = &sensor;
+    tank.publishSettings(shapedSettings("rectangular"));
+    sensor.setDistance(55.0f);
+    tank.update();
+    fake_timer_advance_ms(30000);
+    EXPECT_NEAR(50.0f, tank.getLevelPercentage(), 1e-4);
+    fake_timer_advance_ms(1);
+    EXPECT_TRUE(std::isnan(tank.getLevelPercentage()));
+    sensor.setDistance(10.0f);
+    tank.update();
+    EXPECT_NEAR(100.0f, tank.getLevelPercentage(), 1e-4);
+}
+
+TEST(Tank, AveragingSmoothsUpdates) {
+    Ultrasonic sensor;
+    Tank tank;
+    tank.sensor = &sensor;
+    TankSettings_t settings = shapedSettings("rectangular");
+    settings.average_seconds = 10;
+    tank.publishSettings(settings);
+
+    sensor.setDistance(55.0f);
+    tank.update();
+    sensor.setDistance(10.0f);
+    fake_timer_advance_ms(10000);
+    tank.update();
+    float expected = 55.0f + (1.0f - std::exp(-1.0f)) * (10.0f - 55.0f);
+    EXPECT_NEAR(100.0f - (expected - 10.0f) * 100.0f / 90.0f, tank.getLevelPercentage(), 0.01f);
+}
+
+TEST(Tank, BeginUpdateEditsACopy) {
+    Tank tank;
+    TankSettings_t& next = tank.beginUpdate();
+    next.tank_volume = 250.0f;
+    EXPECT_EQ(100.0f, tank.settings()->tank_volume);
+    tank.commitUpdate();
+    EXPECT_EQ(250.0f, tank.settings()->tank_volume);
+}
+
+TEST(Tank, ReadersNeverSeeTornSettings) {
+    Tank tank;
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::thread reader([&] {
+        while (!stop) {
+            TankSettingsRef settings = tank.settings();
+            if (settings->tank_volume != settings->tank_height) torn++;
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        TankSettings_t& next = tank.beginUpdate();
+        next.tank_height = next.tank_volume = (float)i;
+        tank.commitUpdate();
+    }
+    stop = true;
+    reader.join();
+    EXPECT_EQ(0, torn.load());
+}
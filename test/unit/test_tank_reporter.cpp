@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <vector>
+#include "N2kMessages.h"
+#include "can_filter.h"
+#include "fake_can_transport.h"
+#include "fake_freertos.h"
+#include "tank_reporter.h"
+#include "ultrasonic.h"
+
+namespace {
+
+// Records the clock instead of setting the host's
+class TestReporter : public TankReporter {
+public:
+    using TankReporter::TankReporter;
+    std::vector<time_t> clockSet;
+
+protected:
+    void setClock(time_t now) override { clockSet.push_back(now); }
+};
+
+}  // namespace
+
+class TankReporterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fake_nvs_reset();
+        fake_timer_advance_ms(1000);  // Well past boot, where AttitudeSlot treats 0 ms as never
+        driver.SetDeviceInformation(123457, 130, 75, 2046);
+        driver.Init();
+        for (size_t i = 0; i < MAX_TANKS; i++) {
+            TankSettings_t& settings = web.getTank(i).beginUpdate();
+            settings.instance = i;
+            strcpy(settings.tank_shape, "rectangular");
+            settings.tank_height = 100.0f;
+            settings.sensor_offset = 0.0f;
+            settings.buildGeometry();
+            web.getTank(i).commitUpdate();
+        }
+        reporter.resetSchedules(nowMs());
+    }
+
+    static uint32_t nowMs() { return esp_timer_get_time() / 1000; }
+
+    // num_tanks and temp_source as if saved from the config page
+    void loadConfig(uint32_t num_tanks, uint32_t temperature_source) {
+        config.setU32("n2k_config", "num_tanks", num_tanks);
+        config.setU32("n2k_config", "temp_source", temperature_source);
+        web.loadSettingFromNVS();
+    }
+
+    void measure(size_t tank, float distance) {
+        sensors[tank].setDistance(distance);
+        web.getTank(tank).update();
+    }
+
+    // Through the echo path, as ultrasonic_task does; 900 cm is a no-echo timeout
+    void echo(size_t tank, float distance) {
+        EchoRingBuffer samples;
+        samples.push(Ultrasonic::distanceToPulse(distance, 1000000, Ultrasonic::speedOfSound(Ultrasonic::DEFAULT_AIR_TEMPERATURE)));
+        if (sensors[tank].consumeEchoes(samples, 1000000)) web.getTank(tank).update();
+    }
+
+    // The single-frame PGN 127505 messages sent so far
+    std::vector<tN2kMsg> fluidLevels() const {
+        std::vector<tN2kMsg> messages;
+        for (const CanFrame& frame : transport.sent) {
+            if (n2kPgnFromId(frame.id) != 127505) continue;
+            tN2kMsg msg;
+            msg.SetPGN(127505);
+            msg.DataLen = frame.len;
+            memcpy(msg.Data, frame.data, frame.len);
+            messages.push_back(msg);
+        }
+        return messages;
+    }
+
+    // Fast-packet messages of pgn sent so far, counted by their first frames
+    size_t messagesOf(uint32_t pgn) const {
+        size_t count = 0;
+        for (const CanFrame& frame : transport.sent) {
+            if (n2kPgnFromId(frame.id) == pgn && (frame.data[0] & 0x1F) == 0) count++;
+        }
+        return count;
+    }
+
+    uint64_t ourName() { return driver.GetDeviceInformation().GetName(); }
+
+    ConfigStore config;
+    FakeCanTransport transport;
+    N2kCanDriver driver{&transport, &config};
+    Ultrasonic sensors[MAX_TANKS];
+    WebServer web{&driver, &config, nullptr, sensors, MAX_TANKS};
+    TxScheduler schedulers[MAX_TANKS];
+    TestReporter reporter{&driver, &web, schedulers};
+};
+
+TEST_F(TankReporterTest, SendsNotAvailableBeforeTheFirstEcho) {
+    reporter.sendFluidLevel();
+    std::vector<tN2kMsg> sent = fluidLevels();
+    ASSERT_EQ(1u, sent.size());
+    unsigned char instance;
+    tN2kFluidType type;
+    double level, capacity;
+    ASSERT_TRUE(ParseN2kFluidLevel(sent[0], instance, type, level, capacity));
+    EXPECT_TRUE(N2kIsNA(level));
+    EXPECT_TRUE(N2kIsNA(capacity));
+}
+
+TEST_F(TankReporterTest, SendsTheMeasuredLevel) {
+    measure(0, 55.0f);
+    reporter.sendFluidLevel();
+    std::vector<tN2kMsg> sent = fluidLevels();
+    ASSERT_EQ(1u, sent.size());
+    unsigned char instance;
+    tN2kFluidType type;
+    double level, capacity;
+    ASSERT_TRUE(ParseN2kFluidLevel(sent[0], instance, type, level, capacity));
+    EXPECT_NEAR(0.45, level, 0.004);
+    EXPECT_NEAR(45.0, capacity, 0.1);  // 100 l tank
+}
+
+TEST_F(TankReporterTest, SendsOneTankPerPass) {
+    loadConfig(2, TEMPERATURE_SOURCE_NONE);
+    measure(0, 50.0f);
+    measure(1, 20.0f);
+    fake_timer_advance_ms(driver.getTransmissionInterval());  // Both heartbeats due
+
+    EXPECT_GE(reporter.sendFluidLevel(), TankReporter::FrameGapMs);
+    EXPECT_EQ(1u, fluidLevels().size());
+    reporter.sendFluidLevel();
+    reporter.sendFluidLevel();  // Nothing left to send
+    std::vector<tN2kMsg> sent = fluidLevels();
+    ASSERT_EQ(2u, sent.size());
+    unsigned char instances[2];
+    for (size_t i = 0; i < 2; i++) {
+        tN2kFluidType type;
+        double level, capacity;
+        ASSERT_TRUE(ParseN2kFluidLevel(sent[i], instances[i], type, level, capacity));
+    }
+    EXPECT_EQ(0, instances[0]);
+    EXPECT_EQ(1, instances[1]);
+}
+
+TEST_F(TankReporterTest, TakesTheAirTemperatureFromTheConfiguredSource) {
+    tN2kMsg msg;
+    SetN2kTemperature(msg, 1, 0, N2kts_MainCabinTemperature, CToKelvin(35.0));
+    reporter.handleMessage(msg);
+    EXPECT_FLOAT_EQ(Ultrasonic::DEFAULT_AIR_TEMPERATURE, sensors[0].getAirTemperature());  // No source set
+
+    loadConfig(1, N2kts_MainCabinTemperature);
+    reporter.handleMessage(msg);
+    for (Ultrasonic& sensor : sensors) {
+        EXPECT_NEAR(35.0f, sensor.getAirTemperature(), 0.01f);
+    }
+
+    SetN2kTemperature(msg, 1, 0, N2kts_SeaTemperature, CToKelvin(10.0));
+    reporter.handleMessage(msg);
+    EXPECT_NEAR(35.0f, sensors[0].getAirTemperature(), 0.01f);
+
+    SetN2kTemperatureExt(msg, 1, 0, N2kts_MainCabinTemperature, CToKelvin(30.0));
+    reporter.handleMessage(msg);
+    EXPECT_NEAR(30.0f, sensors[0].getAirTemperature(), 0.01f);
+}
+
+TEST_F(TankReporterTest, AttitudeCorrectsEveryTank) {
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        TankSettings_t& settings = web.getTank(i).beginUpdate();
+        settings.sensor_forward = 50.0f;
+        web.getTank(i).commitUpdate();
+    }
+    tN2kMsg msg;
+    SetN2kAttitude(msg, 1, 0.0, 0.1, 0.0);
+    reporter.handleMessage(msg);
+    fake_timer_advance_ms(10);  // The next measurement comes later
+
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        measure(i, 50.0f);
+        TankSettingsRef settings = web.getTank(i).settings();
+        float expected = settings->levelPercentage(settings->tiltCorrectedDistance(50.0f, 0.1f, 0.0f));
+        EXPECT_NEAR(expected, web.getTank(i).getLevelPercentage(), 0.01f) << i;
+        EXPECT_GT(web.getTank(i).getLevelPercentage(), 50.5f) << i;
+    }
+}
+
+TEST_F(TankReporterTest, SetsTheClockOnlyWhenItIsOff) {
+    time_t now = time(NULL);
+    tN2kMsg msg;
+    SetN2kSystemTime(msg, 1, now / 86400, now % 86400);
+    reporter.handleMessage(msg);
+    EXPECT_TRUE(reporter.clockSet.empty());
+
+    SetN2kSystemTime(msg, 1, 19000, 3600.0);
+    reporter.handleMessage(msg);
+    ASSERT_EQ(1u, reporter.clockSet.size());
+    EXPECT_EQ((time_t)19000 * 86400 + 3600, reporter.clockSet[0]);
+}
+
+TEST_F(TankReporterTest, LowLevelRaisesAnAlert) {
+    echo(0, 95.0f);  // 5 %, low alarm at 10 %
+    reporter.sendAlerts();
+    EXPECT_EQ(1u, messagesOf(126983));
+    EXPECT_EQ(1u, messagesOf(126985));
+    EXPECT_TRUE(web.getTank(0).low_alert.active());
+    EXPECT_FALSE(web.getTank(0).high_alert.active());
+
+    uint32_t wait_ms = reporter.sendAlerts();  // Status repeats later, text only once
+    EXPECT_GT(wait_ms, 0u);
+    EXPECT_LE(wait_ms, TankReporter::MaxSleepMs);
+    EXPECT_EQ(1u, messagesOf(126983));
+}
+
+TEST_F(TankReporterTest, NoAlertWithoutAnEcho) {
+    loadConfig(MAX_TANKS, TEMPERATURE_SOURCE_NONE);
+    for (size_t i = 0; i < MAX_TANKS; i++) echo(i, 900.0f);
+    EXPECT_EQ(TankReporter::MaxSleepMs, reporter.sendAlerts());
+    EXPECT_EQ(0u, messagesOf(126983));
+    for (size_t i = 0; i < MAX_TANKS; i++) {
+        EXPECT_FALSE(web.getTank(i).low_alert.active()) << i;
+        EXPECT_FALSE(web.getTank(i).high_alert.active()) << i;
+    }
+}
+
+TEST_F(TankReporterTest, QuietSensorStopsRepeatingItsAlert) {
+    echo(0, 95.0f);
+    reporter.sendAlerts();
+    size_t statuses = messagesOf(126983);
+    fake_timer_advance_ms(30001);  // No echo since, the level is unknown
+    EXPECT_EQ(TankReporter::MaxSleepMs, reporter.sendAlerts());
+    EXPECT_EQ(statuses, messagesOf(126983));
+}
+
+TEST_F(TankReporterTest, AcknowledgesOurOwnAlertsOnly) {
+    echo(0, 95.0f);
+    reporter.sendAlerts();
+    size_t statuses = messagesOf(126983);
+
+    tN2kMsg msg;
+    SetN2kAlertResponse(msg, N2kts_AlertTypeWarning, N2kts_AlertCategoryTechnical, 0, 0, 1, ourName() + 1, 0, 0, 1,
+                        0x42, N2kts_AlertResponseAcknowledge);
+    reporter.handleMessage(msg);
+    EXPECT_EQ(statuses, messagesOf(126983));
+    EXPECT_EQ(N2kts_AlertStateActive, web.getTank(0).low_alert.state(nowMs()));
+
+    SetN2kAlertResponse(msg, N2kts_AlertTypeWarning, N2kts_AlertCategoryTechnical, 0, 0, 1, ourName(), 0, 0, 1,
+                        0x42, N2kts_AlertResponseAcknowledge);
+    reporter.handleMessage(msg);
+    EXPECT_EQ(statuses + 1, messagesOf(126983));  // The new state goes out at once
+    EXPECT_EQ(N2kts_AlertStateAcknowledged, web.getTank(0).low_alert.state(nowMs()));
+}
+
+namespace {
+
+struct RxSide {
+    CanRxHandoff* handoff;
+    TaskHandle_t nmea_task;
+    std::atomic<int> answered{-1};
+    std::atomic<uint32_t> extra{UINT32_MAX};
+};
+
+void rxTask(void* arg) {
+    RxSide* rx = (RxSide*)arg;
+    rx->answered = rx->handoff->handOff(rx->nmea_task, 2000);
+    rx->extra = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+    vTaskDelete(NULL);
+}
+
+}  // namespace
+
+TEST(CanRxHandoff, AnswersOnlyAWaitingRxTask) {
+    CanRxHandoff handoff;
+    RxSide rx;
+    rx.handoff = &handoff;
+    rx.nmea_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    TaskHandle_t rx_task;
+    xTaskCreate(rxTask, "can_rx_task", 3072, &rx, 5, &rx_task);
+    EXPECT_EQ(1u, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2000)));  // Woken by the hand-off
+    handoff.answer(rx_task);
+    handoff.answer(rx_task);  // A second pass without new frames
+    ASSERT_TRUE(fake_wait_until([&] { return rx.extra.load() != UINT32_MAX; }));
+    EXPECT_EQ(1, rx.answered.load());
+    EXPECT_EQ(0u, rx.extra.load());  // No answer left pending
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <driver/twai.h>
+#include <string.h>
+#include "can_filter.h"
+#include "twai_transport.h"
+
+namespace {
+
+// Receive list of main.cpp
+const unsigned long ApplicationPgns[] = {126984, 126992, 127257, 127505, 130312, 130316, 0};
+
+// PDU1 PGNs carry the destination in the low byte
+unsigned long n2kId(unsigned long pgn, unsigned char priority, unsigned char source, unsigned char destination = 0xFF) {
+    if (((pgn >> 8) & 0xFF) < 240) pgn = (pgn & ~0xFFul) | destination;
+    return ((unsigned long)priority << 26) | (pgn << 8) | source;
+}
+
+const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+}  // namespace
+
+class TwaiTransportTest : public ::testing::Test {
+protected:
+    void SetUp() override { fake_twai_reset(); }
+
+    bool onBus(unsigned long id) { return fake_twai_bus_frame(id, true, 8, payload); }
+};
+
+TEST_F(TwaiTransportTest, HardwareFilterPassesEveryListedPgn) {
+    TwaiTransport transport;
+    std::vector<unsigned long> pgns = n2kReceivePgns(ApplicationPgns);
+    transport.setReceiveFilter(pgns);
+    ASSERT_TRUE(transport.open());
+    ASSERT_NE(nullptr, fake_twai_filter());
+    EXPECT_FALSE(fake_twai_filter()->single_filter);
+
+    for (unsigned long pgn : pgns) {
+        for (unsigned char priority : {2, 3, 6, 7}) {
+            for (unsigned char source : {0x00, 0x23, 0xFD}) {
+                EXPECT_TRUE(onBus(n2kId(pgn, priority, source, 0x42))) << pgn;
+                EXPECT_TRUE(onBus(n2kId(pgn, priority, source, 0xFF))) << pgn;
+                unsigned long id;
+                unsigned char len;
+                unsigned char buf[8];
+                while (transport.getFrame(id, len, buf)) {}
+            }
+        }
+    }
+
+    EXPECT_FALSE(onBus(n2kId(65280, 6, 0x23)));   // Proprietary PDU2, data page 0
+    EXPECT_FALSE(onBus(n2kId(61444, 3, 0x00)));   // J1939 engine speed
+    EXPECT_FALSE(onBus(n2kId(130900, 6, 0x23)));  // PDU specific 0x54
+    EXPECT_FALSE(onBus(n2kId(65360, 6, 0x23)));
+}
+
+TEST_F(TwaiTransportTest, SingleGroupUsesTheSingleFilter) {
+    TwaiTransport transport;
+    transport.setReceiveFilter({127505, 127508});
+    ASSERT_TRUE(transport.open());
+    EXPECT_TRUE(fake_twai_filter()->single_filter);
+    EXPECT_TRUE(onBus(n2kId(127505, 6, 0x10)));
+    EXPECT_TRUE(onBus(n2kId(127508, 6, 0x10)));
+    EXPECT_FALSE(onBus(n2kId(130312, 6, 0x10)));
+}
+
+TEST_F(TwaiTransportTest, OpenAndCloseManageTheDriver) {
+    {
+        TwaiTransport transport;
+        ASSERT_TRUE(transport.open());
+        ASSERT_NE(nullptr, fake_twai_filter());
+        EXPECT_EQ(0xFFFFFFFFu, fake_twai_filter()->acceptance_mask);  // No list, accept all
+        transport.close();
+        EXPECT_EQ(nullptr, fake_twai_filter());
+        ASSERT_TRUE(transport.open());
+    }
+    EXPECT_EQ(nullptr, fake_twai_filter());  // Closed by the destructor
+
+    TwaiTransport closed;
+    CanBusStatus_t status;
+    EXPECT_FALSE(closed.getBusStatus(status));
+    EXPECT_FALSE(closed.sendFrame(n2kId(127505, 6, 0x23), 8, payload, false));
+    EXPECT_FALSE(closed.waitForFrame(0));
+}
+
+TEST_F(TwaiTransportTest, SendsExtendedFrames) {
+    TwaiTransport transport;
+    ASSERT_TRUE(transport.open());
+    EXPECT_TRUE(transport.sendFrame(n2kId(127505, 6, 0x23), 8, payload, false));
+    twai_message_t sent[2];
+    ASSERT_EQ(1u, fake_twai_transmitted(sent, 2));
+    EXPECT_EQ(n2kId(127505, 6, 0x23), sent[0].identifier);
+    EXPECT_TRUE(sent[0].extd);
+    EXPECT_EQ(8, sent[0].data_length_code);
+    EXPECT_EQ(0, memcmp(payload, sent[0].data, 8));
+
+    fake_twai_fail_transmit(true);
+    EXPECT_FALSE(transport.sendFrame(n2kId(127505, 6, 0x23), 8, payload, true));
+}
+
+TEST_F(TwaiTransportTest, ReceivesOnlyExtendedFrames) {
+    TwaiTransport transport;
+    ASSERT_TRUE(transport.open());
+    EXPECT_FALSE(transport.waitForFrame(10));
+
+    ASSERT_TRUE(fake_twai_bus_frame(0x123, false, 8, payload));
+    ASSERT_TRUE(onBus(n2kId(127505, 6, 0x10)));
+    ASSERT_TRUE(onBus(n2kId(130312, 5, 0x11)));
+    EXPECT_TRUE(transport.waitForFrame(10));
+
+    unsigned long id;
+    unsigned char len;
+    unsigned char buf[8];
+    ASSERT_TRUE(transport.getFrame(id, len, buf));
+    EXPECT_EQ(n2kId(127505, 6, 0x10), id);
+    EXPECT_EQ(8, len);
+    EXPECT_EQ(0, memcmp(payload, buf, 8));
+    ASSERT_TRUE(transport.getFrame(id, len, buf));
+    EXPECT_EQ(n2kId(130312, 5, 0x11), id);
+    EXPECT_FALSE(transport.getFrame(id, len, buf));
+
+    CanBusStatus_t status;
+    ASSERT_TRUE(transport.getBusStatus(status));
+    EXPECT_STREQ("running", status.state);
+    EXPECT_EQ(3u, status.rxQueueHighWater);
+}
+
+TEST_F(TwaiTransportTest, FullRxQueueCountsMissedFrames) {
+    TwaiTransport transport;
+    ASSERT_TRUE(transport.open());
+    for (int i = 0; i < 20; i++) onBus(n2kId(127505, 6, 0x10));
+    EXPECT_TRUE(transport.waitForFrame(10));
+    CanBusStatus_t status;
+    ASSERT_TRUE(transport.getBusStatus(status));
+    EXPECT_EQ(4u, status.rxMissed);
+    EXPECT_EQ(16u, status.rxQueueHighWater);
+}
+
+TEST_F(TwaiTransportTest, RecoversFromBusOff) {
+    TwaiTransport transport;
+    ASSERT_TRUE(transport.open());
+
+    fake_twai_set_state(TWAI_STATE_BUS_OFF);
+    fake_twai_raise_alerts(TWAI_ALERT_BUS_OFF);
+    EXPECT_FALSE(transport.waitForFrame(10));
+    EXPECT_EQ(1u, transport.getBusOffCount());
+    EXPECT_TRUE(fake_twai_recovery_started());
+    CanBusStatus_t status;
+    ASSERT_TRUE(transport.getBusStatus(status));
+    EXPECT_STREQ("recovering", status.state);
+    EXPECT_FALSE(transport.sendFrame(n2kId(127505, 6, 0x23), 8, payload, false));
+
+    fake_twai_set_state(TWAI_STATE_STOPPED);  // The controller stops once recovery completes
+    fake_twai_raise_alerts(TWAI_ALERT_BUS_RECOVERED);
+    EXPECT_FALSE(transport.waitForFrame(10));
+    ASSERT_TRUE(transport.getBusStatus(status));
+    EXPECT_STREQ("running", status.state);
+    EXPECT_TRUE(transport.sendFrame(n2kId(127505, 6, 0x23), 8, payload, false));
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "tx_scheduler.h"
+
+static const TxScheduleSettings_t settings = {0.5f, 250, 2000};
+
+TEST(TxScheduler, FirstFrameWaitsForTheFirstDueTime) {
+    TxScheduler scheduler;
+    scheduler.reset(1000);
+    EXPECT_FALSE(scheduler.due(50.0f, 999, settings));
+    EXPECT_EQ(1u, scheduler.msUntilDue(50.0f, 999, settings));
+    EXPECT_TRUE(scheduler.due(50.0f, 1000, settings));
+}
+
+TEST(TxScheduler, StableLevelSendsAHeartbeat) {
+    TxScheduler scheduler;
+    scheduler.sent(50.0f, 10000);
+    EXPECT_FALSE(scheduler.due(50.1f, 11999, settings));
+    EXPECT_EQ(2000u, scheduler.msUntilDue(50.1f, 10000, settings));
+    EXPECT_TRUE(scheduler.due(50.1f, 12000, settings));
+}
+
+TEST(TxScheduler, ChangeBeyondTheDeadbandWaitsForTheMinimumInterval) {
+    TxScheduler scheduler;
+    scheduler.sent(50.0f, 10000);
+    EXPECT_FALSE(scheduler.due(51.0f, 10100, settings));
+    EXPECT_EQ(150u, scheduler.msUntilDue(51.0f, 10100, settings));
+    EXPECT_TRUE(scheduler.due(51.0f, 10250, settings));
+    EXPECT_TRUE(scheduler.due(49.5f, 10250, settings));
+}
+
+TEST(TxScheduler, HandlesTimerWraparound) {
+    TxScheduler scheduler;
+    scheduler.sent(50.0f, 0xFFFFFF00u);
+    EXPECT_FALSE(scheduler.due(50.0f, 0x00000100u, settings));
+    EXPECT_TRUE(scheduler.due(50.0f, 0x00000700u, settings));
+}
+
+TEST(TxScheduler, LosingOrRegainingTheReadingIsAChange) {
+    TxScheduler scheduler;
+    scheduler.sent(50.0f, 10000);
+    EXPECT_TRUE(scheduler.due(NAN, 10250, settings));
+    scheduler.sent(NAN, 10250);
+    EXPECT_FALSE(scheduler.due(NAN, 10500, settings));
+    EXPECT_EQ(2000u - 250u, scheduler.msUntilDue(NAN, 10500, settings));
+    EXPECT_TRUE(scheduler.due(50.0f, 10500, settings));
+}
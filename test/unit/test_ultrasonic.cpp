@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+#include <cmath>
+#include "ultrasonic.h"
+
+TEST(Ultrasonic, PulseAndDistanceRoundTrip) {
+    for (float distance : {5.0f, 42.0f, 250.0f}) {
+        uint32_t pulse = Ultrasonic::distanceToPulse(distance, 1000000);
+        EXPECT_NEAR(distance, Ultrasonic::pulseToDistance(pulse, 1000000), 0.02f);
+    }
+}
+
+TEST(Ultrasonic, SpeedOfSoundFollowsTemperature) {
+    EXPECT_NEAR(0.03313f, Ultrasonic::speedOfSound(0.0f), 1e-6);
+    EXPECT_NEAR(0.0343f, Ultrasonic::speedOfSound(20.0f), 1e-4);
+    EXPECT_GT(Ultrasonic::speedOfSound(30.0f), Ultrasonic::speedOfSound(10.0f));
+}
+
+TEST(Ultrasonic, SetDistanceClamps) {
+    Ultrasonic sensor;
+    sensor.setDistance(-3.0f);
+    EXPECT_EQ(0.0f, sensor.getDistance());
+    sensor.setDistance(1000.0f);
+    EXPECT_EQ(400.0f, sensor.getDistance());
+}
+
+TEST(Ultrasonic, NoReadingUntilAnEchoAndAfterTheyStop) {
+    Ultrasonic sensor;
+    EXPECT_FALSE(sensor.hasReading());
+    EXPECT_TRUE(std::isnan(sensor.getDistance()));
+
+    EchoRingBuffer samples;
+    samples.push(Ultrasonic::distanceToPulse(900.0f, 1000000));  // No-echo timeouts only
+    EXPECT_FALSE(sensor.consumeEchoes(samples, 1000000));
+    EXPECT_TRUE(std::isnan(sensor.getDistance()));
+
+    sensor.setDistance(42.0f);
+    EXPECT_TRUE(sensor.hasReading());
+    fake_timer_advance_ms(30001);
+    EXPECT_FALSE(sensor.hasReading());
+    EXPECT_TRUE(std::isnan(sensor.getDistance()));
+}
+
+TEST(Ultrasonic, ConsumeEchoesFiltersAndCountsMisses) {
+    Ultrasonic sensor;
+    FilterSettings_t off = DistanceFilter::defaultSettings();
+    off.medianEnabled = 0;
+    off.kalmanEnabled = 0;
+    sensor.configureFilter(off);
+
+    float speed = Ultrasonic::speedOfSound(Ultrasonic::DEFAULT_AIR_TEMPERATURE);
+    EchoRingBuffer samples;
+    samples.push(Ultrasonic::distanceToPulse(60.0f, 1000000, speed));
+    samples.push(Ultrasonic::distanceToPulse(900.0f, 1000000, speed));  // No-echo timeout
+    EXPECT_TRUE(sensor.consumeEchoes(samples, 1000000));
+    EXPECT_NEAR(60.0f, sensor.getDistance(), 0.02f);
+    EXPECT_EQ(1u, sensor.getMeasurementCount());
+    EXPECT_EQ(1u, sensor.getMissedEchoCount());
+    EXPECT_FALSE(sensor.consumeEchoes(samples, 1000000));
+}
+
+TEST(Ultrasonic, AirTemperatureTimesOut) {
+    Ultrasonic sensor;
+    EXPECT_EQ(Ultrasonic::DEFAULT_AIR_TEMPERATURE, sensor.getAirTemperature());
+    sensor.setAirTemperature(35.0f);
+    EXPECT_EQ(35.0f, sensor.getAirTemperature());
+    sensor.setAirTemperature(150.0f);  // Implausible, ignored
+    EXPECT_EQ(35.0f, sensor.getAirTemperature());
+    fake_timer_advance_ms(61000);
+    EXPECT_EQ(Ultrasonic::DEFAULT_AIR_TEMPERATURE, sensor.getAirTemperature());
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "fake_httpd.h"
+#include "web_assets.h"
+
+class WebAssetsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+        ASSERT_EQ(ESP_OK, httpd_start(&server, &config));
+        registerWebAssets(server);
+    }
+    void TearDown() override { httpd_stop(server); }
+
+    httpd_handle_t server = nullptr;
+};
+
+TEST_F(WebAssetsTest, ServesEveryPageGzipped) {
+    for (const char* uri : {"/", "/config_form", "/wifi_form"}) {
+        FakeHttpRequest request(HTTP_GET, uri);
+        ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request)) << uri;
+        EXPECT_EQ("200 OK", request.status);
+        EXPECT_EQ("text/html; charset=utf-8", request.contentType);
+        EXPECT_EQ("gzip", request.responseHeader("Content-Encoding"));
+        EXPECT_EQ("no-cache", request.responseHeader("Cache-Control"));
+        ASSERT_GT(request.response.size(), 18u);
+        EXPECT_EQ('\x1f', request.response[0]);
+        EXPECT_EQ('\x8b', request.response[1]);
+
+        std::string etag = request.responseHeader("ETag");
+        ASSERT_EQ(10u, etag.size());
+        EXPECT_EQ('"', etag.front());
+        EXPECT_EQ('"', etag.back());
+    }
+}
+
+TEST_F(WebAssetsTest, PagesHaveTheirOwnEtags) {
+    FakeHttpRequest index(HTTP_GET, "/");
+    FakeHttpRequest config(HTTP_GET, "/config_form");
+    fake_httpd_dispatch(server, index);
+    fake_httpd_dispatch(server, config);
+    EXPECT_NE(index.responseHeader("ETag"), config.responseHeader("ETag"));
+    EXPECT_NE(index.response, config.response);
+}
+
+TEST_F(WebAssetsTest, MatchingEtagGetsNotModified) {
+    FakeHttpRequest first(HTTP_GET, "/");
+    fake_httpd_dispatch(server, first);
+    std::string etag = first.responseHeader("ETag");
+
+    FakeHttpRequest reload(HTTP_GET, "/");
+    reload.headers["If-None-Match"] = etag;
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, reload));
+    EXPECT_EQ("304 Not Modified", reload.status);
+    EXPECT_EQ(etag, reload.responseHeader("ETag"));
+    EXPECT_TRUE(reload.response.empty());
+    EXPECT_TRUE(reload.complete);
+
+    FakeHttpRequest stale(HTTP_GET, "/");
+    stale.headers["If-None-Match"] = "\"00000000\"";
+    fake_httpd_dispatch(server, stale);
+    EXPECT_EQ("200 OK", stale.status);
+    EXPECT_EQ(first.response, stale.response);
+}
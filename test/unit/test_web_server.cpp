@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include <nvs_flash.h>
+#include <memory>
+#include <string>
+#include "fake_can_transport.h"
+#include "fake_httpd.h"
+#include "ultrasonic.h"
+#include "web_server.h"
+
+float parseFloat(const char* value, float default_value);
+
+namespace {
+
+const char* TankForm =
+    "tank=1&instance=4&fluid_type=1&dist_unit=mm&vol_unit=liter&tank_height=1500&tank_volume=300"
+    "&sensor_offset=50&low_alarm_percent=150&tank_shape=custom&num_calibration_points=3"
+    "&calibration_distance_0=5&calibration_percentage_0=100"
+    "&calibration_distance_1=80&calibration_percentage_1=40"
+    "&calibration_distance_2=155&calibration_percentage_2=0";
+
+bool contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+}  // namespace
+
+class WebServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fake_nvs_reset();
+        web.reset(new WebServer(&driver, &config, nullptr, sensors, MAX_TANKS));
+        web->start();
+        server = fake_httpd_last_started();
+        ASSERT_NE(nullptr, server);
+    }
+
+    FakeHttpRequest& send(FakeHttpRequest& request) {
+        fake_httpd_dispatch(server, request);
+        return request;
+    }
+
+    ConfigStore config;
+    FakeCanTransport transport;
+    N2kCanDriver driver{&transport, &config};
+    Ultrasonic sensors[MAX_TANKS];
+    std::unique_ptr<WebServer> web;
+    httpd_handle_t server = nullptr;
+};
+
+TEST(ParseFloatTest, AcceptsCommasAndFallsBackOnGarbage) {
+    EXPECT_FLOAT_EQ(12.5f, parseFloat("12.5", 0.0f));
+    EXPECT_FLOAT_EQ(12.5f, parseFloat("12,5", 0.0f));
+    EXPECT_FLOAT_EQ(-3.0f, parseFloat("-3", 0.0f));
+    EXPECT_FLOAT_EQ(7.0f, parseFloat("", 7.0f));
+    EXPECT_FLOAT_EQ(7.0f, parseFloat("  ", 7.0f));
+    EXPECT_FLOAT_EQ(7.0f, parseFloat("abc", 7.0f));
+    EXPECT_FLOAT_EQ(7.0f, parseFloat("1.2.3", 7.0f));
+    EXPECT_FLOAT_EQ(7.0f, parseFloat("4-2", 7.0f));
+}
+
+TEST_F(WebServerTest, RegistersEveryPage) {
+    for (const char* uri : {"/", "/config_form", "/wifi_form", "/tank_form", "/wifi_scan", "/reboot", "/metrics", "/ws",
+                            "/api/v1/status", "/api/v1/config", "/history"}) {
+        EXPECT_NE(nullptr, fake_httpd_find_handler(server, uri, HTTP_GET)) << uri;
+    }
+    for (const char* uri : {"/tank", "/config", "/wifi", "/wifi_reset"}) {
+        EXPECT_NE(nullptr, fake_httpd_find_handler(server, uri, HTTP_POST)) << uri;
+    }
+    FakeHttpRequest missing(HTTP_GET, "/nothing");
+    EXPECT_EQ("404 Not Found", send(missing).status);
+}
+
+TEST_F(WebServerTest, TankPostReadsTheWholeBody) {
+    FakeHttpRequest request(HTTP_POST, "/tank", TankForm);
+    request.recvLimit = 64;  // Arrives over several reads
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("OK", request.response);
+
+    TankSettingsRef settings = web->getTank(1).settings();
+    EXPECT_EQ(4, settings->instance);
+    EXPECT_FLOAT_EQ(150.0f, settings->tank_height);
+    EXPECT_FLOAT_EQ(5.0f, settings->sensor_offset);
+    EXPECT_FLOAT_EQ(300.0f, settings->tank_volume);
+    EXPECT_FLOAT_EQ(100.0f, settings->low_alarm_percent);
+    EXPECT_STREQ("custom", settings->tank_shape);
+    EXPECT_EQ(100.0f, web->getTank(0).settings()->tank_height);  // Other tanks untouched
+
+    config.flush();
+    EXPECT_TRUE(fake_nvs_contains("calibration", "num_points1"));
+    EXPECT_TRUE(fake_nvs_contains("calibration", "points1"));
+    EXPECT_TRUE(fake_nvs_contains("n2k_config", "settings1"));
+
+    ConfigStore reloaded_config;
+    Ultrasonic reloaded_sensors[MAX_TANKS];
+    WebServer reloaded(&driver, &reloaded_config, nullptr, reloaded_sensors, MAX_TANKS);
+    reloaded.loadSettingFromNVS();
+    EXPECT_FLOAT_EQ(150.0f, reloaded.getTank(1).settings()->tank_height);
+    EXPECT_EQ(4, reloaded.getTank(1).settings()->instance);
+    std::vector<CalibrationPoint> calibration;
+    reloaded.loadCalibrationFromNVS(calibration, 1);
+    ASSERT_EQ(3u, calibration.size());
+    EXPECT_FLOAT_EQ(80.0f, calibration[1].distance);
+    EXPECT_FLOAT_EQ(40.0f, calibration[1].percentage);
+}
+
+TEST_F(WebServerTest, TankPostTimesOutOnAShortBody) {
+    FakeHttpRequest request(HTTP_POST, "/tank", "tank=0&tank_height=120");
+    request.req.content_len = 200;
+    EXPECT_EQ(ESP_FAIL, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("408 Request Timeout", request.status);
+    EXPECT_EQ(100.0f, web->getTank(0).settings()->tank_height);
+
+    FakeHttpRequest huge(HTTP_POST, "/tank", std::string(7000, 'x'));
+    EXPECT_EQ(ESP_FAIL, fake_httpd_dispatch(server, huge));
+    EXPECT_EQ("400 Bad Request", huge.status);
+}
+
+TEST_F(WebServerTest, TankFormStreamsTheStoredCalibration) {
+    FakeHttpRequest post(HTTP_POST, "/tank", TankForm);
+    send(post);
+
+    FakeHttpRequest request(HTTP_GET, "/tank_form?tank=1");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_TRUE(request.complete);
+    EXPECT_GT(request.chunks, 1u);
+    EXPECT_TRUE(contains(request.response, "<h1>Tank 2 Settings</h1>"));
+    EXPECT_TRUE(contains(request.response, "name='calibration_distance_1' value='80.0'"));
+    EXPECT_TRUE(contains(request.response, "name='calibration_percentage_1' value='40.0'"));
+    EXPECT_EQ("</script></body></html>", request.response.substr(request.response.size() - 23));
+}
+
+TEST_F(WebServerTest, ConfigPostAppliesEverySetting) {
+    FakeHttpRequest request(HTTP_POST, "/config",
+                            "interval=2000&min_interval=300&deadband=1,5&device_name=Fuel+Tank&temperature_source=2"
+                            "&num_tanks=2&median_enabled=1&median_window=7&kalman_enabled=0");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("OK", request.response);
+    EXPECT_EQ(2000u, driver.getTransmissionInterval());
+    EXPECT_EQ(300u, driver.getMinTransmissionInterval());
+    EXPECT_FLOAT_EQ(1.5f, driver.getLevelDeadband());
+    EXPECT_EQ(2u, web->getNumTanks());
+    EXPECT_EQ(2u, web->getTemperatureSource());
+    for (const Ultrasonic& sensor : sensors) {
+        EXPECT_TRUE(sensor.getFilterSettings().medianEnabled);
+        EXPECT_EQ(7, sensor.getFilterSettings().medianWindow);
+        EXPECT_FALSE(sensor.getFilterSettings().kalmanEnabled);
+    }
+
+    FakeHttpRequest status(HTTP_GET, "/api/v1/status");
+    send(status);
+    EXPECT_TRUE(contains(status.response, "\"device_name\":\"Fuel Tank\""));
+    EXPECT_TRUE(contains(status.response, "\"interval_ms\":2000"));
+
+    config.flush();
+    ConfigStore reloaded_config;
+    Ultrasonic reloaded_sensors[MAX_TANKS];
+    WebServer reloaded(&driver, &reloaded_config, nullptr, reloaded_sensors, MAX_TANKS);
+    reloaded.loadSettingFromNVS();
+    EXPECT_EQ(2u, reloaded.getNumTanks());
+    EXPECT_EQ(2u, reloaded.getTemperatureSource());
+}
+
+TEST_F(WebServerTest, StatusIsJson) {
+    FakeHttpRequest request(HTTP_GET, "/api/v1/status");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("application/json", request.contentType);
+    EXPECT_EQ("no-store", request.responseHeader("Cache-Control"));
+    ASSERT_FALSE(request.response.empty());
+    EXPECT_EQ('{', request.response.front());
+    EXPECT_EQ('}', request.response.back());
+    EXPECT_TRUE(contains(request.response, "\"tanks\":[{"));
+    EXPECT_TRUE(contains(request.response, "\"fluid\":\"fresh water\""));
+    EXPECT_TRUE(contains(request.response, "\"level_percent\":null"));  // No echo yet
+    EXPECT_TRUE(contains(request.response, "\"distance_cm\":null"));
+    EXPECT_TRUE(contains(request.response, "\"alarms\":{\"low\":false,\"high\":false}"));
+}
+
+TEST_F(WebServerTest, ConfigApiReportsTheSsidOnly) {
+    config.setString("wifi_config", "ssid", "Harbour");
+    config.setString("wifi_config", "password", "secret");
+    FakeHttpRequest request(HTTP_GET, "/api/v1/config");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("application/json", request.contentType);
+    EXPECT_TRUE(contains(request.response, "\"wifi_ssid\":\"Harbour\""));
+    EXPECT_FALSE(contains(request.response, "secret"));
+    EXPECT_TRUE(contains(request.response, "\"shape\":\"rectangular\""));
+    EXPECT_TRUE(contains(request.response, "\"median_window\":"));
+}
+
+TEST_F(WebServerTest, HistoryChecksTheResolution) {
+    FakeHttpRequest bad(HTTP_GET, "/history?res=5s");
+    EXPECT_EQ(ESP_FAIL, fake_httpd_dispatch(server, bad));
+    EXPECT_EQ("400 Bad Request", bad.status);
+
+    FakeHttpRequest csv(HTTP_GET, "/history?res=1h");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, csv));
+    EXPECT_EQ("text/csv", csv.contentType);
+    EXPECT_EQ("time,boot,uptime,tank1_percent\n", csv.response);
+    EXPECT_TRUE(csv.complete);
+
+    FakeHttpRequest binary(HTTP_GET, "/history?format=bin");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, binary));
+    EXPECT_EQ("application/octet-stream", binary.contentType);
+    EXPECT_TRUE(binary.response.empty());
+}
+
+TEST_F(WebServerTest, MetricsArePrometheusText) {
+    FakeHttpRequest request(HTTP_GET, "/metrics");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, request));
+    EXPECT_EQ("text/plain; version=0.0.4", request.contentType);
+    EXPECT_TRUE(contains(request.response, "# TYPE can_tx_dropped_total counter\n"));
+    EXPECT_TRUE(contains(request.response, "level_measurements_total{tank=\"1\"} 0\n"));
+    EXPECT_FALSE(contains(request.response, "level_percent{"));  // No reading, no sample
+    EXPECT_TRUE(contains(request.response, "nvs_commits_total "));
+}
+
+TEST_F(WebServerTest, LevelsGoToWebSocketClientsOnly) {
+    fake_httpd_add_client(server, 7, true);
+    fake_httpd_add_client(server, 8, false);
+    web->publishLevels();
+    EXPECT_TRUE(fake_httpd_ws_sent(server, 7).empty());  // Nobody has opened /ws yet
+
+    FakeHttpRequest handshake(HTTP_GET, "/ws");
+    ASSERT_EQ(ESP_OK, fake_httpd_dispatch(server, handshake));
+    web->publishLevels();
+    const std::vector<std::string>& sent = fake_httpd_ws_sent(server, 7);
+    ASSERT_EQ(1u, sent.size());
+    EXPECT_EQ("{\"t\":[[null,null,0]", sent[0].substr(0, 19));  // No echo yet
+    EXPECT_EQ("]}", sent[0].substr(sent[0].size() - 2));
+    EXPECT_TRUE(fake_httpd_ws_sent(server, 8).empty());
+
+    web->publishLevels();
+    EXPECT_EQ(2u, fake_httpd_ws_sent(server, 7).size());
+}